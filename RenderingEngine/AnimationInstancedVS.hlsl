@@ -0,0 +1,82 @@
+// Keep in sync with FishController.h
+#define MAX_FISH_BONES 20
+#define FISH_ANIMATION_FRAMES 32
+
+cbuffer externalData : register(b0)
+{
+	matrix view;
+	matrix projection;
+};
+
+// Bone times inverse bind pose for every joint, one
+// set per frame of the loop. Written once at startup.
+cbuffer animation : register(b1)
+{
+	matrix skinning[FISH_ANIMATION_FRAMES * MAX_FISH_BONES];
+}
+
+
+struct VertexShaderInput
+{
+	float4 position		: POSITION;
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float3 tangent		: TANGENT;
+	float4 boneid		: BONEID;
+	float4 weight		: WEIGHT;
+
+	matrix instanceWorld: WORLD_PER_INSTANCE;
+	float phase			: PHASE_PER_INSTANCE;	// How far into the loop, 0 to 1
+};
+
+
+struct VertexToPixel
+{
+	float4 position		: SV_POSITION;
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float3 worldPos		: POSITION;
+	float3 tangent		: TANGENT;
+};
+
+
+// Blends the two baked frames either side of the phase
+matrix BoneSkinning(float boneid, uint frame, uint nextFrame, float blend)
+{
+	if (boneid < 0)
+		return (matrix)0;
+	uint bone = (uint)boneid;
+	return lerp(skinning[frame * MAX_FISH_BONES + bone], skinning[nextFrame * MAX_FISH_BONES + bone], blend);
+}
+
+
+VertexToPixel main(VertexShaderInput input)
+{
+	VertexToPixel output;
+
+	float framePosition = frac(input.phase) * FISH_ANIMATION_FRAMES;
+	uint frame = (uint)framePosition % FISH_ANIMATION_FRAMES;
+	uint nextFrame = (frame + 1) % FISH_ANIMATION_FRAMES;
+	float blend = frac(framePosition);
+
+	matrix bonetransform =
+		BoneSkinning(input.boneid.x, frame, nextFrame, blend) * input.weight.x +
+		BoneSkinning(input.boneid.y, frame, nextFrame, blend) * input.weight.y +
+		BoneSkinning(input.boneid.z, frame, nextFrame, blend) * input.weight.z +
+		BoneSkinning(input.boneid.w, frame, nextFrame, blend) * input.weight.w;
+
+	matrix world = input.instanceWorld;
+	matrix worldViewProj = mul(mul(world, view), projection);
+
+	output.position = mul(mul(bonetransform, input.position), worldViewProj);
+
+	output.normal = normalize((float3)mul((float3)mul(bonetransform, float4(input.tangent, 1)), (float3x3)world));
+
+	output.worldPos = (float3)(mul(float4(input.position.x, input.position.y, input.position.z, 1.0f), world)).xyz;
+
+	output.uv = input.uv;
+
+	output.tangent = (float3)normalize((float3)mul((float3)mul(bonetransform, float4(input.tangent, 1)), (float3x3)world));
+
+	return output;
+}
@@ -17,7 +17,9 @@ struct PointLight
 };
 
 
-cbuffer externalData : register(b0)
+// Filled in once a frame by the renderer and shared by
+// every lit shader
+cbuffer lightData : register(b0)
 {
 	DirectionalLight dirLights[MAX_LIGHTS];
 	PointLight pointLights[MAX_LIGHTS];
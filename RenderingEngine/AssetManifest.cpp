@@ -0,0 +1,78 @@
+#include "AssetManifest.h"
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+struct AssetTypeName
+{
+	const char* name;
+	AssetType type;
+	size_t minArgs;
+	size_t maxArgs;
+};
+
+static const AssetTypeName assetTypeNames[] =
+{
+	{ "texture", TextureAsset, 1, 1 },
+	{ "vs", VertexShaderAsset, 1, 1 },
+	{ "ps", PixelShaderAsset, 1, 1 },
+	{ "model", ModelAsset, 2, 3 },
+	{ "material", MaterialAsset, 3, 5 },
+};
+
+bool ReadAssetManifest(const std::string& path, std::vector<AssetEntry>& entries)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		printf("\nCan't open the asset manifest %s", path.c_str());
+		return false;
+	}
+
+	std::string text;
+	int lineNumber = 0;
+	while (std::getline(file, text))
+	{
+		lineNumber++;
+		size_t comment = text.find('#');
+		if (comment != std::string::npos)
+			text.resize(comment);
+
+		std::istringstream line(text);
+		std::string typeName;
+		AssetEntry entry;
+		if (!(line >> typeName))
+			continue;
+		if (!(line >> entry.group >> entry.name))
+		{
+			printf("\n%s(%d): expected a group and a name", path.c_str(), lineNumber);
+			continue;
+		}
+		if (entry.name == "-")
+			entry.name.clear();
+		for (std::string arg; line >> arg;)
+			entry.args.push_back(arg);
+		entry.line = lineNumber;
+
+		const AssetTypeName* type = nullptr;
+		for (auto& candidate : assetTypeNames)
+		{
+			if (typeName == candidate.name)
+				type = &candidate;
+		}
+		if (!type)
+		{
+			printf("\n%s(%d): unknown asset type \"%s\"", path.c_str(), lineNumber, typeName.c_str());
+			continue;
+		}
+		if (entry.args.size() < type->minArgs || entry.args.size() > type->maxArgs)
+		{
+			printf("\n%s(%d): wrong number of arguments for %s \"%s\"", path.c_str(), lineNumber, typeName.c_str(), entry.name.c_str());
+			continue;
+		}
+
+		entry.type = type->type;
+		entries.push_back(std::move(entry));
+	}
+	return true;
+}
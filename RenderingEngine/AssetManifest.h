@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+enum AssetType { TextureAsset, VertexShaderAsset, PixelShaderAsset, ModelAsset, MaterialAsset };
+
+//------------------------------------------------
+// One line of the asset manifest. What follows
+// the name depends on the type, see the comment
+// at the top of Assets/Manifest.txt.
+//------------------------------------------------
+struct AssetEntry
+{
+	AssetType type;
+	std::string group;
+	std::string name;
+	std::vector<std::string> args;
+	int line;
+};
+
+// -----------------------------------------------------
+// Reads every entry in the manifest. Lines that can't
+// be made sense of are reported and skipped. False if
+// the file can't be opened.
+// -----------------------------------------------------
+bool ReadAssetManifest(const std::string& path, std::vector<AssetEntry>& entries);
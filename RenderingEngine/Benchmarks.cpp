@@ -0,0 +1,61 @@
+#include "Benchmarks.h"
+#include <d3d11.h>
+#include "JobSystem.h"
+#include "ParticleSystem.h"
+#include "Frustum.h"
+#include "RenderQueue.h"
+#include "SimpleShader.h"
+#include "Resources.h"
+#include "TreeManager.h"
+#include "CommandList.h"
+#include "ObjParser.h"
+
+// A device with no window, just enough to reflect a shader
+static void BenchmarkShaderSetters()
+{
+	ID3D11Device* device = nullptr;
+	ID3D11DeviceContext* context = nullptr;
+	if (FAILED(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, 0, 0, nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, &context)))
+	{
+		printf("\nShader setters: no device");
+		return;
+	}
+
+	{
+		SimpleVertexShader vertexShader(device, context);
+		if (vertexShader.LoadShaderFile(L"VertexShader.cso"))
+			vertexShader.BenchmarkHandles("world", 1000000);
+	}
+	context->Release();
+	device->Release();
+}
+
+// Wrong results so far, each one is printed as it happens
+static int failedBenchmarks = 0;
+
+static void Expect(bool correct, const char* benchmark)
+{
+	if (correct)
+		return;
+	failedBenchmarks++;
+	printf("\n  FAILED: %s disagreed with the code it replaced or its own checks", benchmark);
+}
+
+int RunBenchmarks()
+{
+	JobSystem jobs;
+	failedBenchmarks = 0;
+
+	ParticleSystem::Benchmark(100000, 100);
+	Expect(FrustumCuller::Benchmark(10000, 100), "FrustumCuller::Benchmark");
+	Expect(RenderQueue::Benchmark(10000, 100), "RenderQueue::Benchmark");
+	BenchmarkShaderSetters();
+	Expect(Resources::BenchmarkLookups(64, 100000), "Resources::BenchmarkLookups");
+	Expect(Resources::BenchmarkMeshLoading(10), "Resources::BenchmarkMeshLoading");
+	Resources::BenchmarkVertexWeld(10);
+	Resources::BenchmarkMeshOptimization();
+	InstanceSelector::Benchmark(100000, 100);
+	Expect(CommandList::Benchmark(10000, 100, &jobs), "CommandList::Benchmark");
+	Expect(ObjParser::Benchmark(2000000, 3, &jobs), "ObjParser::Benchmark");
+	return failedBenchmarks;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// -----------------------------------------------------
+// Times the engine's hot paths against the code they
+// replaced and prints the results. Only the shader
+// setters need a device, the rest run without one.
+// Returns how many benchmarks got a different result
+// from the code they were timed against.
+// -----------------------------------------------------
+int RunBenchmarks();
@@ -52,6 +52,15 @@ XMFLOAT4X4 Camera::GetProjectionMatrix()
 	return projectionMatrix;
 }
 
+Frustum Camera::GetFrustum()
+{
+	// Both matrices are stored transposed for the shaders
+	XMFLOAT4X4 view = GetViewMatrix();
+	XMMATRIX V = XMMatrixTranspose(XMLoadFloat4x4(&view));
+	XMMATRIX P = XMMatrixTranspose(XMLoadFloat4x4(&projectionMatrix));
+	return Frustum(V * P);
+}
+
 void Camera::SetProjectionMatrix(float aspectRatio)
 {
 	XMMATRIX P = XMMatrixPerspectiveFovLH(
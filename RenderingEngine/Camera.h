@@ -1,5 +1,6 @@
 #pragma once
 #include <DirectXMath.h>
+#include "Frustum.h"
 
 using namespace DirectX;
 
@@ -22,6 +23,7 @@ public:
 	void RotateY(float y);
 	XMFLOAT4X4 GetViewMatrix();
 	XMFLOAT4X4 GetProjectionMatrix();
+	Frustum GetFrustum();
 	void SetProjectionMatrix(float aspectRatio);
 	void RenderReflectionMatrix(float height);
 	XMFLOAT4X4 GetReflectionMatrix();
@@ -4,6 +4,7 @@ Canvas::Canvas(ID3D11Device* device, ID3D11DeviceContext* context, Resources *re
 	this->device = device;
 	this->context = context;
 	res = resources;
+	titleHandle = resources->shaderResourceViews.GetHandle("title");
 	spriteBatch.reset(new SpriteBatch(context));
 	spriteFont.reset(new SpriteFont(device, L"../../Assets/Fonts/Calibri.spritefont"));
 
@@ -54,7 +55,7 @@ void Canvas::Draw() {
 	spriteBatch->Begin(SpriteSortMode_Deferred, states.NonPremultiplied());
 	
 	if (menuButton->IsEnabled()) {
-		spriteBatch->Draw(res->GetSRV("title"), Vector2(378,100));
+		spriteBatch->Draw(res->shaderResourceViews.Get(titleHandle), Vector2(378,100));
 		spriteBatch->Draw(menuButton->GetSRV(), menuButton->GetPosition());
 		spriteFont->DrawString(spriteBatch.get(), menuButton->GetText().c_str(), menuButton->GetPosition() + Vector2(0, 50), Colors::Black);
 	}
@@ -36,4 +36,5 @@ private:
 
 	Button *menuButton;
 	Resources* res;
+	SRVHandle titleHandle;
 };
\ No newline at end of file
@@ -0,0 +1,459 @@
+#include "CommandList.h"
+#include "JobSystem.h"
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+
+// Limits of the D3D 11 pipeline the null backend checks against
+#define COMMAND_MAX_VERTEX_BUFFERS 32
+#define COMMAND_MAX_CONSTANT_BUFFERS 14
+#define COMMAND_MAX_SHADER_RESOURCES 128
+#define COMMAND_MAX_SAMPLERS 16
+
+CommandList::CommandList()
+{
+}
+
+void CommandList::Reset()
+{
+	commands.clear();
+	constantData.clear();
+}
+
+Command& CommandList::Push(CommandType type)
+{
+	commands.emplace_back();
+	Command& command = commands.back();
+	command.type = type;
+	command.stage = CommandStage::Vertex;
+	command.slot = 0;
+	memset(command.args, 0, sizeof(command.args));
+	command.object = nullptr;
+	return command;
+}
+
+void CommandList::SetInputLayout(ID3D11InputLayout* layout)
+{
+	Push(CommandType::SetInputLayout).object = layout;
+}
+
+void CommandList::SetVertexShader(ID3D11VertexShader* shader)
+{
+	Push(CommandType::SetVertexShader).object = shader;
+}
+
+void CommandList::SetPixelShader(ID3D11PixelShader* shader)
+{
+	Push(CommandType::SetPixelShader).object = shader;
+}
+
+void CommandList::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+	Command& command = Push(CommandType::SetVertexBuffer);
+	command.slot = (uint16_t)slot;
+	command.object = buffer;
+	command.args[0] = stride;
+	command.args[1] = offset;
+}
+
+void CommandList::SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format)
+{
+	Command& command = Push(CommandType::SetIndexBuffer);
+	command.object = buffer;
+	command.args[0] = format;
+}
+
+void CommandList::SetPrimitiveTopology(unsigned int topology)
+{
+	Push(CommandType::SetPrimitiveTopology).args[0] = topology;
+}
+
+void CommandList::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	Push(CommandType::SetRasterizerState).object = state;
+}
+
+// -----------------------------------------------------
+// The data goes on the end of the byte array. Only
+// its offset is kept, the array may move as it grows.
+// -----------------------------------------------------
+void CommandList::UpdateConstants(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	Command& command = Push(CommandType::UpdateConstants);
+	command.object = buffer;
+	command.args[0] = (uint32_t)constantData.size();
+	command.args[1] = size;
+	constantData.insert(constantData.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+}
+
+void CommandList::SetConstantBuffer(CommandStage stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+	Command& command = Push(CommandType::SetConstantBuffer);
+	command.stage = stage;
+	command.slot = (uint16_t)slot;
+	command.object = buffer;
+}
+
+void CommandList::SetShaderResource(CommandStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	Command& command = Push(CommandType::SetShaderResource);
+	command.stage = stage;
+	command.slot = (uint16_t)slot;
+	command.object = srv;
+}
+
+void CommandList::SetSampler(CommandStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	Command& command = Push(CommandType::SetSampler);
+	command.stage = stage;
+	command.slot = (uint16_t)slot;
+	command.object = sampler;
+}
+
+void CommandList::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	Command& command = Push(CommandType::Draw);
+	command.args[0] = vertexCount;
+	command.args[1] = startVertex;
+}
+
+void CommandList::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Command& command = Push(CommandType::DrawIndexed);
+	command.args[0] = indexCount;
+	command.args[1] = startIndex;
+	command.args[2] = (uint32_t)baseVertex;
+}
+
+void CommandList::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance)
+{
+	Command& command = Push(CommandType::DrawInstanced);
+	command.args[0] = vertexCount;
+	command.args[1] = instanceCount;
+	command.args[2] = startVertex;
+	command.args[3] = startInstance;
+}
+
+void CommandList::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	Command& command = Push(CommandType::DrawIndexedInstanced);
+	command.args[0] = indexCount;
+	command.args[1] = instanceCount;
+	command.args[2] = startIndex;
+	command.args[3] = (uint32_t)baseVertex;
+	command.args[4] = startInstance;
+}
+
+void CommandList::Execute(CommandBackend& backend) const
+{
+	for (const Command& command : commands)
+	{
+		void* object = const_cast<void*>(command.object);
+		switch (command.type)
+		{
+		case CommandType::SetInputLayout:
+			backend.SetInputLayout((ID3D11InputLayout*)object);
+			break;
+		case CommandType::SetVertexShader:
+			backend.SetVertexShader((ID3D11VertexShader*)object);
+			break;
+		case CommandType::SetPixelShader:
+			backend.SetPixelShader((ID3D11PixelShader*)object);
+			break;
+		case CommandType::SetVertexBuffer:
+			backend.SetVertexBuffer(command.slot, (ID3D11Buffer*)object, command.args[0], command.args[1]);
+			break;
+		case CommandType::SetIndexBuffer:
+			backend.SetIndexBuffer((ID3D11Buffer*)object, command.args[0]);
+			break;
+		case CommandType::SetPrimitiveTopology:
+			backend.SetPrimitiveTopology(command.args[0]);
+			break;
+		case CommandType::SetRasterizerState:
+			backend.SetRasterizerState((ID3D11RasterizerState*)object);
+			break;
+		case CommandType::UpdateConstants:
+			backend.UpdateConstants((ID3D11Buffer*)object, constantData.data() + command.args[0], command.args[1]);
+			break;
+		case CommandType::SetConstantBuffer:
+			backend.SetConstantBuffer(command.stage, command.slot, (ID3D11Buffer*)object);
+			break;
+		case CommandType::SetShaderResource:
+			backend.SetShaderResource(command.stage, command.slot, (ID3D11ShaderResourceView*)object);
+			break;
+		case CommandType::SetSampler:
+			backend.SetSampler(command.stage, command.slot, (ID3D11SamplerState*)object);
+			break;
+		case CommandType::Draw:
+			backend.Draw(command.args[0], command.args[1]);
+			break;
+		case CommandType::DrawIndexed:
+			backend.DrawIndexed(command.args[0], command.args[1], (int)command.args[2]);
+			break;
+		case CommandType::DrawInstanced:
+			backend.DrawInstanced(command.args[0], command.args[1], command.args[2], command.args[3]);
+			break;
+		case CommandType::DrawIndexedInstanced:
+			backend.DrawIndexedInstanced(command.args[0], command.args[1], command.args[2], (int)command.args[3], command.args[4]);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+int CommandList::GetCommandCount() const
+{
+	return (int)commands.size();
+}
+
+// -----------------------------------------------------
+// What one entity costs: world matrix, material when
+// it changes, mesh buffers and the draw. The pointers
+// are never dereferenced by the null backend.
+// -----------------------------------------------------
+bool CommandList::Benchmark(int drawCount, int iterations, JobSystem* jobs)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	static int fakeObjects[8];
+	ID3D11VertexShader* vertexShader = (ID3D11VertexShader*)&fakeObjects[0];
+	ID3D11PixelShader* pixelShader = (ID3D11PixelShader*)&fakeObjects[1];
+	ID3D11InputLayout* layout = (ID3D11InputLayout*)&fakeObjects[2];
+	ID3D11Buffer* perObject = (ID3D11Buffer*)&fakeObjects[3];
+	ID3D11Buffer* vertexBuffer = (ID3D11Buffer*)&fakeObjects[4];
+	ID3D11Buffer* indexBuffer = (ID3D11Buffer*)&fakeObjects[5];
+	ID3D11ShaderResourceView* texture = (ID3D11ShaderResourceView*)&fakeObjects[6];
+	ID3D11SamplerState* sampler = (ID3D11SamplerState*)&fakeObjects[7];
+
+	int chunkCount = jobs ? (int)jobs->GetWorkerCount() + 1 : 1;
+	int grainSize = (drawCount + chunkCount - 1) / chunkCount;
+	std::vector<CommandList> lists(chunkCount);
+	NullCommandBackend backend;
+
+	double recordMs = 0, replayMs = 0;
+	for (int n = 0; n < iterations; n++)
+	{
+		auto start = Clock::now();
+		auto record = [&](int begin, int end)
+		{
+			CommandList& list = lists[begin / grainSize];
+			list.Reset();
+			list.SetPrimitiveTopology(4);	// Triangle list
+			list.SetInputLayout(layout);
+			list.SetVertexShader(vertexShader);
+			list.SetPixelShader(pixelShader);
+			list.SetConstantBuffer(CommandStage::Vertex, 1, perObject);
+			float world[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+			for (int i = begin; i < end; i++)
+			{
+				world[12] = (float)i;
+				if (i % 8 == 0)
+				{
+					list.SetShaderResource(CommandStage::Pixel, 0, texture);
+					list.SetSampler(CommandStage::Pixel, 0, sampler);
+				}
+				list.UpdateConstants(perObject, world, sizeof(world));
+				list.SetVertexBuffer(0, vertexBuffer, 44);
+				list.SetIndexBuffer(indexBuffer, 42);	// R32_UINT
+				list.DrawIndexed(36);
+			}
+		};
+		if (jobs)
+			jobs->ParallelFor(drawCount, grainSize, record);
+		else
+			record(0, drawCount);
+		auto recorded = Clock::now();
+
+		backend.Reset();
+		for (const CommandList& list : lists)
+			list.Execute(backend);
+		auto replayed = Clock::now();
+
+		recordMs += std::chrono::duration<double, std::milli>(recorded - start).count();
+		replayMs += std::chrono::duration<double, std::milli>(replayed - recorded).count();
+	}
+
+	double commands = (double)backend.GetCommandCount();
+	printf("\nCommand lists (%d draws, %d lists): record %.3f ms (%.1fM commands/s), replay %.3f ms (%.1fM commands/s), %d draws seen, %d errors",
+		drawCount, chunkCount,
+		recordMs / iterations, commands / (recordMs / iterations) / 1000.0,
+		replayMs / iterations, commands / (replayMs / iterations) / 1000.0,
+		backend.GetDrawCount(), backend.GetErrorCount());
+	return backend.GetDrawCount() == drawCount && backend.GetErrorCount() == 0;
+}
+
+NullCommandBackend::NullCommandBackend()
+{
+	Reset();
+}
+
+void NullCommandBackend::Reset()
+{
+	memset(counts, 0, sizeof(counts));
+	constantBytes = 0;
+	errorCount = 0;
+	firstError.clear();
+	vertexShaderBound = false;
+	indexBufferBound = false;
+	topologyBound = false;
+	instanceStride = 0;
+}
+
+int NullCommandBackend::GetCount(CommandType type) const
+{
+	return counts[(int)type];
+}
+
+int NullCommandBackend::GetCommandCount() const
+{
+	int total = 0;
+	for (int i = 0; i < (int)CommandType::Count; i++)
+		total += counts[i];
+	return total;
+}
+
+int NullCommandBackend::GetDrawCount() const
+{
+	return counts[(int)CommandType::Draw] + counts[(int)CommandType::DrawIndexed] +
+		counts[(int)CommandType::DrawInstanced] + counts[(int)CommandType::DrawIndexedInstanced];
+}
+
+uint64_t NullCommandBackend::GetConstantBytes() const
+{
+	return constantBytes;
+}
+
+int NullCommandBackend::GetErrorCount() const
+{
+	return errorCount;
+}
+
+const std::string& NullCommandBackend::GetFirstError() const
+{
+	return firstError;
+}
+
+void NullCommandBackend::Error(const char* message)
+{
+	if (errorCount++ == 0)
+		firstError = message;
+}
+
+// -----------------------------------------------------
+// Instanced draws read their instances from slot 1,
+// that's where SimpleShader puts per instance data
+// -----------------------------------------------------
+void NullCommandBackend::ValidateDraw(bool indexed, bool instanced, unsigned int count, unsigned int instanceCount)
+{
+	if (!vertexShaderBound)
+		Error("Draw without a vertex shader");
+	if (!topologyBound)
+		Error("Draw without a primitive topology");
+	if (indexed && !indexBufferBound)
+		Error("Indexed draw without an index buffer");
+	if (count == 0)
+		Error("Draw with nothing to draw");
+	if (instanced && (instanceCount == 0 || instanceStride == 0))
+		Error("Instanced draw without instances");
+}
+
+void NullCommandBackend::SetInputLayout(ID3D11InputLayout* /*layout*/)
+{
+	counts[(int)CommandType::SetInputLayout]++;
+}
+
+void NullCommandBackend::SetVertexShader(ID3D11VertexShader* shader)
+{
+	counts[(int)CommandType::SetVertexShader]++;
+	vertexShaderBound = shader != nullptr;
+}
+
+void NullCommandBackend::SetPixelShader(ID3D11PixelShader* /*shader*/)
+{
+	// No pixel shader is fine, depth only passes run without one
+	counts[(int)CommandType::SetPixelShader]++;
+}
+
+void NullCommandBackend::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int /*offset*/)
+{
+	counts[(int)CommandType::SetVertexBuffer]++;
+	if (slot >= COMMAND_MAX_VERTEX_BUFFERS)
+		Error("Vertex buffer slot out of range");
+	if (buffer && stride == 0)
+		Error("Vertex buffer without a stride");
+	if (slot == 1)
+		instanceStride = buffer ? stride : 0;
+}
+
+void NullCommandBackend::SetIndexBuffer(ID3D11Buffer* buffer, unsigned int /*format*/)
+{
+	counts[(int)CommandType::SetIndexBuffer]++;
+	indexBufferBound = buffer != nullptr;
+}
+
+void NullCommandBackend::SetPrimitiveTopology(unsigned int topology)
+{
+	counts[(int)CommandType::SetPrimitiveTopology]++;
+	topologyBound = topology != 0;
+}
+
+void NullCommandBackend::SetRasterizerState(ID3D11RasterizerState* /*state*/)
+{
+	counts[(int)CommandType::SetRasterizerState]++;
+}
+
+void NullCommandBackend::UpdateConstants(ID3D11Buffer* buffer, const void* /*data*/, unsigned int size)
+{
+	counts[(int)CommandType::UpdateConstants]++;
+	constantBytes += size;
+	if (!buffer)
+		Error("Constants uploaded to no buffer");
+	if (size == 0 || size % 16 != 0)
+		Error("Constant buffers are a multiple of 16 bytes");
+}
+
+void NullCommandBackend::SetConstantBuffer(CommandStage /*stage*/, unsigned int slot, ID3D11Buffer* /*buffer*/)
+{
+	counts[(int)CommandType::SetConstantBuffer]++;
+	if (slot >= COMMAND_MAX_CONSTANT_BUFFERS)
+		Error("Constant buffer slot out of range");
+}
+
+void NullCommandBackend::SetShaderResource(CommandStage /*stage*/, unsigned int slot, ID3D11ShaderResourceView* /*srv*/)
+{
+	counts[(int)CommandType::SetShaderResource]++;
+	if (slot >= COMMAND_MAX_SHADER_RESOURCES)
+		Error("Shader resource slot out of range");
+}
+
+void NullCommandBackend::SetSampler(CommandStage /*stage*/, unsigned int slot, ID3D11SamplerState* /*sampler*/)
+{
+	counts[(int)CommandType::SetSampler]++;
+	if (slot >= COMMAND_MAX_SAMPLERS)
+		Error("Sampler slot out of range");
+}
+
+void NullCommandBackend::Draw(unsigned int vertexCount, unsigned int /*startVertex*/)
+{
+	counts[(int)CommandType::Draw]++;
+	ValidateDraw(false, false, vertexCount, 1);
+}
+
+void NullCommandBackend::DrawIndexed(unsigned int indexCount, unsigned int /*startIndex*/, int /*baseVertex*/)
+{
+	counts[(int)CommandType::DrawIndexed]++;
+	ValidateDraw(true, false, indexCount, 1);
+}
+
+void NullCommandBackend::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int /*startVertex*/, unsigned int /*startInstance*/)
+{
+	counts[(int)CommandType::DrawInstanced]++;
+	ValidateDraw(false, true, vertexCount, instanceCount);
+}
+
+void NullCommandBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int /*startIndex*/, int /*baseVertex*/, unsigned int /*startInstance*/)
+{
+	counts[(int)CommandType::DrawIndexedInstanced]++;
+	ValidateDraw(true, true, indexCount, instanceCount);
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Only pointers to these go through a command list, so the list and
+// the null backend build without the D3D headers
+struct ID3D11Buffer;
+struct ID3D11InputLayout;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11ShaderResourceView;
+struct ID3D11SamplerState;
+struct ID3D11RasterizerState;
+
+class JobSystem;
+
+enum class CommandStage : uint8_t
+{
+	Vertex,
+	Pixel
+};
+
+enum class CommandType : uint8_t
+{
+	SetInputLayout,
+	SetVertexShader,
+	SetPixelShader,
+	SetVertexBuffer,
+	SetIndexBuffer,
+	SetPrimitiveTopology,
+	SetRasterizerState,
+	UpdateConstants,
+	SetConstantBuffer,
+	SetShaderResource,
+	SetSampler,
+	Draw,
+	DrawIndexed,
+	DrawInstanced,
+	DrawIndexedInstanced,
+	Count
+};
+
+//------------------------------------------------
+// One recorded call. Everything a command needs
+// fits in here except constant data, which lives
+// in the list's own byte array.
+//------------------------------------------------
+struct Command
+{
+	CommandType type;
+	CommandStage stage;
+	uint16_t slot;
+	uint32_t args[5];
+	const void* object;
+};
+
+//------------------------------------------------
+// Whatever a command list gets replayed into
+//------------------------------------------------
+class CommandBackend
+{
+public:
+	virtual ~CommandBackend() {}
+
+	virtual void SetInputLayout(ID3D11InputLayout* layout) = 0;
+	virtual void SetVertexShader(ID3D11VertexShader* shader) = 0;
+	virtual void SetPixelShader(ID3D11PixelShader* shader) = 0;
+	virtual void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset) = 0;
+	virtual void SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format) = 0;
+	virtual void SetPrimitiveTopology(unsigned int topology) = 0;
+	virtual void SetRasterizerState(ID3D11RasterizerState* state) = 0;
+	virtual void UpdateConstants(ID3D11Buffer* buffer, const void* data, unsigned int size) = 0;
+	virtual void SetConstantBuffer(CommandStage stage, unsigned int slot, ID3D11Buffer* buffer) = 0;
+	virtual void SetShaderResource(CommandStage stage, unsigned int slot, ID3D11ShaderResourceView* srv) = 0;
+	virtual void SetSampler(CommandStage stage, unsigned int slot, ID3D11SamplerState* sampler) = 0;
+	virtual void Draw(unsigned int vertexCount, unsigned int startVertex) = 0;
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance) = 0;
+	virtual void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) = 0;
+};
+
+//------------------------------------------------
+// Draw submission recorded into plain memory.
+// A list touches nothing but itself while it is
+// recorded, so each thread can fill its own and
+// the main thread replays them in order.
+//
+// Recording through a SimpleShader is not like
+// that: the shader's constant data and dirty
+// flags are shared, so one shader records into
+// one list at a time, on one thread. The
+// renderer, trees, particles and fish record
+// this way on the main thread. Full screen post
+// process passes still go straight to the
+// context, there is nothing there to batch.
+//------------------------------------------------
+class CommandList
+{
+public:
+	CommandList();
+
+	// Empties the list but keeps its memory
+	void Reset();
+
+	void SetInputLayout(ID3D11InputLayout* layout);
+	void SetVertexShader(ID3D11VertexShader* shader);
+	void SetPixelShader(ID3D11PixelShader* shader);
+	void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset = 0);
+
+	// format and topology are DXGI_FORMAT and D3D11_PRIMITIVE_TOPOLOGY values
+	void SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format);
+	void SetPrimitiveTopology(unsigned int topology);
+	void SetRasterizerState(ID3D11RasterizerState* state);
+
+	// The data is copied, the caller can reuse it straight away
+	void UpdateConstants(ID3D11Buffer* buffer, const void* data, unsigned int size);
+	void SetConstantBuffer(CommandStage stage, unsigned int slot, ID3D11Buffer* buffer);
+	void SetShaderResource(CommandStage stage, unsigned int slot, ID3D11ShaderResourceView* srv);
+	void SetSampler(CommandStage stage, unsigned int slot, ID3D11SamplerState* sampler);
+
+	void Draw(unsigned int vertexCount, unsigned int startVertex = 0);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex = 0, int baseVertex = 0);
+	void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex = 0, unsigned int startInstance = 0);
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex = 0, int baseVertex = 0, unsigned int startInstance = 0);
+
+	// Replays every command in the order it was recorded
+	void Execute(CommandBackend& backend) const;
+
+	int GetCommandCount() const;
+
+	// Records draws on every worker, replays them into the null
+	// backend and reports commands per second for both. False if
+	// the backend didn't see every draw or found anything wrong.
+	static bool Benchmark(int drawCount, int iterations, JobSystem* jobs);
+private:
+	std::vector<Command> commands;
+	std::vector<uint8_t> constantData;
+	Command& Push(CommandType type);
+};
+
+//------------------------------------------------
+// Goes nowhere. Counts what it is given and
+// checks each draw has what it needs bound, so
+// submission can be measured and tested without
+// a GPU.
+//------------------------------------------------
+class NullCommandBackend : public CommandBackend
+{
+public:
+	NullCommandBackend();
+
+	// Forgets counts, errors and bound state
+	void Reset();
+
+	int GetCount(CommandType type) const;
+	int GetCommandCount() const;
+	int GetDrawCount() const;
+	uint64_t GetConstantBytes() const;
+	int GetErrorCount() const;
+
+	// Empty if nothing has gone wrong since the last Reset
+	const std::string& GetFirstError() const;
+
+	void SetInputLayout(ID3D11InputLayout* layout) override;
+	void SetVertexShader(ID3D11VertexShader* shader) override;
+	void SetPixelShader(ID3D11PixelShader* shader) override;
+	void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format) override;
+	void SetPrimitiveTopology(unsigned int topology) override;
+	void SetRasterizerState(ID3D11RasterizerState* state) override;
+	void UpdateConstants(ID3D11Buffer* buffer, const void* data, unsigned int size) override;
+	void SetConstantBuffer(CommandStage stage, unsigned int slot, ID3D11Buffer* buffer) override;
+	void SetShaderResource(CommandStage stage, unsigned int slot, ID3D11ShaderResourceView* srv) override;
+	void SetSampler(CommandStage stage, unsigned int slot, ID3D11SamplerState* sampler) override;
+	void Draw(unsigned int vertexCount, unsigned int startVertex) override;
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance) override;
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) override;
+private:
+	int counts[(int)CommandType::Count];
+	uint64_t constantBytes;
+	int errorCount;
+	std::string firstError;
+
+	// What a draw would see
+	bool vertexShaderBound;
+	bool indexBufferBound;
+	bool topologyBound;
+	unsigned int instanceStride;
+
+	void Error(const char* message);
+	void ValidateDraw(bool indexed, bool instanced, unsigned int count, unsigned int instanceCount);
+};
@@ -0,0 +1,94 @@
+#include "D3D11CommandBackend.h"
+
+D3D11CommandBackend::D3D11CommandBackend(ID3D11DeviceContext* context) :
+	context(context)
+{
+}
+
+void D3D11CommandBackend::SetInputLayout(ID3D11InputLayout* layout)
+{
+	context->IASetInputLayout(layout);
+}
+
+void D3D11CommandBackend::SetVertexShader(ID3D11VertexShader* shader)
+{
+	context->VSSetShader(shader, 0, 0);
+}
+
+void D3D11CommandBackend::SetPixelShader(ID3D11PixelShader* shader)
+{
+	context->PSSetShader(shader, 0, 0);
+}
+
+void D3D11CommandBackend::SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset)
+{
+	context->IASetVertexBuffers(slot, 1, &buffer, &stride, &offset);
+}
+
+void D3D11CommandBackend::SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format)
+{
+	context->IASetIndexBuffer(buffer, (DXGI_FORMAT)format, 0);
+}
+
+void D3D11CommandBackend::SetPrimitiveTopology(unsigned int topology)
+{
+	context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11CommandBackend::SetRasterizerState(ID3D11RasterizerState* state)
+{
+	context->RSSetState(state);
+}
+
+// -----------------------------------------------------
+// Constant buffers are default usage and always
+// updated whole, same as SimpleShader does it
+// -----------------------------------------------------
+void D3D11CommandBackend::UpdateConstants(ID3D11Buffer* buffer, const void* data, unsigned int size)
+{
+	context->UpdateSubresource(buffer, 0, 0, data, 0, 0);
+}
+
+void D3D11CommandBackend::SetConstantBuffer(CommandStage stage, unsigned int slot, ID3D11Buffer* buffer)
+{
+	if (stage == CommandStage::Vertex)
+		context->VSSetConstantBuffers(slot, 1, &buffer);
+	else
+		context->PSSetConstantBuffers(slot, 1, &buffer);
+}
+
+void D3D11CommandBackend::SetShaderResource(CommandStage stage, unsigned int slot, ID3D11ShaderResourceView* srv)
+{
+	if (stage == CommandStage::Vertex)
+		context->VSSetShaderResources(slot, 1, &srv);
+	else
+		context->PSSetShaderResources(slot, 1, &srv);
+}
+
+void D3D11CommandBackend::SetSampler(CommandStage stage, unsigned int slot, ID3D11SamplerState* sampler)
+{
+	if (stage == CommandStage::Vertex)
+		context->VSSetSamplers(slot, 1, &sampler);
+	else
+		context->PSSetSamplers(slot, 1, &sampler);
+}
+
+void D3D11CommandBackend::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	context->Draw(vertexCount, startVertex);
+}
+
+void D3D11CommandBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11CommandBackend::DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance)
+{
+	context->DrawInstanced(vertexCount, instanceCount, startVertex, startInstance);
+}
+
+void D3D11CommandBackend::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	context->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <d3d11.h>
+#include "CommandList.h"
+
+//------------------------------------------------
+// Replays command lists on a device context,
+// normally the immediate one
+//------------------------------------------------
+class D3D11CommandBackend : public CommandBackend
+{
+	ID3D11DeviceContext* context;
+public:
+	D3D11CommandBackend(ID3D11DeviceContext* context);
+
+	void SetInputLayout(ID3D11InputLayout* layout) override;
+	void SetVertexShader(ID3D11VertexShader* shader) override;
+	void SetPixelShader(ID3D11PixelShader* shader) override;
+	void SetVertexBuffer(unsigned int slot, ID3D11Buffer* buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(ID3D11Buffer* buffer, unsigned int format) override;
+	void SetPrimitiveTopology(unsigned int topology) override;
+	void SetRasterizerState(ID3D11RasterizerState* state) override;
+	void UpdateConstants(ID3D11Buffer* buffer, const void* data, unsigned int size) override;
+	void SetConstantBuffer(CommandStage stage, unsigned int slot, ID3D11Buffer* buffer) override;
+	void SetShaderResource(CommandStage stage, unsigned int slot, ID3D11ShaderResourceView* srv) override;
+	void SetSampler(CommandStage stage, unsigned int slot, ID3D11SamplerState* sampler) override;
+	void Draw(unsigned int vertexCount, unsigned int startVertex) override;
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void DrawInstanced(unsigned int vertexCount, unsigned int instanceCount, unsigned int startVertex, unsigned int startInstance) override;
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) override;
+};
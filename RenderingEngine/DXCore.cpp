@@ -364,8 +364,10 @@ HRESULT DXCore::Run()
 	currentTime = now;
 	previousTime = now;
 
-	// Give subclass a chance to initialize
-	Init();
+	// Give subclass a chance to initialize, and
+	// exit early if it can't
+	HRESULT hr = Init();
+	if (FAILED(hr)) return hr;
 
 	// Our overall game and message loop
 	MSG msg = {};
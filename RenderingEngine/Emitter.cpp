@@ -2,7 +2,29 @@
 
 using namespace DirectX;
 
-Emitter::Emitter(
+Emitter::Emitter()
+{
+	particlesPerSecond = 0;
+	secondsPerParticle = 0;
+	timeSinceEmit = 0;
+	livingParticleCount = 0;
+	emittedParticleCount = 0;
+	lifetime = 0;
+	startSize = endSize = 0;
+	particles = {};
+	firstParticle = 0;
+	maxParticles = 0;
+	paddedParticles = 0;
+	firstAliveIndex = 0;
+	texture = nullptr;
+}
+
+// --------------------------------------------------------
+// (Re)start the emitter on a range of the particle pool.
+// particles must already point at the first particle of
+// the range, which has to be 16 byte aligned.
+// --------------------------------------------------------
+void Emitter::Initialize(
 	int maxParticles,
 	int particlesPerSecond,
 	float lifetime,
@@ -12,20 +34,19 @@ Emitter::Emitter(
 	DirectX::XMFLOAT4 endColor,
 	DirectX::XMFLOAT3 startVelocity,
 	DirectX::XMFLOAT3 emitterAcceleration,
-	ID3D11Device* device,
-	SimpleVertexShader* vs,
-	SimplePixelShader* ps,
 	ID3D11ShaderResourceView* texture,
 	DirectX::XMFLOAT3 emitterPosition,
-	bool _loop
+	bool loop,
+	const ParticleArrays& particles,
+	int firstParticle,
+	const Random& random
 	)
 {
 	// Save params
-	this->vs = vs;
-	this->ps = ps;
 	this->texture = texture;
 
 	this->maxParticles = maxParticles;
+	this->paddedParticles = (maxParticles + 3) & ~3;
 	this->lifetime = lifetime;
 	this->startColor = startColor;
 	this->endColor = endColor;
@@ -37,275 +58,256 @@ Emitter::Emitter(
 
 	this->emitterPosition = emitterPosition;
 	this->emitterAcceleration = emitterAcceleration;
-	this->loop = _loop;
+	this->loop = loop;
+
+	this->particles = particles;
+	this->firstParticle = firstParticle;
+	this->random = random;
 
 	timeSinceEmit = 0;
+	time = 0;
 	livingParticleCount = 0;
+	emittedParticleCount = 0;
 	firstAliveIndex = 0;
-	firstDeadIndex = 0;
-
-	// Make the particle array
-	particles = new Particle[maxParticles];
-
-	// Create local particle vertices (easier to update)
-	// Do UV's here, as those will never change
-	localParticleVertices = new ParticleVertex[4 * maxParticles];
-	for (int i = 0; i < maxParticles * 4; i += 4)
-	{
-		localParticleVertices[i + 0].UV = XMFLOAT2(0, 0);
-		localParticleVertices[i + 1].UV = XMFLOAT2(1, 0);
-		localParticleVertices[i + 2].UV = XMFLOAT2(1, 1);
-		localParticleVertices[i + 3].UV = XMFLOAT2(0, 1);
-	}
-
+	doneEmit = false;
+}
 
-	// Create buffers for drawing particles
+void Emitter::SetPosition(DirectX::XMFLOAT3 pos)
+{
+	this->emitterPosition = pos;
+}
 
-	// DYNAMIC vertex buffer (no initial data necessary)
-	D3D11_BUFFER_DESC vbDesc = {};
-	vbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	vbDesc.Usage = D3D11_USAGE_DYNAMIC;
-	vbDesc.ByteWidth = sizeof(ParticleVertex) * 4 * maxParticles;
-	device->CreateBuffer(&vbDesc, 0, &vertexBuffer);
+int Emitter::GetLivingParticleCount() const
+{
+	return livingParticleCount;
+}
 
-	// Index buffer data
-	unsigned int* indices = new unsigned int[maxParticles * 6];
-	int indexCount = 0;
-	for (int i = 0; i < maxParticles * 4; i += 4)
-	{
-		indices[indexCount++] = i;
-		indices[indexCount++] = i + 1;
-		indices[indexCount++] = i + 2;
-		indices[indexCount++] = i;
-		indices[indexCount++] = i + 2;
-		indices[indexCount++] = i + 3;
-	}
-	D3D11_SUBRESOURCE_DATA indexData = {};
-	indexData.pSysMem = indices;
-
-	// Regular index buffer
-	D3D11_BUFFER_DESC ibDesc = {};
-	ibDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibDesc.CPUAccessFlags = 0;
-	ibDesc.Usage = D3D11_USAGE_DEFAULT;
-	ibDesc.ByteWidth = sizeof(unsigned int) * maxParticles * 6;
-	device->CreateBuffer(&ibDesc, &indexData, &indexBuffer);
-	
-	delete[] indices;
+int Emitter::GetMaxParticles() const
+{
+	return maxParticles;
 }
 
+int Emitter::GetFirstParticle() const
+{
+	return firstParticle;
+}
 
-Emitter::~Emitter()
+ID3D11ShaderResourceView* Emitter::GetTexture() const
 {
-	delete[] particles;
-	delete[] localParticleVertices;
-	vertexBuffer->Release();
-	indexBuffer->Release();
+	return texture;
 }
 
-void Emitter::SetPosition(DirectX::XMFLOAT3 pos)
+// --------------------------------------------------------
+// Splits the living particles into contiguous spans
+//
+// 0 -------- FIRST ALIVE ----------- FIRST DEAD -------- MAX
+// |    dead    |            alive       |         dead    |
+//
+// 0 -------- FIRST DEAD ----------- FIRST ALIVE -------- MAX
+// |    alive    |            dead       |         alive   |
+// --------------------------------------------------------
+int Emitter::GetLivingSpans(int* starts, int* counts) const
 {
-	this->emitterPosition = pos;
+	if (livingParticleCount == 0)
+		return 0;
+
+	int end = firstAliveIndex + livingParticleCount;
+	if (end <= maxParticles)
+	{
+		starts[0] = firstAliveIndex;
+		counts[0] = livingParticleCount;
+		return 1;
+	}
+
+	starts[0] = firstAliveIndex;
+	counts[0] = maxParticles - firstAliveIndex;
+	starts[1] = 0;
+	counts[1] = end - maxParticles;
+	return 2;
 }
 
 void Emitter::Update(float dt)
 {
-	// Update all particles - Check cyclic buffer first
-	if (firstAliveIndex < firstDeadIndex)
+	// Update whole groups of 4 around each living span. The extra
+	// slots are dead, so whatever gets written there is overwritten
+	// on spawn.
+	int starts[2], counts[2];
+	int spans = GetLivingSpans(starts, counts);
+	if (spans == 1)
 	{
-		// First alive is BEFORE first dead, so the "living" particles are contiguous
-		// 
-		// 0 -------- FIRST ALIVE ----------- FIRST DEAD -------- MAX
-		// |    dead    |            alive       |         dead    |
-
-		// First alive is before first dead, so no wrapping
-		for (int i = firstAliveIndex; i < firstDeadIndex; i++)
-			UpdateSingleParticle(dt, i);
+		UpdateParticles(dt, starts[0] & ~3, (starts[0] + counts[0] + 3) & ~3);
 	}
-	else
+	else if (spans == 2)
 	{
-		// First alive is AFTER first dead, so the "living" particles wrap around
-		// 
-		// 0 -------- FIRST DEAD ----------- FIRST ALIVE -------- MAX
-		// |    alive    |            dead       |         alive   |
-
-		// Update first half (from firstAlive to max particles)
-		for (int i = firstAliveIndex; i < maxParticles; i++)
-			UpdateSingleParticle(dt, i);
-
-		// Update second half (from 0 to first dead)
-		for (int i = 0; i < firstDeadIndex; i++)
-			UpdateSingleParticle(dt, i);
+		int wrappedEnd = (counts[1] + 3) & ~3;
+		int firstBegin = starts[0] & ~3;
+
+		// Both spans share a group, do everything once so no age is advanced twice
+		if (wrappedEnd > firstBegin)
+		{
+			UpdateParticles(dt, 0, paddedParticles);
+		}
+		else
+		{
+			UpdateParticles(dt, firstBegin, paddedParticles);
+			UpdateParticles(dt, 0, wrappedEnd);
+		}
 	}
 
+	RetireParticles();
+
 	// Add to the time
 	timeSinceEmit += dt;
 	time += dt;
 	
 	// Enough time to emit?
+	int spawnCount = 0;
 	while (timeSinceEmit > secondsPerParticle)
 	{
-		SpawnParticle();
+		spawnCount++;
 		timeSinceEmit -= secondsPerParticle;
 	}
+	SpawnParticles(spawnCount);
+
+	if (!loop && emittedParticleCount >= maxParticles && livingParticleCount == 0)
+		doneEmit = true;
 }
 
-void Emitter::UpdateSingleParticle(float dt, int index)
+// --------------------------------------------------------
+// Age, interpolate and move particles [begin, end), 4 at a time.
+// begin and end must be multiples of 4.
+// --------------------------------------------------------
+void Emitter::UpdateParticles(float dt, int begin, int end)
 {
-	// Check for valid particle age before doing anything
-	if (particles[index].Age >= lifetime)
-		return;
+	XMVECTOR delta = XMVectorReplicate(dt);
+	XMVECTOR inverseLifetime = XMVectorReplicate(1.0f / lifetime);
+
+	// Constant acceleration: p = a * t * t / 2 + v * t + p0
+	XMVECTOR halfAccelX = XMVectorReplicate(emitterAcceleration.x * 0.5f);
+	XMVECTOR halfAccelY = XMVectorReplicate(emitterAcceleration.y * 0.5f);
+	XMVECTOR halfAccelZ = XMVectorReplicate(emitterAcceleration.z * 0.5f);
+	XMVECTOR originX = XMVectorReplicate(emitterPosition.x);
+	XMVECTOR originY = XMVectorReplicate(emitterPosition.y);
+	XMVECTOR originZ = XMVectorReplicate(emitterPosition.z);
+
+	// Lerps written as start + percent * (end - start)
+	XMVECTOR sizeStart = XMVectorReplicate(startSize);
+	XMVECTOR sizeRange = XMVectorReplicate(endSize - startSize);
+	XMVECTOR colorStartR = XMVectorReplicate(startColor.x);
+	XMVECTOR colorStartG = XMVectorReplicate(startColor.y);
+	XMVECTOR colorStartB = XMVectorReplicate(startColor.z);
+	XMVECTOR colorStartA = XMVectorReplicate(startColor.w);
+	XMVECTOR colorRangeR = XMVectorReplicate(endColor.x - startColor.x);
+	XMVECTOR colorRangeG = XMVectorReplicate(endColor.y - startColor.y);
+	XMVECTOR colorRangeB = XMVectorReplicate(endColor.z - startColor.z);
+	XMVECTOR colorRangeA = XMVectorReplicate(endColor.w - startColor.w);
+
+	for (int i = begin; i < end; i += 4)
+	{
+		XMVECTOR age = XMVectorAdd(XMLoadFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.Age + i)), delta);
+		XMVECTOR agePercent = XMVectorMultiply(age, inverseLifetime);
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.Age + i), age);
+
+		XMVECTOR velocityX = XMLoadFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.VelocityX + i));
+		XMVECTOR velocityY = XMLoadFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.VelocityY + i));
+		XMVECTOR velocityZ = XMLoadFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.VelocityZ + i));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.PositionX + i), XMVectorMultiplyAdd(XMVectorMultiplyAdd(halfAccelX, age, velocityX), age, originX));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.PositionY + i), XMVectorMultiplyAdd(XMVectorMultiplyAdd(halfAccelY, age, velocityY), age, originY));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.PositionZ + i), XMVectorMultiplyAdd(XMVectorMultiplyAdd(halfAccelZ, age, velocityZ), age, originZ));
+
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.Size + i), XMVectorMultiplyAdd(agePercent, sizeRange, sizeStart));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.ColorR + i), XMVectorMultiplyAdd(agePercent, colorRangeR, colorStartR));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.ColorG + i), XMVectorMultiplyAdd(agePercent, colorRangeG, colorStartG));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.ColorB + i), XMVectorMultiplyAdd(agePercent, colorRangeB, colorStartB));
+		XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(particles.ColorA + i), XMVectorMultiplyAdd(agePercent, colorRangeA, colorStartA));
+	}
+}
 
-	// Update and check for death
-	particles[index].Age += dt;
-	if (particles[index].Age >= lifetime)
+// --------------------------------------------------------
+// Oldest particles are always at firstAliveIndex
+// --------------------------------------------------------
+void Emitter::RetireParticles()
+{
+	while (livingParticleCount > 0 && particles.Age[firstAliveIndex] >= lifetime)
 	{
-		// Recent death, so retire by moving alive count
 		firstAliveIndex++;
-		if (loop)
-		{
-			firstAliveIndex %= maxParticles;
-			livingParticleCount--;
-		}
-		return;
+		if (firstAliveIndex == maxParticles)
+			firstAliveIndex = 0;
+		livingParticleCount--;
 	}
-
-	// Calculate age percentage for lerp
-	float agePercent = particles[index].Age / lifetime;
-
-	// Interpolate the color
-	XMStoreFloat4(
-		&particles[index].Color,
-		XMVectorLerp(
-			XMLoadFloat4(&startColor),
-			XMLoadFloat4(&endColor),
-			agePercent));
-
-	// Lerp size
-	particles[index].Size = startSize + agePercent * (endSize - startSize);
-
-
-	// Adjust the position
-	XMVECTOR startPos = XMLoadFloat3(&emitterPosition);
-	XMVECTOR startVel = XMLoadFloat3(&particles[index].StartVelocity);
-	XMVECTOR accel = XMLoadFloat3(&emitterAcceleration);
-	float t = particles[index].Age;
-
-	// Use constant acceleration function
-	XMStoreFloat3(
-		&particles[index].Position,
-		accel * t * t / 2.0f + startVel * t + startPos);
 }
 
 void Emitter::SpawnParticle()
 {
-	// Any left to spawn?
-	if (livingParticleCount == maxParticles)
-		return;
-
-	// Reset the first dead particle
-	particles[firstDeadIndex].Age = 0;
-	particles[firstDeadIndex].Size = startSize;
-	particles[firstDeadIndex].Color = startColor;
-	particles[firstDeadIndex].Position.x = emitterPosition.x + (((float)rand() / RAND_MAX) * 1.4f - 0.2f);
-	particles[firstDeadIndex].Position.y = emitterPosition.y;
-	particles[firstDeadIndex].Position.z = emitterPosition.z + (((float)rand() / RAND_MAX) * 1.4f - 0.2f);
-	particles[firstDeadIndex].StartVelocity = startVelocity;
-	particles[firstDeadIndex].StartVelocity.x += ((float)rand() / RAND_MAX) * 5.4f - 0.2f;
-	particles[firstDeadIndex].StartVelocity.y += ((float)rand() / RAND_MAX) * 1.0f - 0.2f;
-	particles[firstDeadIndex].StartVelocity.z += ((float)rand() / RAND_MAX) * 5.4f - 0.2f;
-
-	// Increment and wrap
-	firstDeadIndex++;
-	firstDeadIndex %= maxParticles;
-
-	livingParticleCount++;
-	
+	SpawnParticles(1);
 }
 
-void Emitter::CopyParticlesToGPU(ID3D11DeviceContext* context)
+// --------------------------------------------------------
+// Reset the first count dead particles. New particles are
+// contiguous apart from the wrap, so the random offsets
+// are filled a run at a time.
+// --------------------------------------------------------
+void Emitter::SpawnParticles(int count)
 {
-	// Update local buffer (living particles only as a speed up)
+	// Any left to spawn?
+	int available = maxParticles - livingParticleCount;
 
-	// Check cyclic buffer status
-	if (firstAliveIndex < firstDeadIndex)
-	{
-		for (int i = firstAliveIndex; i < firstDeadIndex; i++)
-			CopyOneParticle(i);
-	}
-	else
-	{
-		// Update first half (from firstAlive to max particles)
-		for (int i = firstAliveIndex; i < maxParticles; i++)
-			CopyOneParticle(i);
+	// One shot emitters only ever emit maxParticles
+	if (!loop && maxParticles - emittedParticleCount < available)
+		available = maxParticles - emittedParticleCount;
 
-		// Update second half (from 0 to first dead)
-		for (int i = 0; i < firstDeadIndex; i++)
-			CopyOneParticle(i);
-	}
+	if (count > available)
+		count = available;
 
-	// All particles copied locally - send whole buffer to GPU
-	D3D11_MAPPED_SUBRESOURCE mapped = {};
-	context->Map(vertexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	while (count > 0)
+	{
+		int index = firstAliveIndex + livingParticleCount;
+		if (index >= maxParticles)
+			index -= maxParticles;
 
-	memcpy(mapped.pData, localParticleVertices, sizeof(ParticleVertex) * 4 * maxParticles);
+		int run = maxParticles - index;
+		if (run > count)
+			run = count;
 
-	context->Unmap(vertexBuffer, 0);
-}
+		for (int i = index; i < index + run; i++)
+		{
+			particles.Age[i] = 0;
+			particles.Size[i] = startSize;
+			particles.ColorR[i] = startColor.x;
+			particles.ColorG[i] = startColor.y;
+			particles.ColorB[i] = startColor.z;
+			particles.ColorA[i] = startColor.w;
+			particles.PositionY[i] = emitterPosition.y;
+		}
 
-void Emitter::CopyOneParticle(int index)
-{
-	int i = index * 4;
-
-	localParticleVertices[i + 0].Position = particles[index].Position;
-	localParticleVertices[i + 1].Position = particles[index].Position;
-	localParticleVertices[i + 2].Position = particles[index].Position;
-	localParticleVertices[i + 3].Position = particles[index].Position;
-
-	localParticleVertices[i + 0].Size = particles[index].Size;
-	localParticleVertices[i + 1].Size = particles[index].Size;
-	localParticleVertices[i + 2].Size = particles[index].Size;
-	localParticleVertices[i + 3].Size = particles[index].Size;
-
-	localParticleVertices[i + 0].Color = particles[index].Color;
-	localParticleVertices[i + 1].Color = particles[index].Color;
-	localParticleVertices[i + 2].Color = particles[index].Color;
-	localParticleVertices[i + 3].Color = particles[index].Color;
+		random.Fill(particles.PositionX + index, run, emitterPosition.x - 0.2f, emitterPosition.x + 1.2f);
+		random.Fill(particles.PositionZ + index, run, emitterPosition.z - 0.2f, emitterPosition.z + 1.2f);
+		random.Fill(particles.VelocityX + index, run, startVelocity.x - 0.2f, startVelocity.x + 5.2f);
+		random.Fill(particles.VelocityY + index, run, startVelocity.y - 0.2f, startVelocity.y + 0.8f);
+		random.Fill(particles.VelocityZ + index, run, startVelocity.z - 0.2f, startVelocity.z + 5.2f);
+
+		livingParticleCount += run;
+		emittedParticleCount += run;
+		count -= run;
+	}
 }
 
-void Emitter::Draw(ID3D11DeviceContext* context, Camera* camera)
+// --------------------------------------------------------
+// Interleave the living particles into instance data
+// --------------------------------------------------------
+int Emitter::PackParticles(ParticleInstance* instances) const
 {
-	// Copy to dynamic buffer
-	CopyParticlesToGPU(context);
-
-	// Set up buffers
-	UINT stride = sizeof(ParticleVertex);
-	UINT offset = 0;
-	context->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-
-	vs->SetMatrix4x4("view", camera->GetViewMatrix());
-	vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());
-	vs->SetShader();
-	vs->CopyAllBufferData();
-
-	ps->SetShaderResourceView("particle", texture);
-	ps->SetShader();
-	ps->CopyAllBufferData();
-
-	// Draw the correct parts of the buffer
-	if (firstAliveIndex < firstDeadIndex)
-	{
-		context->DrawIndexed(livingParticleCount * 6, firstAliveIndex * 6, 0);
-	}
-	else
+	int starts[2], counts[2];
+	int spans = GetLivingSpans(starts, counts);
+	for (int s = 0; s < spans; s++)
 	{
-		// Draw first half (0 -> dead)
-		context->DrawIndexed(firstDeadIndex * 6, 0, 0);
-
-		// Draw second half (alive -> max)
-		context->DrawIndexed((maxParticles - firstAliveIndex) * 6, firstAliveIndex * 6, 0);
+		for (int index = starts[s]; index < starts[s] + counts[s]; index++)
+		{
+			instances->Position = XMFLOAT3(particles.PositionX[index], particles.PositionY[index], particles.PositionZ[index]);
+			instances->Size = particles.Size[index];
+			instances->Color = XMFLOAT4(particles.ColorR[index], particles.ColorG[index], particles.ColorB[index], particles.ColorA[index]);
+			instances++;
+		}
 	}
-
+	return livingParticleCount;
 }
@@ -3,30 +3,51 @@
 #include <d3d11.h>
 #include <DirectXMath.h>
 
-#include "Camera.h"
-#include "SimpleShader.h"
+#include "Random.h"
 
-struct Particle
+//------------------------------------------------
+// Particle data as separate 16 byte aligned
+// arrays, padded to a multiple of 4 so the
+// update can work on 4 particles at a time
+//------------------------------------------------
+struct ParticleArrays
 {
-	DirectX::XMFLOAT3 Position;
-	DirectX::XMFLOAT4 Color;
-	DirectX::XMFLOAT3 StartVelocity;
-	float Size;
-	float Age;
+	float* PositionX;
+	float* PositionY;
+	float* PositionZ;
+	float* VelocityX;	// start velocity
+	float* VelocityY;
+	float* VelocityZ;
+	float* ColorR;
+	float* ColorG;
+	float* ColorB;
+	float* ColorA;
+	float* Size;
+	float* Age;
 };
 
-struct ParticleVertex
+//------------------------------------------------
+// Per particle instance data, must match the
+// _PER_INSTANCE inputs in ParticleVS.hlsl
+//------------------------------------------------
+struct ParticleInstance
 {
 	DirectX::XMFLOAT3 Position;
-	DirectX::XMFLOAT2 UV;
-	DirectX::XMFLOAT4 Color;
 	float Size;
+	DirectX::XMFLOAT4 Color;
 };
 
+//------------------------------------------------
+// A single effect's emission state. Emitters do
+// not own any memory, they simulate a range of
+// particles borrowed from the ParticleSystem.
+//------------------------------------------------
 class Emitter
 {
 public:
-	Emitter(
+	Emitter();
+
+	void Initialize(
 		int maxParticles,
 		int particlesPerSecond,
 		float lifetime,
@@ -36,24 +57,29 @@ public:
 		DirectX::XMFLOAT4 endColor,
 		DirectX::XMFLOAT3 startVelocity,
 		DirectX::XMFLOAT3 emitterAcceleration,
-		ID3D11Device* device,
-		SimpleVertexShader* vs,
-		SimplePixelShader* ps,
 		ID3D11ShaderResourceView* texture,
-		DirectX::XMFLOAT3 emitterPosition = DirectX::XMFLOAT3(0, 0, 0),
-		bool loop = false
+		DirectX::XMFLOAT3 emitterPosition,
+		bool loop,
+		const ParticleArrays& particles,
+		int firstParticle,
+		const Random& random
 		);
-	~Emitter();
 
 	void Update(float dt);
-
-	void UpdateSingleParticle(float dt, int index);
 	void SpawnParticle();
+	void SpawnParticles(int count);
+
+	// Writes the living particles, oldest first, and returns how many
+	int PackParticles(ParticleInstance* instances) const;
+	int GetLivingSpans(int* starts, int* counts) const;
 
-	void CopyParticlesToGPU(ID3D11DeviceContext* context);
-	void CopyOneParticle(int index);
-	void Draw(ID3D11DeviceContext* context, Camera* camera);
 	void SetPosition(DirectX::XMFLOAT3 pos);
+	int GetLivingParticleCount() const;
+	int GetMaxParticles() const;
+	int GetFirstParticle() const;
+	ID3D11ShaderResourceView* GetTexture() const;
+
+	// Set once a non looping emitter has emitted and lost all its particles
 	bool doneEmit = false;
 private:
 	// Emission properties
@@ -61,9 +87,10 @@ private:
 	float secondsPerParticle;
 	float timeSinceEmit;
 	float time = 0.0f;
-	float loop = false;
+	bool loop = false;
 
 	int livingParticleCount;
+	int emittedParticleCount;
 	float lifetime;
 
 	DirectX::XMFLOAT3 emitterAcceleration;
@@ -74,19 +101,19 @@ private:
 	float startSize;
 	float endSize;
 
-	// Particle array
-	Particle* particles;
+	// Particle ring buffer. Every particle has the same lifetime and
+	// they are spawned in order, so they also die in order from
+	// firstAliveIndex and the living ones are at most two spans.
+	ParticleArrays particles;
+	int firstParticle;
 	int maxParticles;
-	int firstDeadIndex;
+	int paddedParticles;
 	int firstAliveIndex;
 
-	// Rendering
-	ParticleVertex* localParticleVertices;
-	ID3D11Buffer* vertexBuffer;
-	ID3D11Buffer* indexBuffer;
-
 	ID3D11ShaderResourceView* texture;
-	SimpleVertexShader* vs;
-	SimplePixelShader* ps;
+	Random random;
+
+	void UpdateParticles(float dt, int begin, int end);
+	void RetireParticles();
 };
 
@@ -1,6 +1,9 @@
 #include "Entity.h"
 #include <algorithm>
 
+// Number of entities in each transform job
+const int TRANSFORM_GRAIN_SIZE = 64;
+
 Entity::Entity(Mesh *m, Material* mat)
 {
 	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(XMMatrixIdentity()));
@@ -9,6 +12,11 @@ Entity::Entity(Mesh *m, Material* mat)
 	XMStoreFloat3(&position, v);
 	XMStoreFloat3(&scale, sc);
 	XMStoreFloat3(&rotation, v);
+	previousPosition = position;
+	previousRotation = rotation;
+	interpolation = 1.0f;
+	worldMatrixDirty = true;
+	boundingBoxDirty = true;
 	mesh = m;
 	material = mat;
 	if (m != nullptr)
@@ -29,36 +37,105 @@ Entity::~Entity()
 
 BoundingOrientedBox Entity::GetBoundingBox()
 {
-	auto bBox = boundingBox;
-	bBox.Center = position;
-	bBox.Extents.x *= scale.x;
-	bBox.Extents.y *= scale.y;
-	bBox.Extents.z *= scale.z;
-	auto rot = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation));
-	XMStoreFloat4(&bBox.Orientation, rot);
-	return bBox;
+	if (boundingBoxDirty)
+		UpdateTransform();
+	return worldBoundingBox;
+}
+
+BoundingSphere Entity::GetDrawBounds()
+{
+	if (worldMatrixDirty)
+		UpdateTransform();
+	return drawBounds;
 }
 
 XMFLOAT4X4 Entity::GetWorldMatrix()
 {
-	XMMATRIX trans = XMMatrixTranslation(position.x, position.y, position.z);
-	XMMATRIX rot = XMMatrixRotationRollPitchYawFromVector(XMLoadFloat3(&rotation));
-	XMMATRIX scle = XMMatrixScaling(scale.x, scale.y, scale.z);
-	XMMATRIX world = scle * rot * trans;
-	//world = XMMatrixMultiply(XMMatrixIdentity(), world);
-	XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(world));
+	if (worldMatrixDirty)
+		UpdateTransform();
 	return worldMatrix;
 }
 
+void Entity::TransformChanged()
+{
+	worldMatrixDirty = true;
+	boundingBoxDirty = true;
+}
+
+// -----------------------------------------------------
+// The bounding box follows the simulated pose, the
+// world matrix the interpolated one that is drawn
+// -----------------------------------------------------
+void Entity::UpdateTransform()
+{
+	if (boundingBoxDirty)
+	{
+		worldBoundingBox = boundingBox;
+		worldBoundingBox.Center = position;
+		worldBoundingBox.Extents.x *= scale.x;
+		worldBoundingBox.Extents.y *= scale.y;
+		worldBoundingBox.Extents.z *= scale.z;
+		auto rot = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rotation));
+		XMStoreFloat4(&worldBoundingBox.Orientation, rot);
+		boundingBoxDirty = false;
+	}
+
+	if (worldMatrixDirty)
+	{
+		XMVECTOR pos = XMVectorLerp(XMLoadFloat3(&previousPosition), XMLoadFloat3(&position), interpolation);
+		XMVECTOR angles = XMVectorLerp(XMLoadFloat3(&previousRotation), XMLoadFloat3(&rotation), interpolation);
+		XMMATRIX trans = XMMatrixTranslationFromVector(pos);
+		XMMATRIX rot = XMMatrixRotationRollPitchYawFromVector(angles);
+		XMMATRIX scle = XMMatrixScaling(scale.x, scale.y, scale.z);
+		XMMATRIX world = scle * rot * trans;
+		XMStoreFloat4x4(&worldMatrix, XMMatrixTranspose(world));
+
+		// Around the middle of the mesh, grown by the largest scale
+		XMVECTOR localCenter = XMVectorZero();
+		XMVECTOR halfSize = XMLoadFloat3(&boundingBox.Extents);
+		if (mesh != nullptr)
+		{
+			XMFLOAT3 minV = mesh->GetMinDimensions();
+			XMFLOAT3 maxV = mesh->GetMaxDimensions();
+			localCenter = XMVectorScale(XMVectorAdd(XMLoadFloat3(&minV), XMLoadFloat3(&maxV)), 0.5f);
+			halfSize = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&maxV), XMLoadFloat3(&minV)), 0.5f);
+		}
+		float largestScale = (std::max)(fabsf(scale.x), (std::max)(fabsf(scale.y), fabsf(scale.z)));
+		XMStoreFloat3(&drawBounds.Center, XMVector3Transform(localCenter, world));
+		drawBounds.Radius = XMVectorGetX(XMVector3Length(halfSize)) * largestScale;
+		worldMatrixDirty = false;
+	}
+}
+
+// -----------------------------------------------------
+// Entities only touch their own transform, so big
+// batches are split across the job system
+// -----------------------------------------------------
+void Entity::UpdateTransforms(Entity* const* entities, int count, JobSystem* jobs)
+{
+	auto update = [entities](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			entities[i]->UpdateTransform();
+	};
+
+	if (jobs)
+		jobs->ParallelFor(count, TRANSFORM_GRAIN_SIZE, update);
+	else
+		update(0, count);
+}
+
 void Entity::SetPosition(XMFLOAT3 pos)
 {
 	position = pos;
+	previousPosition = pos;	// Teleports are not interpolated
 	boundingBox.Center = position;
+	TransformChanged();
 }
 
 void Entity::SetRotationZ(float angle)
 {
 	rotation.z = angle;
+	TransformChanged();
 }
 
 void Entity::SetRotation(float roll, float pitch, float yaw)
@@ -66,6 +143,7 @@ void Entity::SetRotation(float roll, float pitch, float yaw)
 	rotation.x = roll;
 	rotation.y = pitch;
 	rotation.z = yaw;
+	TransformChanged();
 }
 
 void Entity::SetPosition(float x, float y, float z)
@@ -73,7 +151,9 @@ void Entity::SetPosition(float x, float y, float z)
 	this->position.x = x;
 	this->position.y = y;
 	this->position.z = z;
+	previousPosition = position;	// Teleports are not interpolated
 	boundingBox.Center = position;
+	TransformChanged();
 }
 
 void Entity::SetScale(float x, float y, float z)
@@ -81,6 +161,7 @@ void Entity::SetScale(float x, float y, float z)
 	this->scale.x = x;
 	this->scale.y = y;
 	this->scale.z = z;
+	TransformChanged();
 }
 
 XMFLOAT3 Entity::GetScale()
@@ -91,11 +172,13 @@ XMFLOAT3 Entity::GetScale()
 void Entity::RotateX(float angle)
 {
 	rotation.x += angle;
+	TransformChanged();
 }
 
 void Entity::RotateY(float angle)
 {
 	rotation.y += angle;
+	TransformChanged();
 }
 
 void Entity::SetMaterial(Material * mat)
@@ -109,29 +192,31 @@ void Entity::Move(XMFLOAT3 offset)
 	auto off = XMLoadFloat3(&offset);
 	auto newPos = XMVectorAdd(pos, off);
 	XMStoreFloat3(&position, newPos);
+	TransformChanged();
+}
+
+void Entity::SaveState()
+{
+	previousPosition = position;
+	previousRotation = rotation;
+	worldMatrixDirty = true;
+}
+
+void Entity::Interpolate(float alpha)
+{
+	if (alpha != interpolation)
+		worldMatrixDirty = true;
+	interpolation = alpha;
 }
 
 void Entity::PrepareMaterialWithShadows(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix, XMFLOAT4X4 shadowViewMatrix, XMFLOAT4X4 shadowProjectionMatrix, ID3D11SamplerState* shadowSampler, ID3D11ShaderResourceView* shadowSRV)
 {
 	auto vertexShader = material->GetVertexShader();
 	auto pixelShader = material->GetPixelShader();
-	//auto vertexShader = vs;
-	//auto pixelShader = ps;
-	vertexShader->SetMatrix4x4("world", GetWorldMatrix());
-	vertexShader->SetMatrix4x4("view", viewMatrix);
-	vertexShader->SetMatrix4x4("projection", projectionMatrix);
-
-	vertexShader->SetMatrix4x4("shadowView", shadowViewMatrix);
-	vertexShader->SetMatrix4x4("shadowProjection", shadowProjectionMatrix);
-	pixelShader->SetSamplerState("basicSampler", material->GetSampler());
-	pixelShader->SetSamplerState("shadowSampler", shadowSampler);
-	pixelShader->SetShaderResourceView("diffuseTexture", material->GetSRV());
-	pixelShader->SetShaderResourceView("shadowMapTexture", shadowSRV);
-	if (material->GetNormalSRV())
-		pixelShader->SetShaderResourceView("normalTexture", material->GetNormalSRV());
-	else pixelShader->SetShaderResourceView("normalTexture", nullptr);
-
-	pixelShader->SetShaderResourceView("roughnessTexture", material->GetRoughnessSRV());
+	SetTransforms(viewMatrix, projectionMatrix);
+	SetShadowTransforms(shadowViewMatrix, shadowProjectionMatrix);
+	BindMaterial();
+	BindShadowMap(shadowSampler, shadowSRV);
 	vertexShader->CopyAllBufferData();
 	pixelShader->CopyAllBufferData();
 	vertexShader->SetShader();
@@ -142,33 +227,55 @@ void Entity::PrepareMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
 {
 	auto vertexShader = material->GetVertexShader();
 	auto pixelShader = material->GetPixelShader();
-	vertexShader->SetMatrix4x4("world", GetWorldMatrix());
-	vertexShader->SetMatrix4x4("view", viewMatrix);
-	vertexShader->SetMatrix4x4("projection", projectionMatrix);
-
-	pixelShader->SetSamplerState("basicSampler", material->GetSampler());
-	pixelShader->SetShaderResourceView("diffuseTexture", material->GetSRV());
-
-	if (material->GetNormalSRV())
-		pixelShader->SetShaderResourceView("normalTexture", material->GetNormalSRV());
-	else
-		pixelShader->SetShaderResourceView("normalTexture", nullptr);
-
-	pixelShader->SetShaderResourceView("roughnessTexture", material->GetRoughnessSRV());
+	SetTransforms(viewMatrix, projectionMatrix);
+	BindMaterial();
 	vertexShader->CopyAllBufferData();
 	pixelShader->CopyAllBufferData();
 	vertexShader->SetShader();
 	pixelShader->SetShader();
 }
 
+void Entity::SetTransforms(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix)
+{
+	auto vertexShader = material->GetVertexShader();
+	auto& handles = material->GetHandles();
+	vertexShader->SetMatrix4x4(handles.world, GetWorldMatrix());
+	vertexShader->SetMatrix4x4(handles.view, viewMatrix);
+	vertexShader->SetMatrix4x4(handles.projection, projectionMatrix);
+}
+
+void Entity::SetShadowTransforms(XMFLOAT4X4 shadowViewMatrix, XMFLOAT4X4 shadowProjectionMatrix)
+{
+	auto vertexShader = material->GetVertexShader();
+	auto& handles = material->GetHandles();
+	vertexShader->SetMatrix4x4(handles.shadowView, shadowViewMatrix);
+	vertexShader->SetMatrix4x4(handles.shadowProjection, shadowProjectionMatrix);
+}
+
+void Entity::BindMaterial()
+{
+	auto pixelShader = material->GetPixelShader();
+	auto& handles = material->GetHandles();
+	pixelShader->SetSamplerState(handles.basicSampler, material->GetSampler());
+	pixelShader->SetShaderResourceView(handles.diffuseTexture, material->GetSRV());
+	pixelShader->SetShaderResourceView(handles.normalTexture, material->GetNormalSRV());
+	pixelShader->SetShaderResourceView(handles.roughnessTexture, material->GetRoughnessSRV());
+}
+
+void Entity::BindShadowMap(ID3D11SamplerState* shadowSampler, ID3D11ShaderResourceView* shadowSRV)
+{
+	auto pixelShader = material->GetPixelShader();
+	auto& handles = material->GetHandles();
+	pixelShader->SetSamplerState(handles.shadowSampler, shadowSampler);
+	pixelShader->SetShaderResourceView(handles.shadowMapTexture, shadowSRV);
+}
+
 void Entity::PrepareMaterialAnimated(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix, FBXLoader *fbxLoader)
 {
 	auto vertexShader = material->GetVertexShader();
 	auto pixelShader = material->GetPixelShader();
 
-	vertexShader->SetMatrix4x4("world", GetWorldMatrix());
-	vertexShader->SetMatrix4x4("view", viewMatrix);
-	vertexShader->SetMatrix4x4("projection", projectionMatrix);
+	SetTransforms(viewMatrix, projectionMatrix);
 
 	int bonesSize = 0;
 	bonesSize = (sizeof(XMFLOAT4X4) * 20 * 2);
@@ -212,10 +319,7 @@ void Entity::PrepareMaterialAnimated(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectio
 	*/
 	//vertexShader->SetInt("instanceNumber", instanceNumber);
 
-	pixelShader->SetSamplerState("basicSampler", material->GetSampler());
-	pixelShader->SetShaderResourceView("diffuseTexture", material->GetSRV());
-	pixelShader->SetShaderResourceView("normalTexture", material->GetNormalSRV());
-	pixelShader->SetShaderResourceView("roughnessTexture", material->GetRoughnessSRV());
+	BindMaterial();
 
 	vertexShader->CopyAllBufferData();
 	pixelShader->CopyAllBufferData();
@@ -223,64 +327,6 @@ void Entity::PrepareMaterialAnimated(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectio
 	pixelShader->SetShader();
 }
 
-void Entity::SetLights(std::unordered_map<std::string, DirectionalLight> lights)
-{
-	auto pixelShader = material->GetPixelShader();
-	for (auto lightPair : lights)
-	{
-		auto light = lightPair.second;
-		pixelShader->SetData(lightPair.first, &light, sizeof(DirectionalLight));
-	}
-}
-
-void Entity::SetLights(std::unordered_map<std::string, Light*> lights)
-{
-	auto pixelShader = material->GetPixelShader();
-	std::vector<DirectionalLight> dirLights;
-	std::vector<PointLight> pointLights;
-	std::for_each(lights.begin(), lights.end(), [&](std::pair<const std::string, Light*>  & element) {
-		switch (element.second->Type)
-		{
-		case Directional:
-		{
-			auto light = *element.second->GetLight<DirectionalLight>();
-			dirLights.push_back(light);
-			break;
-		}
-		case Point:
-			auto light = *element.second->GetLight<PointLight>();
-			pointLights.push_back(light);
-			break;
-		}
-	});
-	int dirLightCount = (int)dirLights.size();
-	int pointLightCount = (int)pointLights.size();
-	pixelShader->SetInt("DirectionalLightCount", dirLightCount);
-	pixelShader->SetInt("PointLightCount", pointLightCount);
-	pixelShader->SetData("dirLights", dirLights.data(), sizeof(DirectionalLight) * MAX_LIGHTS);
-	pixelShader->SetData("pointLights", pointLights.data(), sizeof(PointLight) * MAX_LIGHTS);
-
-	for (auto lightPair : lights)
-	{
-		auto light = lightPair.second;
-		switch (light->Type)
-		{
-		case Directional:
-			pixelShader->SetData(lightPair.first, light->GetLight<DirectionalLight>(), sizeof(DirectionalLight));
-			break;
-		case Point:
-			pixelShader->SetData(lightPair.first, light->GetLight<PointLight>(), sizeof(PointLight));
-			break;
-		}
-	}
-}
-
-void Entity::SetCameraPosition(XMFLOAT3 position)
-{
-	auto pixelShader = material->GetPixelShader();
-	pixelShader->SetFloat3("cameraPosition", position);
-}
-
 void Entity::Update(float deltaTime, float totalTime)
 {
 }
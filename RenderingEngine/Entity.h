@@ -5,6 +5,7 @@
 #include "Lights.h"
 #include <DirectXCollision.h>
 #include "FBXLoader.h"
+#include "JobSystem.h"
 
 using namespace DirectX;
 class Entity
@@ -14,11 +15,24 @@ protected:
 	DirectX::XMFLOAT3 position;
 	DirectX::XMFLOAT3 scale;
 	DirectX::XMFLOAT3 rotation;
+	DirectX::XMFLOAT3 previousPosition;
+	DirectX::XMFLOAT3 previousRotation;
+	float interpolation;
 	BoundingOrientedBox boundingBox;
+
+	// Cached results of the transform, rebuilt when something moved
+	BoundingOrientedBox worldBoundingBox;
+	BoundingSphere drawBounds;
+	bool worldMatrixDirty;
+	bool boundingBoxDirty;
+	void TransformChanged();
 	Mesh *mesh;
 	Material* material;
 public:
 	BoundingOrientedBox GetBoundingBox();
+
+	// Sphere around the mesh where it is drawn this frame, used for culling
+	BoundingSphere GetDrawBounds();
 	XMFLOAT4X4 GetWorldMatrix();
 	XMFLOAT3 GetPosition();
 	XMFLOAT3 GetScale();
@@ -31,12 +45,28 @@ public:
 	void SetPosition(float x, float y, float z);
 	void SetScale(float x, float y, float z);
 	void Move(XMFLOAT3 offset);
+
+	// The simulation runs in fixed steps. SaveState keeps the pose from
+	// before a step, Interpolate sets how far from there towards the
+	// current pose the world matrix is drawn (1 = current pose).
+	void SaveState();
+	void Interpolate(float alpha);
+
+	// Rebuilds the world matrix and bounding box if they are out of date.
+	// The getters do this too, but doing every entity in one pass once
+	// the frame's movement is done keeps it out of the draw calls.
+	void UpdateTransform();
+	static void UpdateTransforms(Entity* const* entities, int count, JobSystem* jobs = nullptr);
 	virtual void PrepareMaterialWithShadows(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix, XMFLOAT4X4 shadowViewMatrix, XMFLOAT4X4 shadowProjectionMatrix, ID3D11SamplerState* shadowSampler, ID3D11ShaderResourceView* shadowSRV);
 	virtual void PrepareMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix);
+
+	// The pieces of PrepareMaterial, so the render queue can leave out
+	// whatever the previous draw already bound
+	void SetTransforms(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix);
+	void SetShadowTransforms(XMFLOAT4X4 shadowViewMatrix, XMFLOAT4X4 shadowProjectionMatrix);
+	void BindMaterial();
+	void BindShadowMap(ID3D11SamplerState* shadowSampler, ID3D11ShaderResourceView* shadowSRV);
 	void PrepareMaterialAnimated(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix, FBXLoader*);
-	void SetLights(std::unordered_map<std::string, DirectionalLight> lights);
-	void SetLights(std::unordered_map<std::string, Light*> lights);
-	void SetCameraPosition(XMFLOAT3 position);
 	virtual void Update(float deltaTime, float totalTime);
 	Mesh *GetMesh();
 	Material *GetMaterial();
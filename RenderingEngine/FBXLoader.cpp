@@ -1,4 +1,6 @@
 #include "FBXLoader.h"
+#include "VertexWeld.h"
+#include "MeshOptimizer.h"
 
 #ifdef IOS_REF
 #undef  IOS_REF
@@ -6,11 +8,11 @@
 #endif
 
 
-FBXLoader::FBXLoader()
+FBXLoader::FBXLoader(const char* filename)
 {
 	InitializeSdkObjects();
 
-	FbxString lFilePath("../../RuddFishAnimated.fbx");
+	FbxString lFilePath(filename);
 
 	if (lFilePath.IsEmpty())
 	{
@@ -442,6 +444,11 @@ Mesh* FBXLoader::GetMesh(FbxNode * node , ID3D11Device* device)
 		
 		//std::shared_ptr<Mesh> M(new Mesh(&vertices[0], vertexCount, &indices[0], indexCount, device));
 
+		// Control points that ended up with the same attributes and bones are one vertex
+		WeldVertices(vertices, indices);
+		OptimizeMesh(vertices, indices);
+		vertexCount = (int)vertices.size();
+		indexCount = (int)indices.size();
 		return(new Mesh(&vertices[0], vertexCount, &indices[0], indexCount, device));
 	}
 	else
@@ -490,6 +497,39 @@ void FBXLoader::GetAnimatedMatrixExtra()
 
 
 
+// -----------------------------------------------------
+// Each joint's bone and inverse bind pose are
+// multiplied together ahead of time, so the shader
+// only has to blend one matrix per influence
+// -----------------------------------------------------
+void FBXLoader::BakeAnimation(int frameCount, double length, XMFLOAT4X4* skinning, int boneCapacity)
+{
+	FbxTime current = time;
+	int jointCount = (int)skeleton.mJoints.size();
+	if (jointCount > boneCapacity)
+		jointCount = boneCapacity;
+
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		time.SetSecondDouble(length * frame / frameCount);
+		XMFLOAT4X4* frameSkinning = skinning + frame * boneCapacity;
+		for (int i = 0; i < boneCapacity; i++)
+		{
+			if (i >= jointCount)
+			{
+				XMStoreFloat4x4(&frameSkinning[i], XMMatrixIdentity());
+				continue;
+			}
+
+			XMFLOAT4X4 jointTransform = GetJointGlobalTransform(i);
+			XMMATRIX bone = XMLoadFloat4x4(&jointTransform);
+			XMMATRIX inverseBindpose = XMLoadFloat4x4(&skeleton.mJoints[i].mGlobalBindposeInverse);
+			XMStoreFloat4x4(&frameSkinning[i], XMMatrixTranspose(XMMatrixMultiply(bone, inverseBindpose)));
+		}
+	}
+	time = current;
+}
+
 XMFLOAT4X4 FBXLoader::GetJointGlobalTransform(int boneIndex)
 {
 	FbxAMatrix jointTransform;
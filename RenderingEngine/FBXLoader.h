@@ -73,7 +73,7 @@ public:
 
 	Skeleton skeleton;
 
-	FBXLoader();
+	FBXLoader(const char* filename);
 	~FBXLoader();
 
 	void InitializeSdkObjects();
@@ -84,6 +84,10 @@ public:
 	unsigned int FindJointIndex(const std::string &);
 	void GetAnimatedMatrix();
 	void GetAnimatedMatrixExtra();
+
+	// Samples frameCount evenly spaced times over length seconds into
+	// skinning, boneCapacity transposed matrices per frame
+	void BakeAnimation(int frameCount, double length, DirectX::XMFLOAT4X4* skinning, int boneCapacity);
 	XMFLOAT4X4 GetJointGlobalTransform(int);
 	XMFLOAT4X4 FbxAMatrixToXMFloat4x4(FbxAMatrix);
 };
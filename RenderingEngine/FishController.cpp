@@ -1,11 +1,12 @@
 #include "FishController.h"
-#include <time.h>
+#include <cmath>
+#include <algorithm>
 
 
 XMFLOAT3 FishController::RandomOffsetFromStart()
 {
-	float xOffset = (float)(rand() % 1200 + 1) / 50;
-	float zOffset = -(float)(rand() % 1800 + 1) / 50;
+	float xOffset = (float)random.NextInt(1, 1200) / 50;
+	float zOffset = -(float)random.NextInt(1, 1800) / 50;
 	auto pos = startPosition;
 	pos.x += xOffset;
 	pos.z += zOffset;
@@ -26,14 +27,149 @@ void FishController::Update(float deltaTime, float totalTime)
 	}
 }
 
-void FishController::Render(Renderer* renderer)
+void FishController::SaveState()
 {
 	for (auto e : entities)
 	{
-		renderer->Draw(e);
+		e->SaveState();
 	}
 }
 
+void FishController::Interpolate(float alpha)
+{
+	for (auto e : entities)
+	{
+		e->Interpolate(alpha);
+	}
+}
+
+// -----------------------------------------------------
+// Sample the swim cycle once. Every fish reads the
+// same frames, only its phase differs.
+// -----------------------------------------------------
+void FishController::InitializeInstancing(ID3D11Device* device, ID3D11DeviceContext* context, SimpleVertexShader* instancedVS, FBXLoader* animation)
+{
+	this->device = device;
+	this->context = context;
+	this->instancedVS = instancedVS;
+	viewHandle = instancedVS->GetVariableHandle("view");
+	projectionHandle = instancedVS->GetVariableHandle("projection");
+
+	std::vector<XMFLOAT4X4> skinning(FISH_ANIMATION_FRAMES * MAX_FISH_BONES);
+	animation->BakeAnimation(FISH_ANIMATION_FRAMES, FISH_ANIMATION_LENGTH, skinning.data(), MAX_FISH_BONES);
+	instancedVS->SetData("skinning", skinning.data(), (unsigned int)(sizeof(XMFLOAT4X4) * skinning.size()));
+
+	ReserveInstances(fishCount);
+}
+
+void FishController::ReserveInstances(int count)
+{
+	if (count <= instanceCapacity)
+		return;
+
+	int capacity = (std::max)(instanceCapacity, FISH_INSTANCE_CAPACITY);
+	while (capacity < count)
+		capacity *= 2;
+
+	if (instanceBuffer)
+		instanceBuffer->Release();
+	instanceBuffer = nullptr;
+	instanceCapacity = 0;
+
+	D3D11_BUFFER_DESC instanceBufferDesc = {};
+	instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	instanceBufferDesc.ByteWidth = sizeof(FishInstance) * capacity;
+	instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (SUCCEEDED(device->CreateBuffer(&instanceBufferDesc, nullptr, &instanceBuffer)))
+		instanceCapacity = capacity;
+}
+
+// -----------------------------------------------------
+// Cull, pack the survivors' world matrices and phases
+// into the instance buffer, then one draw for all
+// -----------------------------------------------------
+int FishController::RenderInstanced(Camera* camera, float totalTime)
+{
+	int count = (int)entities.size();
+	if (!instancedVS || count == 0)
+		return 0;
+
+	int paddedCount = (count + 3) & ~3;
+	if ((int)boundsX.size() < paddedCount)
+	{
+		boundsX.resize(paddedCount);
+		boundsY.resize(paddedCount);
+		boundsZ.resize(paddedCount);
+		boundsRadius.resize(paddedCount);
+		visibleIndices.resize(paddedCount);
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		BoundingSphere bounds = entities[i]->GetDrawBounds();
+		boundsX[i] = bounds.Center.x;
+		boundsY[i] = bounds.Center.y;
+		boundsZ[i] = bounds.Center.z;
+		boundsRadius[i] = bounds.Radius;
+	}
+
+	int visibleCount = FrustumCuller::CullSpheres(camera->GetFrustum(), boundsX.data(), boundsY.data(), boundsZ.data(), boundsRadius.data(), count, visibleIndices.data());
+	if (visibleCount == 0)
+		return 0;
+
+	ReserveInstances(visibleCount);
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (!instanceBuffer || FAILED(context->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return 0;
+
+	float cycle = totalTime / FISH_ANIMATION_LENGTH;
+	FishInstance* instances = (FishInstance*)mapped.pData;
+	for (int i = 0; i < visibleCount; ++i)
+	{
+		int index = visibleIndices[i];
+		instances[i].world = entities[index]->GetWorldMatrix();
+		instances[i].phase = cycle + phaseOffsets[index];
+		instances[i].phase -= floorf(instances[i].phase);
+	}
+	context->Unmap(instanceBuffer, 0);
+
+	commandList.Reset();
+	commandList.SetVertexBuffer(0, mesh->GetVertexBuffer(), sizeof(VertexAnimated));
+	commandList.SetVertexBuffer(1, instanceBuffer, sizeof(FishInstance));
+	commandList.SetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT);
+	commandList.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	auto pixelShader = material->GetPixelShader();
+	instancedVS->SetCommandList(&commandList);
+	pixelShader->SetCommandList(&commandList);
+
+	instancedVS->SetMatrix4x4(viewHandle, camera->GetViewMatrix());
+	instancedVS->SetMatrix4x4(projectionHandle, camera->GetProjectionMatrix());
+	instancedVS->CopyAllBufferData();
+	instancedVS->SetShader();
+
+	auto& handles = material->GetHandles();
+	pixelShader->SetSamplerState(handles.basicSampler, material->GetSampler());
+	pixelShader->SetShaderResourceView(handles.diffuseTexture, material->GetSRV());
+	pixelShader->SetShaderResourceView(handles.normalTexture, material->GetNormalSRV());
+	pixelShader->SetShaderResourceView(handles.roughnessTexture, material->GetRoughnessSRV());
+	pixelShader->CopyAllBufferData();
+	pixelShader->SetShader();
+
+	instancedVS->SetCommandList(nullptr);
+	pixelShader->SetCommandList(nullptr);
+
+	commandList.DrawIndexedInstanced((UINT)mesh->GetIndexCount(), visibleCount);
+	D3D11CommandBackend backend(context);
+	commandList.Execute(backend);
+	return visibleCount;
+}
+
+const std::vector<Entity*>& FishController::GetEntities() const
+{
+	return entities;
+}
+
 bool FishController::CheckForCollision(Entity * entity)
 {
 	for (auto e : entities)
@@ -48,9 +184,19 @@ bool FishController::CheckForCollision(Entity * entity)
 	return false;
 }
 
-FishController::FishController(Mesh* mesh, Material* mat, int count, XMFLOAT3 startPos, XMFLOAT3 endPos, float resetThreshold, XMFLOAT3 defaultRotation, XMFLOAT3 defaultScale)
+FishController::FishController(Mesh* mesh, Material* mat, int count, XMFLOAT3 startPos, XMFLOAT3 endPos, float resetThreshold, XMFLOAT3 defaultRotation, XMFLOAT3 defaultScale, uint64_t seed)
 {
+	random.Seed(seed);
 	speed = 4.f;
+	this->mesh = mesh;
+	material = mat;
+	device = nullptr;
+	context = nullptr;
+	instancedVS = nullptr;
+	viewHandle = SIMPLE_SHADER_INVALID_HANDLE;
+	projectionHandle = SIMPLE_SHADER_INVALID_HANDLE;
+	instanceBuffer = nullptr;
+	instanceCapacity = 0;
 	fishCount = count;
 	startPosition = startPos;
 	endPosition = endPos;
@@ -69,10 +215,8 @@ FishController::FishController(Mesh* mesh, Material* mat, int count, XMFLOAT3 st
 			//entity->SetScale(defaultScale.x, defaultScale.y, -defaultScale.z);
 
 		entities.push_back(entity);
+		phaseOffsets.push_back(random.NextFloat());
 	}
-
-	srand((unsigned int)time(nullptr));
-	
 }
 
 
@@ -83,4 +227,5 @@ FishController::~FishController()
 		delete entity;
 	}
 	entities.clear();
+	if (instanceBuffer)instanceBuffer->Release();
 }
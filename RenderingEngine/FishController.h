@@ -1,6 +1,26 @@
 #pragma once
 #include "Renderer.h"
 #include "Entity.h"
+#include "Random.h"
+#include "FBXLoader.h"
+#include "Frustum.h"
+#include "D3D11CommandBackend.h"
+
+// Keep in sync with AnimationInstancedVS.hlsl
+#define MAX_FISH_BONES 20
+#define FISH_ANIMATION_FRAMES 32
+
+// Seconds the swim cycle takes to loop
+#define FISH_ANIMATION_LENGTH 3.0f
+
+// The instance buffer starts out this big and doubles when it runs out
+#define FISH_INSTANCE_CAPACITY 64
+
+struct FishInstance
+{
+	XMFLOAT4X4 world;
+	float phase;
+};
 
 class FishController
 {
@@ -10,13 +30,48 @@ class FishController
 	float resetThresholdDistance;
 	std::vector<Entity*> entities;
 	XMFLOAT3 RandomOffsetFromStart();
+	Random random;
 	XMFLOAT3 rotation;
 	float speed;
+
+	// Where in the swim cycle each fish starts, so they don't all
+	// flick their tails together
+	std::vector<float> phaseOffsets;
+
+	Mesh* mesh;
+	Material* material;
+	ID3D11Device* device;
+	ID3D11DeviceContext* context;
+	SimpleVertexShader* instancedVS;
+	int viewHandle;
+	int projectionHandle;
+	ID3D11Buffer* instanceBuffer;
+	int instanceCapacity;
+	CommandList commandList;
+
+	// Draw bounds of every fish, one array per component padded to a
+	// multiple of 4 for the culler
+	std::vector<float> boundsX;
+	std::vector<float> boundsY;
+	std::vector<float> boundsZ;
+	std::vector<float> boundsRadius;
+	std::vector<int> visibleIndices;
+	void ReserveInstances(int count);
 public:
 	void Update(float deltaTime, float totalTime);
-	void Render(Renderer* renderer);
+	void SaveState();
+	void Interpolate(float alpha);
+
+	// Bakes the swim cycle for the instanced shader, call once the
+	// animation is loaded
+	void InitializeInstancing(ID3D11Device* device, ID3D11DeviceContext* context, SimpleVertexShader* instancedVS, FBXLoader* animation);
+
+	// Draws every fish inside the camera's frustum with one call.
+	// Returns how many were drawn.
+	int RenderInstanced(Camera* camera, float totalTime);
 	bool CheckForCollision(Entity* entity);
-	FishController(Mesh* mesh, Material* mat, int count, XMFLOAT3 startPos, XMFLOAT3 endPos, float resetThreshold, XMFLOAT3 defaultRotation, XMFLOAT3 defaultScale);
+	const std::vector<Entity*>& GetEntities() const;
+	FishController(Mesh* mesh, Material* mat, int count, XMFLOAT3 startPos, XMFLOAT3 endPos, float resetThreshold, XMFLOAT3 defaultRotation, XMFLOAT3 defaultScale, uint64_t seed = 0);
 	~FishController();
 };
 
@@ -0,0 +1,185 @@
+#include "Frustum.h"
+#include "Entity.h"
+#include "Random.h"
+#include <chrono>
+
+using namespace DirectX;
+
+Frustum::Frustum()
+{
+	for (int i = 0; i < 6; i++)
+		planes[i] = XMFLOAT4(0, 0, 0, 0);
+}
+
+// -----------------------------------------------------
+// Each plane is a sum or difference of the matrix
+// columns (Gribb & Hartmann). D3D clip space depth
+// runs 0 to w, so the near plane is the third column.
+// -----------------------------------------------------
+Frustum::Frustum(FXMMATRIX viewProjection)
+{
+	XMMATRIX columns = XMMatrixTranspose(viewProjection);
+	XMVECTOR results[6] =
+	{
+		XMVectorAdd(columns.r[3], columns.r[0]),		// Left
+		XMVectorSubtract(columns.r[3], columns.r[0]),	// Right
+		XMVectorAdd(columns.r[3], columns.r[1]),		// Bottom
+		XMVectorSubtract(columns.r[3], columns.r[1]),	// Top
+		columns.r[2],									// Near
+		XMVectorSubtract(columns.r[3], columns.r[2])	// Far
+	};
+
+	for (int i = 0; i < 6; i++)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(results[i]));
+}
+
+// -----------------------------------------------------
+// A plane every point is a unit in front of
+// -----------------------------------------------------
+void Frustum::RemoveNearPlane()
+{
+	planes[4] = XMFLOAT4(0, 0, 0, 1);
+}
+
+FrustumCuller::FrustumCuller()
+{
+}
+
+// -----------------------------------------------------
+// Gather the cached spheres, then test them in bulk
+// -----------------------------------------------------
+int FrustumCuller::Cull(const Frustum& frustum, Entity* const* entities, int count, std::vector<Entity*>& visible)
+{
+	int paddedCount = (count + 3) & ~3;
+	if ((int)x.size() < paddedCount)
+	{
+		x.resize(paddedCount);
+		y.resize(paddedCount);
+		z.resize(paddedCount);
+		radius.resize(paddedCount);
+		visibleIndices.resize(paddedCount);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		BoundingSphere bounds = entities[i]->GetDrawBounds();
+		x[i] = bounds.Center.x;
+		y[i] = bounds.Center.y;
+		z[i] = bounds.Center.z;
+		radius[i] = bounds.Radius;
+	}
+
+	int visibleCount = CullSpheres(frustum, x.data(), y.data(), z.data(), radius.data(), count, visibleIndices.data());
+	for (int i = 0; i < visibleCount; i++)
+		visible.push_back(entities[visibleIndices[i]]);
+	return visibleCount;
+}
+
+// -----------------------------------------------------
+// A sphere is out once it is completely behind any
+// one plane. Padding past count is read but never
+// reported.
+// -----------------------------------------------------
+int FrustumCuller::CullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius, int count, int* visibleIndices)
+{
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = XMVectorReplicate(frustum.planes[p].x);
+		planeY[p] = XMVectorReplicate(frustum.planes[p].y);
+		planeZ[p] = XMVectorReplicate(frustum.planes[p].z);
+		planeW[p] = XMVectorReplicate(frustum.planes[p].w);
+	}
+
+	int visibleCount = 0;
+	for (int i = 0; i < count; i += 4)
+	{
+		XMVECTOR centerX = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(x + i));
+		XMVECTOR centerY = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(y + i));
+		XMVECTOR centerZ = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(z + i));
+		XMVECTOR negativeRadius = XMVectorNegate(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(radius + i)));
+
+		XMVECTOR inside = XMVectorTrueInt();
+		for (int p = 0; p < 6; p++)
+		{
+			XMVECTOR distance = XMVectorMultiplyAdd(centerX, planeX[p],
+				XMVectorMultiplyAdd(centerY, planeY[p],
+				XMVectorMultiplyAdd(centerZ, planeZ[p], planeW[p])));
+			inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(distance, negativeRadius));
+		}
+
+		uint32_t mask[4];
+		XMStoreInt4(mask, inside);
+		int remaining = count - i < 4 ? count - i : 4;
+		for (int j = 0; j < remaining; j++)
+		{
+			if (mask[j])
+				visibleIndices[visibleCount++] = i + j;
+		}
+	}
+	return visibleCount;
+}
+
+// -----------------------------------------------------
+// Entities scattered around a camera near the origin.
+// Needs no device.
+// -----------------------------------------------------
+bool FrustumCuller::Benchmark(int entityCount, int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	Random random(1);
+	std::vector<Entity*> entities;
+	entities.reserve(entityCount);
+	for (int i = 0; i < entityCount; i++)
+	{
+		Entity* entity = new Entity(nullptr, nullptr);
+		entity->SetPosition(random.NextFloat(-300, 300), random.NextFloat(-50, 50), random.NextFloat(-300, 300));
+		float size = random.NextFloat(0.5f, 5.0f);
+		entity->SetScale(size, size, size);
+		entity->UpdateTransform();
+		entities.push_back(entity);
+	}
+
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 3, -15, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 0.1f, 300.0f);
+	Frustum frustum(view * projection);
+
+	// One by one, the way a draw loop would without the culler
+	int referenceCount = 0;
+	XMVECTOR planes[6];
+	for (int p = 0; p < 6; p++)
+		planes[p] = XMLoadFloat4(&frustum.planes[p]);
+	auto start = Clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		referenceCount = 0;
+		for (Entity* entity : entities)
+		{
+			BoundingSphere bounds = entity->GetDrawBounds();
+			if (bounds.ContainedBy(planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]) != DISJOINT)
+				referenceCount++;
+		}
+	}
+	auto referenceEnd = Clock::now();
+
+	FrustumCuller culler;
+	std::vector<Entity*> visible;
+	visible.reserve(entityCount);
+	for (int n = 0; n < iterations; n++)
+	{
+		visible.clear();
+		culler.Cull(frustum, entities.data(), entityCount, visible);
+	}
+	auto cullEnd = Clock::now();
+
+	double referenceMs = std::chrono::duration<double, std::milli>(referenceEnd - start).count() / iterations;
+	double cullMs = std::chrono::duration<double, std::milli>(cullEnd - referenceEnd).count() / iterations;
+	printf("\nFrustum culling (%d entities): one at a time %.3f ms (%d visible), batched %.3f ms (%d visible)",
+		entityCount, referenceMs, referenceCount, cullMs, (int)visible.size());
+
+	for (Entity* entity : entities)
+		delete entity;
+	return referenceCount == (int)visible.size();
+}
+
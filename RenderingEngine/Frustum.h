@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+class Entity;
+
+//------------------------------------------------
+// Six normalized planes facing into the volume,
+// taken straight out of a view-projection matrix
+//------------------------------------------------
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+
+	Frustum();
+
+	// viewProjection maps row vectors, as DirectXMath builds it
+	Frustum(DirectX::FXMMATRIX viewProjection);
+
+	// Lets everything between the near plane and the eye through.
+	// Only makes sense when the rasterizer clamps depth instead of
+	// clipping it, like the shadow pass does.
+	void RemoveNearPlane();
+};
+
+//------------------------------------------------
+// Tests bounding spheres against a frustum four
+// at a time. The spheres are copied into one
+// array per component first so the test itself
+// only streams through floats.
+//------------------------------------------------
+class FrustumCuller
+{
+public:
+	FrustumCuller();
+
+	// Appends every entity whose draw bounds touch the frustum
+	// to visible, in the order given. Returns how many were added.
+	int Cull(const Frustum& frustum, Entity* const* entities, int count, std::vector<Entity*>& visible);
+
+	// Writes the indices of the visible spheres, returns how many.
+	// Arrays are padded to a multiple of 4.
+	static int CullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius, int count, int* visibleIndices);
+
+	// Times the gather and test against BoundingSphere::Intersects.
+	// False if they kept a different number of entities.
+	static bool Benchmark(int entityCount, int iterations);
+private:
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+	std::vector<int> visibleIndices;
+};
+
@@ -1,6 +1,7 @@
 #include "Game.h"
 #include "Vertex.h"
 #include "WaveVertexMath.h"
+#include <ctime>
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -25,7 +26,13 @@ Game::Game(HINSTANCE hInstance)
 	vertexShader = 0;
 	pixelShader = 0;
 	camera = nullptr;
+	resources = nullptr;
+	canvas = nullptr;
 	gameStarted = false;
+	sceneReady = false;
+	renderStats = {};
+	renderStatsFrames = 0;
+	renderStatsTime = 0.0f;
 
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -42,91 +49,96 @@ Game::Game(HINSTANCE hInstance)
 // --------------------------------------------------------
 Game::~Game()
 {
-	// Delete our simple shader objects, which
-	// will clean up their own internal DirectX stuff
-	for (auto entity : entities)
+	// Only the menu exists if the game was closed before the scene loaded
+	if (sceneReady)
 	{
-		delete entity;
-	}
-	entities.clear();
+		// Delete our simple shader objects, which
+		// will clean up their own internal DirectX stuff
+		for (auto entity : entities)
+		{
+			delete entity;
+		}
+		entities.clear();
 
-	for (auto model : models)
-	{
-		delete model.second;
-	}
+		for (auto model : models)
+		{
+			delete model.second;
+		}
 
-	for (auto lights : lightsMap) {
-		delete lights.second;
-	}
+		for (auto lights : lightsMap) {
+			delete lights.second;
+		}
 
-	/*for (auto ripple : ripples) {
-		delete ripple;
-	}*/
+		/*for (auto ripple : ripples) {
+			delete ripple;
+		}*/
 
-	lightsMap.clear();
-	models.clear();
-	delete vertexShader;
-	delete pixelShader;
-	delete camera;
-	delete renderer;
-	delete resources;
-	delete shadowVS;
-
-	skyDepthState->Release();
-	sampler->Release();
-	skyRastState->Release();
-
-	refractSampler->Release();
-	refractionRTV->Release();
-	refractionSRV->Release();
-
-	blendState->Release();
-
-	shadowDSV->Release();
-	shadowSRV->Release();
-	shadowSampler->Release();;
-	shadowRasterizer->Release();
-
-	postProcessSRV->Release();
-	postProcessRTV->Release();
-	bloomBlurRTV->Release();
-	bloomBlurSRV->Release();
-	bloomExtractRTV->Release();
-	bloomExtractSRV->Release();
-	bloomRTV->Release();
-	bloomSRV->Release();
-	dofBlurRTV->Release();
-	dofBlurSRV->Release();
-	dofRTV->Release();
-	dofSRV->Release();
-	lensFlareRTV->Release();
-	lensFlareSRV->Release();
-
-	lensFlareThresholdRTV->Release();
-	lensFlareThresholdSRV->Release();
-	ghostGenerateRTV->Release();
-	ghostGenerateSRV->Release();
-
-	displacementSampler->Release();
-	delete currentProjectile;
-	delete water;
-	delete hullShader;
-	delete domainShader;
-	particleBlendState->Release();
-	particleDepthState->Release();
+		lightsMap.clear();
+		models.clear();
+		delete vertexShader;
+		delete pixelShader;
+		delete camera;
+		delete renderer;
+		delete shadowVS;
+
+		skyDepthState->Release();
+		sampler->Release();
+		skyRastState->Release();
+
+		refractSampler->Release();
+		refractionRTV->Release();
+		refractionSRV->Release();
+
+		blendState->Release();
+
+		shadowDSV->Release();
+		shadowSRV->Release();
+		shadowSampler->Release();;
+		shadowRasterizer->Release();
+
+		postProcessSRV->Release();
+		postProcessRTV->Release();
+		bloomBlurRTV->Release();
+		bloomBlurSRV->Release();
+		bloomExtractRTV->Release();
+		bloomExtractSRV->Release();
+		bloomRTV->Release();
+		bloomSRV->Release();
+		dofBlurRTV->Release();
+		dofBlurSRV->Release();
+		dofRTV->Release();
+		dofSRV->Release();
+		lensFlareRTV->Release();
+		lensFlareSRV->Release();
 
+		lensFlareThresholdRTV->Release();
+		lensFlareThresholdSRV->Release();
+		ghostGenerateRTV->Release();
+		ghostGenerateSRV->Release();
+
+		displacementSampler->Release();
+		delete currentProjectile;
+		delete water;
+		delete hullShader;
+		delete domainShader;
+		particleBlendState->Release();
+		particleDepthState->Release();
+	}
+
+	delete resources;
 	delete canvas;
 	AudioEngine::Instance()->ShutDown();
 }
 
 // --------------------------------------------------------
 // Called once per program, after DirectX and the window
-// are initialized but before the game loop.
+// are initialized but before the game loop. Fails if
+// the asset manifest is missing.
 // --------------------------------------------------------
-void Game::Init()
+HRESULT Game::Init()
 {
 	ShowCursor(true);
-	projectileHitWater = false;
+	jobs = std::unique_ptr<JobSystem>(new JobSystem());
 	isDofEnabled = false;
 	RECT rect;
 	GetWindowRect(this->hWnd, &rect);
@@ -134,7 +146,13 @@ void Game::Init()
 	prevMousePos.y = height / 2 - 30;
 	SetCursorPos(rect.left + width / 2, rect.top + height / 2);
 	resources = new Resources(device, context, swapChain);
-	resources->LoadResources();
+	if (!resources->LoadResources(jobs.get()))
+		return E_FAIL;
+
+	// Only the menu has to be in for the first frame, the rest keeps
+	// loading on the workers and Update picks it up
+	resources->Wait(resources->GetGroup("menu"));
+	sceneAssets = resources->GetGroup("game");
 	
 	//Audio Engine
 	AudioEngine::Instance()->Init();
@@ -143,8 +161,17 @@ void Game::Init()
 	canvas = new Canvas(device, context, resources);
 	canvas->AssignMenuButtonFunction([&]() {gameStarted = true; canvas->StartGame(); });
 	canvas->AssignQuitButtonFunction([&]() {Quit(); });
+	return S_OK;
+}
 
+// --------------------------------------------------------
+// Everything that needs the scene's assets, called from
+// Update once the "game" group has loaded
+// --------------------------------------------------------
+void Game::InitializeScene()
+{
 	LoadShaders();
+	ResolveFrameHandles();
 	CreateCamera();
 	InitializeEntities();
 	InitializeRenderer();
@@ -302,7 +329,7 @@ void Game::Init()
 	D3D11_RASTERIZER_DESC shadowRastDesc = {};
 	shadowRastDesc.FillMode = D3D11_FILL_SOLID;
 	shadowRastDesc.CullMode = D3D11_CULL_BACK;
-	shadowRastDesc.DepthClipEnable = true;
+	shadowRastDesc.DepthClipEnable = false;	// Casters between the light and the near plane clamp to it
 	shadowRastDesc.DepthBias = 1000; // Multiplied by (smallest possible value > 0 in depth buffer)
 	shadowRastDesc.DepthBiasClamp = 0.0f;
 	shadowRastDesc.SlopeScaledDepthBias = 1.0f;
@@ -332,10 +359,24 @@ void Game::Init()
 	blend.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 	device->CreateBlendState(&blend, &particleBlendState);
 
+	// Room for plenty of splashes at once
+	particles = std::unique_ptr<ParticleSystem>(new ParticleSystem(device,
+		resources->vertexShaders.Find("particle"), resources->pixelShaders.Find("particle"), 4096, 64));
+	particles->SetJobSystem(jobs.get());
+
+	simulation.Initialize(SimulationObjects{ water, fishes.get(), particles.get(), currentProjectile,
+		entities[0], entities[1], resources->shaderResourceViews.Find("particle"), jobs.get() });
+	simulation.SetPlayerPosition(camera->GetPosition());
+	simulation.onSplash = [](XMFLOAT3 position)
+	{
+		AudioEngine::Instance()->PlaySounds("../../Assets/Sounds/splash.wav", AudioVector3{ position.x, position.y, position.z }, 30.0f);
+	};
+
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
 	// Essentially: "What kind of shape should the GPU draw with our data?"
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	sceneReady = true;
 }
 
 void Game::SetupPostProcess(bool resize)
@@ -479,13 +520,30 @@ void Game::CreateWater()
 	time = 0.0f;
 	translate = 0.0f;
 	water = new Water(50, 50);
-	water->Init(resources->materials["water"], device);
+	water->Init(resources->materials.Find("water"), device);
 	water->SetPosition(-125, -6, -150);
 	//waterbject->SetScale(3, 3, 3);
 	water->CreateWaves();
-	virtualVertices.SetVertices(water->GetVertices(), water->GetVertexCount());
-	virtualVertices.SetPosition(Vector3(-125, -6, -150));
-	resources->vertexShaders["water"]->SetData("waves", water->GetWaves(), sizeof(Wave) * NUM_OF_WAVES);
+	resources->vertexShaders.Find("water")->SetData("waves", water->GetWaves(), sizeof(Wave) * NUM_OF_WAVES);
+
+	// Everything DrawWater and the ripples set every frame
+	waterHandles.vertexShader = resources->vertexShaders.Find("water");
+	waterHandles.pixelShader = resources->pixelShaders.Find("water");
+	waterHandles.time = waterHandles.vertexShader->GetVariableHandle("time");
+	waterHandles.translate = waterHandles.pixelShader->GetVariableHandle("translate");
+	waterHandles.transparency = waterHandles.pixelShader->GetVariableHandle("transparency");
+	waterHandles.cameraPosition = waterHandles.pixelShader->GetVariableHandle("CameraPosition");
+	waterHandles.view = waterHandles.pixelShader->GetVariableHandle("view");
+	waterHandles.ripplePosition = waterHandles.pixelShader->GetVariableHandle("ripplePosition");
+	waterHandles.rippleRadius = waterHandles.pixelShader->GetVariableHandle("rippleRadius");
+	waterHandles.ringSize = waterHandles.pixelShader->GetVariableHandle("ringSize");
+	waterHandles.ripples = waterHandles.pixelShader->GetVariableHandle("ripples");
+	waterHandles.rippleCount = waterHandles.pixelShader->GetVariableHandle("rippleCount");
+	waterHandles.skyTexture = waterHandles.pixelShader->GetShaderResourceViewHandle("SkyTexture");
+	waterHandles.normalTextureTwo = waterHandles.pixelShader->GetShaderResourceViewHandle("normalTextureTwo");
+	waterHandles.scenePixels = waterHandles.pixelShader->GetShaderResourceViewHandle("ScenePixels");
+	waterHandles.waterSplash = waterHandles.pixelShader->GetShaderResourceViewHandle("waterSplash");
+	waterHandles.refractSampler = waterHandles.pixelShader->GetSamplerHandle("RefractSampler");
 
 #pragma region Displacement Mapping Disabled
 	//------------------------------- Displacement map test-----------------------------------
@@ -500,8 +558,8 @@ void Game::CreateWater()
 
 	device->CreateSamplerState(&samplerDesc, &displacementSampler);
 
-	resources->vertexShaders["water"]->SetShaderResourceView("displacementMap", resources->shaderResourceViews["waterDisplacement"]);
-	resources->vertexShaders["water"]->SetSamplerState("basicSampler", displacementSampler);
+	resources->vertexShaders.Find("water")->SetShaderResourceView("displacementMap", resources->shaderResourceViews.Find("waterDisplacement"));
+	resources->vertexShaders.Find("water")->SetSamplerState("basicSampler", displacementSampler);
 	//------------------------------- Displacement map test-----------------------------------
 #pragma endregion
 }
@@ -519,7 +577,7 @@ void Game::RenderEntityShadow(Entity * entity)
 	context->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
 
 	// Finish setting shadow-creation VS stuff
-	shadowVS->SetMatrix4x4("world", entity->GetWorldMatrix());
+	shadowVS->SetMatrix4x4(shaderHandles.shadowWorld, entity->GetWorldMatrix());
 	shadowVS->CopyAllBufferData();
 
 	// Finally do the actual drawing
@@ -537,6 +595,15 @@ void Game::RenderShadowMap()
 	XMMATRIX shProj = XMMatrixOrthographicLH(290.0f, 200.0f, 0.1f, 100.0f);
 	XMStoreFloat4x4(&shadowProjectionMatrix, XMMatrixTranspose(shProj));
 
+	// Casters are culled against the light's volume, not the camera's,
+	// so things out of view still throw their shadows into it. Depth
+	// is clamped in this pass, so nothing on the light's side of the
+	// volume is lost either.
+	Frustum lightFrustum(shView * shProj);
+	lightFrustum.RemoveNearPlane();
+	shadowCasters.clear();
+	culler.Cull(lightFrustum, drawEntities.data(), (int)drawEntities.size(), shadowCasters);
+
 	ID3D11RenderTargetView * nullRTV = NULL;
 	context->OMSetRenderTargets(1, &nullRTV, NULL);
 	ID3D11ShaderResourceView *const nullSRV[3] = { NULL };
@@ -559,21 +626,20 @@ void Game::RenderShadowMap()
 
 	// Set up the shadow-creation Vertex Shader
 	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", shadowViewMatrix);
-	shadowVS->SetMatrix4x4("projection", shadowProjectionMatrix);
+	shadowVS->SetMatrix4x4(shaderHandles.shadowView, shadowViewMatrix);
+	shadowVS->SetMatrix4x4(shaderHandles.shadowProjection, shadowProjectionMatrix);
 
 	// Turn OFF the pixel shader
 	context->PSSetShader(0, 0, 0);
-	for (unsigned int i = 0; i < entities.size(); i++)
+	for (auto entity : shadowCasters)
 	{
-		RenderEntityShadow(entities[i]);
+		RenderEntityShadow(entity);
 	}
-	RenderEntityShadow(currentProjectile);
-	auto shadowInstanced = resources->vertexShaders["shadowInstanced"];
+	auto shadowInstanced = resources->vertexShaders.Get(frameHandles.shadowInstancedVS);
 	shadowInstanced->SetShader();
-	shadowInstanced->SetMatrix4x4("view", shadowViewMatrix);
-	shadowInstanced->SetMatrix4x4("projection", shadowProjectionMatrix);
-	trees->RenderShadow(shadowInstanced);
+	shadowInstanced->SetMatrix4x4(shaderHandles.shadowInstancedView, shadowViewMatrix);
+	shadowInstanced->SetMatrix4x4(shaderHandles.shadowInstancedProjection, shadowProjectionMatrix);
+	trees->RenderShadow(shadowInstanced, lightFrustum, camera->GetPosition());
 
 	//shadowDSV = nullptr;
 	context->OMSetRenderTargets(1, &nullRTV, NULL);
@@ -603,14 +669,16 @@ void Game::InitializeEntities()
 	ShowCursor(false);
 	trees = std::unique_ptr<TreeManager>(new TreeManager(device, context));
 	fishes = std::unique_ptr<FishController>(new FishController(
-		resources->meshes["ruddFish"], resources->materials["ruddFish"],
+		resources->meshes.Find("ruddFish"), resources->materials.Find("ruddFish"),
 		5,
 		XMFLOAT3(9.f, -8.5f, -20.f),
 		XMFLOAT3(9.f, -8.5f, 35.f),
 		8,
 		XMFLOAT3(0, 90.f * XM_PI / 180, 0),
-		XMFLOAT3(0.03f, 0.03f, 0.03f)
+		XMFLOAT3(0.03f, 0.03f, 0.03f),
+		(uint64_t)std::time(nullptr)	// Different fish every run
 	));
+	fishes->InitializeInstancing(device, context, resources->vertexShaders.Find("animationInstanced"), resources->fishFBX.get());
 	trees->InitializeTrees({ "palm","palm_2" }, { "palm","palm_2" },
 	{
 		XMFLOAT3(-30, -5, 18),
@@ -618,10 +686,11 @@ void Game::InitializeEntities()
 		XMFLOAT3(45, -7, 70),
 		XMFLOAT3(55, -7, 70)
 	});
+	trees->SetDrawDistance(500.0f);
 	terrain = std::unique_ptr<Terrain>(new Terrain());
 	terrain->Initialize("../../Assets/Terrain/heightmap.bmp", device, context);
-	terrain->SetSplatMap(resources->shaderResourceViews["splatmap"]);
-	terrain->SetMaterial(resources->materials["grassTerrain"]);
+	terrain->SetSplatMap(resources->shaderResourceViews.Find("splatmap"));
+	terrain->SetMaterial(resources->materials.Find("grassTerrain"));
 	auto rm = resources;
 	terrain->SetTextures(rm->GetSRV("gravel"), rm->GetSRV("grass"), rm->GetSRV("sand"), rm->GetSRV("gravel"));
 
@@ -642,16 +711,16 @@ void Game::InitializeEntities()
 	lightsMap.insert(std::pair<std::string, Light*>("secondaryLight", new Light{ &secondaryLight, Directional }));
 	lightsMap.insert(std::pair<std::string, Light*>("pointLight", new Light{ &pointLight, Point }));
 
-	currentProjectile = new ProjectileEntity(resources->meshes["spear"], resources->materials["spear"]);
+	currentProjectile = new ProjectileEntity(resources->meshes.Find("spear"), resources->materials.Find("spear"));
 	currentProjectile->SetRotation(180 * XM_PI / 180, 0, 90 * XM_PI / 180);
 	currentProjectile->SetPosition(0.4f, 3.f, -14.9f);
 	currentProjectile->SetScale(1.5f, 1.5f, 1.5f);
 
-	//entities.push_back(new Entity(resources->meshes["sphere"], resources->materials["metal"]));
-	entities.push_back(new Entity(resources->meshes["boat"], resources->materials["boat"]));
-	entities.push_back(new Entity(resources->meshes["Rudd-Fish_Cube.001"], resources->materials["fish"]));
+	//entities.push_back(new Entity(resources->meshes.Find("sphere"), resources->materials.Find("metal")));
+	entities.push_back(new Entity(resources->meshes.Find("boat"), resources->materials.Find("boat")));
+	entities.push_back(new Entity(resources->meshes.Find("Rudd-Fish_Cube.001"), resources->materials.Find("fish")));
 
-	//entities.push_back(new Entity(resources->meshes["Coconut_Tree"], resources->materials["boat"]));
+	//entities.push_back(new Entity(resources->meshes.Find("Coconut_Tree"), resources->materials.Find("boat")));
 
 	CreateWater();
 	//entities[0]->SetPosition(1.f, 1.f, 1.f);
@@ -664,9 +733,18 @@ void Game::InitializeEntities()
 	entities[1]->SetRotation(0, 90.f * XM_PI / 180, 0);
 
 	//entities[2]->hasShadow = false;
-	skyTextures.push_back(resources->shaderResourceViews["mountain"]);
-	skyTextures.push_back(resources->shaderResourceViews["cubemap"]);
-	skyTextures.push_back(resources->shaderResourceViews["spacesky2"]);
+	drawEntities = entities;
+	drawEntities.push_back(currentProjectile);
+
+	transformEntities = entities;
+	transformEntities.insert(transformEntities.end(), fishes->GetEntities().begin(), fishes->GetEntities().end());
+	transformEntities.push_back(currentProjectile);
+	transformEntities.push_back(water);
+	transformEntities.push_back(terrain.get());
+
+	skyTextures.push_back(resources->shaderResourceViews.Find("mountain"));
+	skyTextures.push_back(resources->shaderResourceViews.Find("cubemap"));
+	skyTextures.push_back(resources->shaderResourceViews.Find("spacesky2"));
 }
 
 void Game::InitializeRenderer()
@@ -675,6 +753,14 @@ void Game::InitializeRenderer()
 	renderer->SetCamera(camera);
 	renderer->SetLights(lightsMap);
 	renderer->SetResources(resources);
+
+	// Lit shaders all read the renderer's light buffer instead of
+	// keeping a copy of the lights each
+	for (auto pixelShader : resources->pixelShaders)
+	{
+		if (pixelShader)
+			pixelShader->SetExternalConstantBuffer("lightData", renderer->GetLightBuffer());
+	}
 }
 
 void Game::DrawRefraction()
@@ -686,24 +772,24 @@ void Game::DrawRefraction()
 	context->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
 	context->IASetIndexBuffer(ib, DXGI_FORMAT_R32_UINT, 0);
 
-	auto refractVS = resources->vertexShaders["refraction"];
-	auto refractPS = resources->pixelShaders["refraction"];
+	auto refractVS = resources->vertexShaders.Get(frameHandles.refractionVS);
+	auto refractPS = resources->pixelShaders.Get(frameHandles.refractionPS);
 	// Setup vertex shader
-	refractVS->SetMatrix4x4("world", water->GetWorldMatrix());
-	refractVS->SetMatrix4x4("view", camera->GetViewMatrix());
-	refractVS->SetMatrix4x4("projection", camera->GetProjectionMatrix());
-	refractVS->SetFloat("time", time);
-	refractVS->SetData("waves", water->GetWaves(), sizeof(Wave) * NUM_OF_WAVES);
+	refractVS->SetMatrix4x4(shaderHandles.refractionWorld, water->GetWorldMatrix());
+	refractVS->SetMatrix4x4(shaderHandles.refractionView, camera->GetViewMatrix());
+	refractVS->SetMatrix4x4(shaderHandles.refractionProjection, camera->GetProjectionMatrix());
+	refractVS->SetFloat(shaderHandles.refractionTime, time);
+	refractVS->SetData(shaderHandles.refractionWaves, water->GetWaves(), sizeof(Wave) * NUM_OF_WAVES);
 	refractVS->CopyAllBufferData();
 	refractVS->SetShader();
 
 	// Setup pixel shader
-	refractPS->SetShaderResourceView("ScenePixels", refractionSRV);	// Pixels of the screen
-	refractPS->SetShaderResourceView("NormalMap", water->GetMaterial()->GetNormalSRV());	// Normal map for the object itself
-	refractPS->SetSamplerState("BasicSampler", sampler);			// Sampler for the normal map
-	refractPS->SetSamplerState("RefractSampler", refractSampler);	// Uses CLAMP on the edges
-	refractPS->SetFloat3("CameraPosition", camera->GetPosition());
-	refractPS->SetMatrix4x4("view", camera->GetViewMatrix());				// View matrix, so we can put normals into view space
+	refractPS->SetShaderResourceView(shaderHandles.refractionScenePixels, refractionSRV);	// Pixels of the screen
+	refractPS->SetShaderResourceView(shaderHandles.refractionNormalMap, water->GetMaterial()->GetNormalSRV());	// Normal map for the object itself
+	refractPS->SetSamplerState(shaderHandles.refractionBasicSampler, sampler);			// Sampler for the normal map
+	refractPS->SetSamplerState(shaderHandles.refractionRefractSampler, refractSampler);	// Uses CLAMP on the edges
+	refractPS->SetFloat3(shaderHandles.refractionCameraPosition, camera->GetPosition());
+	refractPS->SetMatrix4x4(shaderHandles.refractionNormalView, camera->GetViewMatrix());	// View matrix, so we can put normals into view space
 	refractPS->CopyAllBufferData();
 	refractPS->SetShader();
 
@@ -718,13 +804,13 @@ void Game::DrawFullscreenQuad(ID3D11ShaderResourceView * texture)
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	auto quadVS = resources->vertexShaders["quad"];
-	auto quadPS = resources->pixelShaders["quad"];
+	auto quadVS = resources->vertexShaders.Get(frameHandles.quadVS);
+	auto quadPS = resources->pixelShaders.Get(frameHandles.quadPS);
 	// Set up the fullscreen quad shaders
 	quadVS->SetShader();
 
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetSamplerState("Sampler", sampler);
+	quadPS->SetShaderResourceView(shaderHandles.quad.pixels, texture);
+	quadPS->SetSamplerState(shaderHandles.quad.sampler, sampler);
 	quadPS->SetShader();
 
 	// Draw
@@ -738,13 +824,13 @@ void Game::DrawPostProcess(ID3D11ShaderResourceView* texture)
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	auto quadVS = resources->vertexShaders["quad"];
-	auto quadPS = resources->pixelShaders["post"];
+	auto quadVS = resources->vertexShaders.Get(frameHandles.quadVS);
+	auto quadPS = resources->pixelShaders.Get(frameHandles.postPS);
 	// Set up the fullscreen quad shaders
 	quadVS->SetShader();
 
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetSamplerState("Sampler", sampler);
+	quadPS->SetShaderResourceView(shaderHandles.post.pixels, texture);
+	quadPS->SetSamplerState(shaderHandles.post.sampler, sampler);
 	quadPS->SetShader();
 
 	// Draw
@@ -753,19 +839,19 @@ void Game::DrawPostProcess(ID3D11ShaderResourceView* texture)
 
 void Game::Blur(ID3D11ShaderResourceView* texture)
 {
-	auto quadVS = resources->vertexShaders["quad"];
-	auto quadPS = resources->pixelShaders["blur"];
+	auto quadVS = resources->vertexShaders.Get(frameHandles.quadVS);
+	auto quadPS = resources->pixelShaders.Get(frameHandles.blurPS);
 	context->OMSetRenderTargets(1, &bloomBlurRTV, 0);
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	quadPS = resources->pixelShaders["blur"];
+	quadPS = resources->pixelShaders.Get(frameHandles.blurPS);
 	// Set up the fullscreen quad shaders
 	quadVS->SetShader();
 
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetSamplerState("Sampler", sampler);
-	quadPS->SetFloat("blurValue", 5.0f);
+	quadPS->SetShaderResourceView(shaderHandles.blur.pixels, texture);
+	quadPS->SetSamplerState(shaderHandles.blur.sampler, sampler);
+	quadPS->SetFloat(shaderHandles.blur.blurValue, 5.0f);
 	quadPS->SetShader();
 	quadPS->CopyAllBufferData();
 
@@ -782,13 +868,13 @@ void Game::BloomPostProcess(ID3D11ShaderResourceView* texture)
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	auto quadVS = resources->vertexShaders["quad"];
-	auto quadPS = resources->pixelShaders["bloomExtract"];
+	auto quadVS = resources->vertexShaders.Get(frameHandles.quadVS);
+	auto quadPS = resources->pixelShaders.Get(frameHandles.bloomExtractPS);
 	// Set up the fullscreen quad shaders
 	quadVS->SetShader();
 
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetSamplerState("Sampler", sampler);
+	quadPS->SetShaderResourceView(shaderHandles.bloomExtract.pixels, texture);
+	quadPS->SetSamplerState(shaderHandles.bloomExtract.sampler, sampler);
 	quadPS->SetShader();
 
 	// Draw
@@ -799,13 +885,13 @@ void Game::BloomPostProcess(ID3D11ShaderResourceView* texture)
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	quadPS = resources->pixelShaders["blur"];
+	quadPS = resources->pixelShaders.Get(frameHandles.blurPS);
 	// Set up the fullscreen quad shaders
 	quadVS->SetShader();
 
-	quadPS->SetShaderResourceView("Pixels", bloomExtractSRV);
-	quadPS->SetSamplerState("Sampler", sampler);
-	quadPS->SetFloat("blurValue", 3.0f);
+	quadPS->SetShaderResourceView(shaderHandles.blur.pixels, bloomExtractSRV);
+	quadPS->SetSamplerState(shaderHandles.blur.sampler, sampler);
+	quadPS->SetFloat(shaderHandles.blur.blurValue, 3.0f);
 	quadPS->SetShader();
 	quadPS->CopyAllBufferData();
 
@@ -817,13 +903,13 @@ void Game::BloomPostProcess(ID3D11ShaderResourceView* texture)
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	quadPS = resources->pixelShaders["bloom"];
+	quadPS = resources->pixelShaders.Get(frameHandles.bloomPS);
 	// Set up the fullscreen quad shaders
 	quadVS->SetShader();
 
-	quadPS->SetShaderResourceView("BaseTexture", texture);
-	quadPS->SetShaderResourceView("BloomTexture", bloomBlurSRV);
-	quadPS->SetSamplerState("Sampler", sampler);
+	quadPS->SetShaderResourceView(shaderHandles.bloom.baseTexture, texture);
+	quadPS->SetShaderResourceView(shaderHandles.bloom.bloomTexture, bloomBlurSRV);
+	quadPS->SetSamplerState(shaderHandles.bloom.sampler, sampler);
 	quadPS->SetShader();
 
 	// Draw
@@ -846,13 +932,13 @@ void Game::DepthOfFieldPostProcess(ID3D11ShaderResourceView * texture)
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	auto quadVS = resources->vertexShaders["quad"];
-	auto quadPS = resources->pixelShaders["blur"];
+	auto quadVS = resources->vertexShaders.Get(frameHandles.quadVS);
+	auto quadPS = resources->pixelShaders.Get(frameHandles.blurPS);
 	// Set up the fullscreen quad shaders
 	quadVS->SetShader();
-	quadPS->SetFloat("blurValue", 4);
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetSamplerState("Sampler", sampler);
+	quadPS->SetFloat(shaderHandles.blur.blurValue, 4);
+	quadPS->SetShaderResourceView(shaderHandles.blur.pixels, texture);
+	quadPS->SetSamplerState(shaderHandles.blur.sampler, sampler);
 	quadPS->SetShader();
 	quadPS->CopyAllBufferData();
 	// Draw
@@ -863,20 +949,20 @@ void Game::DepthOfFieldPostProcess(ID3D11ShaderResourceView * texture)
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	quadVS = resources->vertexShaders["quad"];
-	quadPS = resources->pixelShaders["dof"];
+	quadVS = resources->vertexShaders.Get(frameHandles.quadVS);
+	quadPS = resources->pixelShaders.Get(frameHandles.dofPS);
 	// Set up the fullscreen quad shaders
 	quadVS->SetShader();
 
-	quadPS->SetFloat("Distance", distance);
-	quadPS->SetFloat("Range", range);
-	quadPS->SetFloat("Near", nearDof);
-	quadPS->SetFloat("Far", farDof);
+	quadPS->SetFloat(shaderHandles.dof.distance, distance);
+	quadPS->SetFloat(shaderHandles.dof.range, range);
+	quadPS->SetFloat(shaderHandles.dof.nearPlane, nearDof);
+	quadPS->SetFloat(shaderHandles.dof.farPlane, farDof);
 
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetShaderResourceView("BlurredPixels", dofBlurSRV);
-	quadPS->SetShaderResourceView("Depth", depthSRV);
-	quadPS->SetSamplerState("Sampler", sampler);
+	quadPS->SetShaderResourceView(shaderHandles.dof.pixels, texture);
+	quadPS->SetShaderResourceView(shaderHandles.dof.blurredPixels, dofBlurSRV);
+	quadPS->SetShaderResourceView(shaderHandles.dof.depth, depthSRV);
+	quadPS->SetSamplerState(shaderHandles.dof.sampler, sampler);
 	quadPS->SetShader();
 	quadPS->CopyAllBufferData();
 	// Draw
@@ -892,41 +978,41 @@ void Game::LensFlare(ID3D11ShaderResourceView * texture)
 	context->IASetVertexBuffers(0, 0, 0, 0, 0);
 	context->IASetIndexBuffer(0, DXGI_FORMAT_R32_UINT, 0);
 
-	auto quadVS = resources->vertexShaders["quad"];
-	auto quadPS = resources->pixelShaders["lensFlareThreshold"];
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetSamplerState("Sampler", sampler);
+	auto quadVS = resources->vertexShaders.Get(frameHandles.quadVS);
+	auto quadPS = resources->pixelShaders.Get(frameHandles.lensFlareThresholdPS);
+	quadPS->SetShaderResourceView(shaderHandles.lensFlareThreshold.pixels, texture);
+	quadPS->SetSamplerState(shaderHandles.lensFlareThreshold.sampler, sampler);
 	quadVS->SetShader();
 	quadPS->SetShader();
 
 	context->Draw(3, 0);
 	context->OMSetRenderTargets(1, &ghostGenerateRTV, 0);
 
-	quadPS = resources->pixelShaders["ghostGen"];
+	quadPS = resources->pixelShaders.Get(frameHandles.ghostGenPS);
 
-	quadPS->SetShaderResourceView("Pixels", lensFlareThresholdSRV);
-	quadPS->SetShaderResourceView("Radial", resources->GetSRV("radial"));
-	quadPS->SetSamplerState("Sampler", sampler);
+	quadPS->SetShaderResourceView(shaderHandles.ghostGen.pixels, lensFlareThresholdSRV);
+	quadPS->SetShaderResourceView(shaderHandles.ghostGen.radial, resources->shaderResourceViews.Get(frameHandles.radial));
+	quadPS->SetSamplerState(shaderHandles.ghostGen.sampler, sampler);
 	quadVS->SetShader();
 	quadPS->SetShader();
 	context->Draw(3, 0);
 
 	context->OMSetRenderTargets(1, &bloomBlurRTV, 0);
-	quadPS = resources->pixelShaders["blur"];
-	quadPS->SetFloat("blurValue", 4);
-	quadPS->SetSamplerState("Sampler", sampler);
-	quadPS->SetShaderResourceView("Pixels", ghostGenerateSRV);
+	quadPS = resources->pixelShaders.Get(frameHandles.blurPS);
+	quadPS->SetFloat(shaderHandles.blur.blurValue, 4);
+	quadPS->SetSamplerState(shaderHandles.blur.sampler, sampler);
+	quadPS->SetShaderResourceView(shaderHandles.blur.pixels, ghostGenerateSRV);
 	quadPS->CopyAllBufferData();
 	quadVS->SetShader();
 	quadPS->SetShader();
 	context->Draw(3, 0);
 
 	context->OMSetRenderTargets(1, &lensFlareRTV, 0);
-	quadPS = resources->pixelShaders["lensFlare"];
+	quadPS = resources->pixelShaders.Get(frameHandles.lensFlarePS);
 
-	quadPS->SetShaderResourceView("Pixels", texture);
-	quadPS->SetShaderResourceView("LensFlare", bloomBlurSRV);
-	quadPS->SetSamplerState("Sampler", sampler);
+	quadPS->SetShaderResourceView(shaderHandles.lensFlare.pixels, texture);
+	quadPS->SetShaderResourceView(shaderHandles.lensFlare.lensFlare, bloomBlurSRV);
+	quadPS->SetSamplerState(shaderHandles.lensFlare.sampler, sampler);
 	quadVS->SetShader();
 	quadPS->SetShader();
 	context->Draw(3, 0);
@@ -938,30 +1024,26 @@ void Game::LensFlare(ID3D11ShaderResourceView * texture)
 
 
 
-void Game::CreateRipple(float x, float y, float z, float duration, float ringSize) {
-	Ripple r = Ripple(x, y, z, duration);// , ringSize);
-	ripples.push_back(r);
-}
-
 //----------------------------------------------------
 // Set the shaders and draw water
 //----------------------------------------------------
 void Game::DrawWater()
 {
 	// Set water shaders
-	resources->vertexShaders["water"]->SetFloat("time", time);
-	resources->pixelShaders["water"]->SetFloat("translate", translate);
-	resources->pixelShaders["water"]->SetShaderResourceView("SkyTexture", resources->shaderResourceViews["cubemap"]);
-	resources->pixelShaders["water"]->SetShaderResourceView("normalTextureTwo", resources->shaderResourceViews["waterNormal2"]);
-	resources->pixelShaders["water"]->SetFloat("transparency", transparency);
+	SimplePixelShader* waterPS = waterHandles.pixelShader;
+	waterHandles.vertexShader->SetFloat(waterHandles.time, time);
+	waterPS->SetFloat(waterHandles.translate, translate);
+	waterPS->SetShaderResourceView(waterHandles.skyTexture, resources->shaderResourceViews.Get(frameHandles.cubemap));
+	waterPS->SetShaderResourceView(waterHandles.normalTextureTwo, resources->shaderResourceViews.Get(frameHandles.waterNormal2));
+	waterPS->SetFloat(waterHandles.transparency, transparency);
 
 	// Setup pixel shader
-	resources->pixelShaders["water"]->SetShaderResourceView("ScenePixels", refractionSRV);	// Pixels of the screen
-	resources->pixelShaders["water"]->SetSamplerState("RefractSampler", refractSampler);	// Uses CLAMP on the edges
-	resources->pixelShaders["water"]->SetFloat3("CameraPosition", camera->GetPosition());
-	resources->pixelShaders["water"]->SetMatrix4x4("view", camera->GetViewMatrix());		// View matrix, so we can put normals into view space
-	resources->pixelShaders["water"]->SetShaderResourceView("waterSplash", resources->shaderResourceViews["particle"]);
-	resources->pixelShaders["water"]->CopyAllBufferData();
+	waterPS->SetShaderResourceView(waterHandles.scenePixels, refractionSRV);	// Pixels of the screen
+	waterPS->SetSamplerState(waterHandles.refractSampler, refractSampler);	// Uses CLAMP on the edges
+	waterPS->SetFloat3(waterHandles.cameraPosition, camera->GetPosition());
+	waterPS->SetMatrix4x4(waterHandles.view, camera->GetViewMatrix());		// View matrix, so we can put normals into view space
+	waterPS->SetShaderResourceView(waterHandles.waterSplash, resources->shaderResourceViews.Get(frameHandles.particle));
+	waterPS->CopyAllBufferData();
 	renderer->Draw(water);
 }
 
@@ -973,31 +1055,13 @@ void Game::OnResize()
 {
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
+	if (!sceneReady)
+		return;
 	renderer->SetDepthStencilView(depthStencilView);
 	renderer->SetBackBuffer(backBufferRTV);
 	camera->SetProjectionMatrix((float)width / height);
 }
 
-// --------------------------------------------------------
-// Calculate the tip position relative to the spear
-//	Get the forward vector
-//	Multiply it by the z extent of the spear's bounding box
-//	Rotate the resulting vector by a quaternion that represents the spears orientation
-// --------------------------------------------------------
-XMFLOAT3 GetTipPosition(ProjectileEntity &projectile) {
-	float tipDistance = projectile.GetBoundingBox().Extents.z;
-	Vector3 forward = Vector3::Forward * tipDistance;
-	XMFLOAT4 orientation = projectile.GetBoundingBox().Orientation;
-	XMVECTOR position = XMLoadFloat3(&forward);
-	XMVECTOR rot = XMLoadFloat4(&orientation);
-	XMVECTOR offset = XMVector3Rotate(position, rot);
-	XMFLOAT3 newOffset;
-	XMStoreFloat3(&newOffset, offset);
-
-	return newOffset;
-}
-
-XMFLOAT3 hitPos;
 // --------------------------------------------------------
 // Update your game here - user input, move objects, AI, etc.
 // --------------------------------------------------------
@@ -1024,28 +1088,13 @@ void Game::Update(float deltaTime, float totalTime)
 	
 	canvas->Update(deltaTime);
 
-	//if (!gameStarted) return;
-	// Water .........................................
-	time += 0.05f * deltaTime;
-	translate += 0.01f * deltaTime;
-	if (translate > 1.0f)
+	// Only the menu runs until the scene has loaded
+	if (!sceneReady)
 	{
-		translate -= 1.0f;
-	}
-
-	//Update the virtual vertices
-	virtualVertices.ApplyGetstnerWaves(water->GetWaves(), numWaves, time);
-	//entities[0]->SetPosition(currentProjectile->GetPosition() + newOffset);
-	//entities[0]->SetScale(0.1f, 0.1f, 0.1f);
-	//cout << "x: " << virtualVertices[1249].x << " y: " << virtualVertices[1249].y << " z: " << virtualVertices[1249].z << endl;
-
-	fishes->Update(deltaTime, totalTime);
-	float fishSpeed = 2.f;
-	entities[1]->Move(XMFLOAT3((sin(totalTime * 3) / 600), 0, fishSpeed*deltaTime));
-
-	if (entities[1]->GetPosition().z >= 30.f)
-	{
-		entities[1]->SetPosition(9.f, -8.5f, -15.f);
+		resources->ProcessUploads();
+		if (!Resources::IsLoaded(sceneAssets))
+			return;
+		InitializeScene();
 	}
 
 	if ((GetAsyncKeyState(VK_LBUTTON) & 0x8000) != 0)
@@ -1053,89 +1102,27 @@ void Game::Update(float deltaTime, float totalTime)
 		projectilePreviousPosition = currentProjectile->GetPosition();
 		currentProjectile->Shoot(1.f, camera->GetDirection());
 	}
-	for (auto e : emitters)
-	{
-		e->Update(deltaTime);
-	}
 	isDofEnabled = false;
 	if ((GetAsyncKeyState(VK_RBUTTON) & 0x8000) != 0)
 	{
 		isDofEnabled = true;
 	}
 
-	//if ((GetAsyncKeyState(VK_SPACE) & 0x8000) != 0) {
-	//	CreateRipple(0.0f, 0.0f, 50.0f, RIPPLE_DURATION);// , 2.0f);
-	//}
-	XMFLOAT3 pos = XMFLOAT3(0, 0, 0);
-
-	Vector3 tipPosition = GetTipPosition(*currentProjectile);
-	bool hitWater = (virtualVertices.HitWater(currentProjectile->GetPosition() + tipPosition));
-
-	//Check for spear hitting the water
-	if (/*currentProjectile->GetPosition().y <= -7.0f*/ hitWater && !projectileHitWater && currentProjectile->HasBeenShot()) {
-		projectileHitWater = true;
-		pos = currentProjectile->GetPosition();
-		hitPos = currentProjectile->GetPosition() + tipPosition;
-		float x = hitPos.x;
-		float y = hitPos.y;
-		float z = hitPos.z;
-		CreateRipple(x, y, z, RIPPLE_DURATION);// , 0.5f);
-
-		AudioEngine::Instance()->PlaySounds("../../Assets/Sounds/splash.wav", AudioVector3{ x,y,z }, 30.0f); // play sound at camera position
-		emitters.emplace_back(std::make_shared<Emitter>(
-			50,							// Max particles
-			100,							// Particles per second
-			0.5f,								// Particle lifetime
-			0.7f,							// Start size
-			0.1f,							// End size
-			XMFLOAT4(0.9f, 0.9f, 1.0f, 0.5f),	// Start color
-			XMFLOAT4(1, 1.0f, 1.0f, 0),		// End color
-			XMFLOAT3(0, 7.2f, 0),				// Start velocity
-			XMFLOAT3(0, -50, 0),				// Start acceleration
-			device,
-			resources->vertexShaders["particle"],
-			resources->pixelShaders["particle"],
-			resources->shaderResourceViews["particle"],
-			XMFLOAT3(hitPos.x, hitPos.y, hitPos.z)
-			));
-	}
-
-	auto distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&currentProjectile->GetPosition()) - XMLoadFloat3(&camera->GetPosition())));
-
-	if (fabsf(distance) > 50 || fishes->CheckForCollision(currentProjectile))
-	{
-		projectileHitWater = false;
-		currentProjectile->SetHasBeenShot(false);
-		//currentProjectile->SetPosition(0.4f, 2.f, -14.9f);
-		auto pos = camera->GetPosition();
-		pos = XMFLOAT3(pos.x + 0.4f, pos.y, pos.z);
-		currentProjectile->SetPosition(pos);
-	}
-
-	//Update Camera
+	//Update Camera, the spear moves with it until it is thrown
 	camera->Update(deltaTime);
-	for (auto entity : entities)
+	if (!currentProjectile->HasBeenShot())
 	{
-		entity->Update(deltaTime, totalTime);
+		currentProjectile->Update(deltaTime, totalTime);
 	}
 
-	currentProjectile->Update(deltaTime, totalTime);
-
-	//Update entities
-	entities[0]->SetRotation(cos(totalTime) / 20, 180.f * XM_PI / 180, -sin(totalTime) / 20);
+	// Water, fish, the thrown spear, splashes and ripples run at a fixed rate
+	simulation.SetPlayerPosition(camera->GetPosition());
+	simulation.Update(deltaTime);
+	time = simulation.GetWaterTime();
+	translate = simulation.GetWaterTranslate();
 
-	//Update ripples and Water shader (add support for multiple ripples later)
-	//Delete ripples afterward if they are at max duration
-	for (auto it = ripples.begin(); it != ripples.end(); ) {
-		(*it).Update(deltaTime);
-		if ((*it).AtMaxDuration()) {
-			it = ripples.erase(it);
-			//delete (*it);
-		}
-		else {
-			it++;
-		}
-	}
+	// Everything has moved for this frame
+	Entity::UpdateTransforms(transformEntities.data(), (int)transformEntities.size(), jobs.get());
 
 	//Audio engine interactions
 	AudioEngine::Instance()->Set3dListenerAndOrientation(AudioVector3{ camera->GetPosition().x,camera->GetPosition().y,camera->GetPosition().z },		// Listener at camera position
@@ -1156,6 +1143,17 @@ void Game::Update(float deltaTime, float totalTime)
 void Game::Draw(float deltaTime, float totalTime)
 {
 	const float color[4] = { 0.11f, 0.11f, 0.11f, 0.0f };
+
+	// Just the menu over a plain background while the scene loads
+	if (!sceneReady)
+	{
+		context->ClearRenderTargetView(backBufferRTV, color);
+		context->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+		canvas->Draw();
+		swapChain->Present(0, 0);
+		return;
+	}
+
 	renderer->ClearScreen(color);
 
 	// Clear any and all render targets we intend to use, and the depth buffer
@@ -1163,7 +1161,9 @@ void Game::Draw(float deltaTime, float totalTime)
 	context->ClearRenderTargetView(refractionRTV, color);
 	context->ClearDepthStencilView(depthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0);
 
+	renderer->UpdateLightBuffer();
 	RenderShadowMap();
+	CullEntities();
 
 	// Use our refraction render target and our regular depth buffer
 	context->OMSetRenderTargets(1, &refractionRTV, depthStencilView);
@@ -1171,7 +1171,7 @@ void Game::Draw(float deltaTime, float totalTime)
 		trees->Render(camera);
 
 		renderer->Draw(terrain.get());
-		fishes->Render(renderer);
+		fishes->RenderInstanced(camera, totalTime);
 	
 
 	DrawSky();
@@ -1183,60 +1183,51 @@ void Game::Draw(float deltaTime, float totalTime)
 
 	context->OMSetRenderTargets(1, &postProcessRTV, depthStencilView);
 
-	for (auto entity : entities)
-	{
-		if (entity->hasShadow )
-			renderer->Draw(entity);
-	}
-	
-	ID3D11ShaderResourceView *const nullSRV[4] = { NULL };
-	context->PSSetShaderResources(0, 4, nullSRV);
-
-	for (auto entity : entities)
+	// Shadowed entities first, then the rest once the game has started
+	renderQueue.Begin(camera->GetPosition());
+	for (auto entity : visibleEntities)
 	{
-		if (!entity->hasShadow && gameStarted)
-			renderer->Draw(entity);
+		if (entity->hasShadow)
+			renderQueue.Add(entity, 0);
+		else if (gameStarted)
+			renderQueue.Add(entity, 1);
 	}
-		renderer->Draw(currentProjectile);
+	renderStats += renderer->Submit(renderQueue);
+	ReportRenderStats(totalTime);
 		DrawWater();
 
+	ID3D11ShaderResourceView *const nullSRV[4] = { NULL };
 	context->PSSetShaderResources(0, 4, nullSRV);
 	ID3D11ShaderResourceView* nullSRV2[16] = {};
 	context->PSSetShaderResources(0, 16, nullSRV2);
 
 	//Reset water if there are no ripples
-	resources->pixelShaders["water"]->SetFloat3("ripplePosition", XMFLOAT3(0.0f, 0.0f, 0.0f));
-	resources->pixelShaders["water"]->SetFloat("rippleRadius", 0.0f);
-	resources->pixelShaders["water"]->SetFloat("ringSize", 0.0f);
+	waterHandles.pixelShader->SetFloat3(waterHandles.ripplePosition, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	waterHandles.pixelShader->SetFloat(waterHandles.rippleRadius, 0.0f);
+	waterHandles.pixelShader->SetFloat(waterHandles.ringSize, 0.0f);
 
 	//Convert Ripples to RippleData structs, then
 	//Pass ripples to the water shader
 	std::vector<RippleData> rippleData;
-	for (auto ripple : ripples) {
+	for (auto ripple : simulation.GetRipples()) {
 		rippleData.push_back(ripple.GetRippleData());
 	}
 	if (rippleData.size() > 0) {
-		resources->pixelShaders["water"]->SetData("ripples", rippleData.data(), sizeof(RippleData) * MAX_RIPPLES);
+		rippleData.resize(MAX_RIPPLES);	// The shader array is always full length
+		waterHandles.pixelShader->SetData(waterHandles.ripples, rippleData.data(), sizeof(RippleData) * MAX_RIPPLES);
 	}
-	resources->pixelShaders["water"]->SetInt("rippleCount", (int)ripples.size());
+	waterHandles.pixelShader->SetInt(waterHandles.rippleCount, (int)simulation.GetRipples().size());
 	//emitter->SetPosition(XMFLOAT3(ripple.ripplePosition.x,-6, ripple.ripplePosition.z));
 
-	for (auto e : emitters)
+	if (gameStarted)
 	{
-		if (!e->doneEmit)
-		{
-			//// Particle states
-			float blend[4] = { 1,1,1,1 };
-			context->OMSetBlendState(particleBlendState, blend, 0xffffffff);  // Additive blending
-			context->OMSetDepthStencilState(particleDepthState, 0);			// No depth WRITING
-			if (gameStarted) e->Draw(context, camera);
-			context->OMSetBlendState(0, 0, 0xFFFFFFFF);
-			context->OMSetDepthStencilState(0, 0);
-		}
-		else
-		{
-			emitters.pop_back();
-		}
+		//// Particle states
+		float blend[4] = { 1,1,1,1 };
+		context->OMSetBlendState(particleBlendState, blend, 0xffffffff);  // Additive blending
+		context->OMSetDepthStencilState(particleDepthState, 0);			// No depth WRITING
+		particles->Draw(context, camera);
+		context->OMSetBlendState(0, 0, 0xFFFFFFFF);
+		context->OMSetDepthStencilState(0, 0);
 	}
 
 	context->OMSetBlendState(0, 0, 0xFFFFFFFF);
@@ -1266,6 +1257,42 @@ void Game::Draw(float deltaTime, float totalTime)
 	renderer->Present();
 }
 
+// --------------------------------------------------------
+// Build this frame's visible list from the camera frustum
+// --------------------------------------------------------
+void Game::CullEntities()
+{
+	Frustum frustum = camera->GetFrustum();
+
+	// Fish cull themselves when they are drawn
+	visibleEntities.clear();
+	culler.Cull(frustum, drawEntities.data(), (int)drawEntities.size(), visibleEntities);
+}
+
+// -----------------------------------------------------
+// Prints what the render queue saved, averaged over
+// about a second of frames (debug builds only)
+// -----------------------------------------------------
+void Game::ReportRenderStats(float totalTime)
+{
+	renderStatsFrames++;
+	if (totalTime - renderStatsTime < 1.0f)
+		return;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	float frames = (float)renderStatsFrames;
+	printf("\nRender queue: %.1f draws, skipped %.1f shader, %.1f material and %.1f mesh changes per frame",
+		renderStats.draws / frames,
+		renderStats.shaderChangesSkipped / frames,
+		renderStats.materialChangesSkipped / frames,
+		renderStats.meshChangesSkipped / frames);
+#endif
+
+	renderStats = {};
+	renderStatsFrames = 0;
+	renderStatsTime = totalTime;
+}
+
 void Game::Tesellation()
 {
 #pragma region Tesselation
@@ -1273,11 +1300,104 @@ void Game::Tesellation()
 #pragma endregion
 }
 
+// --------------------------------------------------------
+// Every quad variable on one post process shader
+// --------------------------------------------------------
+static QuadShaderHandles ResolveQuadHandles(SimplePixelShader* quadPS)
+{
+	QuadShaderHandles handles;
+	handles.pixels = quadPS->GetShaderResourceViewHandle("Pixels");
+	handles.sampler = quadPS->GetSamplerHandle("Sampler");
+	handles.blurValue = quadPS->GetVariableHandle("blurValue");
+	handles.baseTexture = quadPS->GetShaderResourceViewHandle("BaseTexture");
+	handles.bloomTexture = quadPS->GetShaderResourceViewHandle("BloomTexture");
+	handles.blurredPixels = quadPS->GetShaderResourceViewHandle("BlurredPixels");
+	handles.depth = quadPS->GetShaderResourceViewHandle("Depth");
+	handles.distance = quadPS->GetVariableHandle("Distance");
+	handles.range = quadPS->GetVariableHandle("Range");
+	handles.nearPlane = quadPS->GetVariableHandle("Near");
+	handles.farPlane = quadPS->GetVariableHandle("Far");
+	handles.radial = quadPS->GetShaderResourceViewHandle("Radial");
+	handles.lensFlare = quadPS->GetShaderResourceViewHandle("LensFlare");
+	return handles;
+}
+
+// --------------------------------------------------------
+// The only name lookups for anything drawn every frame
+// --------------------------------------------------------
+void Game::ResolveFrameHandles()
+{
+	frameHandles.quadVS = resources->vertexShaders.GetHandle("quad");
+	frameHandles.skyVS = resources->vertexShaders.GetHandle("sky");
+	frameHandles.refractionVS = resources->vertexShaders.GetHandle("refraction");
+	frameHandles.shadowInstancedVS = resources->vertexShaders.GetHandle("shadowInstanced");
+
+	frameHandles.quadPS = resources->pixelShaders.GetHandle("quad");
+	frameHandles.postPS = resources->pixelShaders.GetHandle("post");
+	frameHandles.blurPS = resources->pixelShaders.GetHandle("blur");
+	frameHandles.bloomExtractPS = resources->pixelShaders.GetHandle("bloomExtract");
+	frameHandles.bloomPS = resources->pixelShaders.GetHandle("bloom");
+	frameHandles.dofPS = resources->pixelShaders.GetHandle("dof");
+	frameHandles.lensFlareThresholdPS = resources->pixelShaders.GetHandle("lensFlareThreshold");
+	frameHandles.ghostGenPS = resources->pixelShaders.GetHandle("ghostGen");
+	frameHandles.lensFlarePS = resources->pixelShaders.GetHandle("lensFlare");
+	frameHandles.skyPS = resources->pixelShaders.GetHandle("sky");
+	frameHandles.refractionPS = resources->pixelShaders.GetHandle("refraction");
+
+	frameHandles.cube = resources->meshes.GetHandle("cube");
+
+	frameHandles.cubemap = resources->shaderResourceViews.GetHandle("cubemap");
+	frameHandles.waterNormal2 = resources->shaderResourceViews.GetHandle("waterNormal2");
+	frameHandles.particle = resources->shaderResourceViews.GetHandle("particle");
+	frameHandles.radial = resources->shaderResourceViews.GetHandle("radial");
+
+	auto shadowInstancedVS = resources->vertexShaders.Get(frameHandles.shadowInstancedVS);
+	shaderHandles.shadowWorld = shadowVS->GetVariableHandle("world");
+	shaderHandles.shadowView = shadowVS->GetVariableHandle("view");
+	shaderHandles.shadowProjection = shadowVS->GetVariableHandle("projection");
+	shaderHandles.shadowInstancedView = shadowInstancedVS->GetVariableHandle("view");
+	shaderHandles.shadowInstancedProjection = shadowInstancedVS->GetVariableHandle("projection");
+
+	auto skyVS = resources->vertexShaders.Get(frameHandles.skyVS);
+	auto skyPS = resources->pixelShaders.Get(frameHandles.skyPS);
+	shaderHandles.skyView = skyVS->GetVariableHandle("view");
+	shaderHandles.skyProjection = skyVS->GetVariableHandle("projection");
+	shaderHandles.skyTexture = skyPS->GetShaderResourceViewHandle("SkyTexture");
+	shaderHandles.skySampler = skyPS->GetSamplerHandle("BasicSampler");
+
+	auto refractVS = resources->vertexShaders.Get(frameHandles.refractionVS);
+	auto refractPS = resources->pixelShaders.Get(frameHandles.refractionPS);
+	shaderHandles.refractionWorld = refractVS->GetVariableHandle("world");
+	shaderHandles.refractionView = refractVS->GetVariableHandle("view");
+	shaderHandles.refractionProjection = refractVS->GetVariableHandle("projection");
+	shaderHandles.refractionTime = refractVS->GetVariableHandle("time");
+	shaderHandles.refractionWaves = refractVS->GetVariableHandle("waves");
+	shaderHandles.refractionScenePixels = refractPS->GetShaderResourceViewHandle("ScenePixels");
+	shaderHandles.refractionNormalMap = refractPS->GetShaderResourceViewHandle("NormalMap");
+	shaderHandles.refractionBasicSampler = refractPS->GetSamplerHandle("BasicSampler");
+	shaderHandles.refractionRefractSampler = refractPS->GetSamplerHandle("RefractSampler");
+	shaderHandles.refractionCameraPosition = refractPS->GetVariableHandle("CameraPosition");
+	shaderHandles.refractionNormalView = refractPS->GetVariableHandle("view");
+
+	shaderHandles.quad = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.quadPS));
+	shaderHandles.post = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.postPS));
+	shaderHandles.blur = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.blurPS));
+	shaderHandles.bloomExtract = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.bloomExtractPS));
+	shaderHandles.bloom = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.bloomPS));
+	shaderHandles.dof = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.dofPS));
+	shaderHandles.lensFlareThreshold = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.lensFlareThresholdPS));
+	shaderHandles.ghostGen = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.ghostGenPS));
+	shaderHandles.lensFlare = ResolveQuadHandles(resources->pixelShaders.Get(frameHandles.lensFlarePS));
+}
+
 void Game::DrawSky()
 {
 	// After I draw any and all opaque entities, I want to draw the sky
-	ID3D11Buffer* skyVB = resources->meshes["cube"]->GetVertexBuffer();
-	ID3D11Buffer* skyIB = resources->meshes["cube"]->GetIndexBuffer();
+	Mesh* skyMesh = resources->meshes.Get(frameHandles.cube);
+	SimpleVertexShader* skyVS = resources->vertexShaders.Get(frameHandles.skyVS);
+	SimplePixelShader* skyPS = resources->pixelShaders.Get(frameHandles.skyPS);
+	ID3D11Buffer* skyVB = skyMesh->GetVertexBuffer();
+	ID3D11Buffer* skyIB = skyMesh->GetIndexBuffer();
 
 	// Set the buffers
 	UINT stride = sizeof(Vertex);
@@ -1287,19 +1407,19 @@ void Game::DrawSky()
 	context->IASetIndexBuffer(skyIB, DXGI_FORMAT_R32_UINT, 0);
 
 	// Set up the sky shaders
-	resources->vertexShaders["sky"]->SetMatrix4x4("view", camera->GetViewMatrix());
-	resources->vertexShaders["sky"]->SetMatrix4x4("projection", camera->GetProjectionMatrix());
-	resources->vertexShaders["sky"]->CopyAllBufferData();
-	resources->vertexShaders["sky"]->SetShader();
+	skyVS->SetMatrix4x4(shaderHandles.skyView, camera->GetViewMatrix());
+	skyVS->SetMatrix4x4(shaderHandles.skyProjection, camera->GetProjectionMatrix());
+	skyVS->CopyAllBufferData();
+	skyVS->SetShader();
 
-	resources->pixelShaders["sky"]->SetShaderResourceView("SkyTexture", skyTextures[currentSky]);
-	resources->pixelShaders["sky"]->SetSamplerState("BasicSampler", sampler);
-	resources->pixelShaders["sky"]->SetShader();
+	skyPS->SetShaderResourceView(shaderHandles.skyTexture, skyTextures[currentSky]);
+	skyPS->SetSamplerState(shaderHandles.skySampler, sampler);
+	skyPS->SetShader();
 
 	// Set up the render states necessary for the sky
 	context->RSSetState(skyRastState);
 	context->OMSetDepthStencilState(skyDepthState, 0);
-	context->DrawIndexed(resources->meshes["cube"]->GetIndexCount(), 0, 0);
+	context->DrawIndexed(skyMesh->GetIndexCount(), 0, 0);
 
 	// When done rendering, reset any and all states for the next frame
 	context->RSSetState(0);
@@ -1356,7 +1476,7 @@ void Game::OnMouseMove(WPARAM buttonState, int x, int y)
 	float speed = 0.6f;
 	float deltaX = (float)x - prevMousePos.x;
 	float deltaY = (float)y - prevMousePos.y;
-	if (gameStarted)
+	if (gameStarted && sceneReady)
 	{
 		camera->RotateX(speed * deltaY * XM_PI / 180);
 		camera->RotateY(speed * deltaX * XM_PI / 180);
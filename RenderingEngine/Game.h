@@ -1,7 +1,6 @@
 #pragma once
 
 #define MAX_RIPPLES 32
-#define RIPPLE_DURATION 10
 
 #include "Canvas.h"
 #include <memory>
@@ -24,9 +23,134 @@
 #include "Water.h"
 #include "TreeManager.h"
 #include "FishController.h"
-#include "Emitter.h"
-#include "VirtualVertices.h"
+#include "ParticleSystem.h"
+#include "Simulation.h"
 #include "AudioEngine.h"
+// Water shader variables, looked up once in CreateWater
+struct WaterShaderHandles
+{
+	SimpleVertexShader* vertexShader;
+	SimplePixelShader* pixelShader;
+
+	// Vertex shader
+	int time;
+
+	// Pixel shader
+	int translate;
+	int transparency;
+	int cameraPosition;
+	int view;
+	int ripplePosition;
+	int rippleRadius;
+	int ringSize;
+	int ripples;
+	int rippleCount;
+	int skyTexture;
+	int normalTextureTwo;
+	int scenePixels;
+	int waterSplash;
+	int refractSampler;
+};
+
+//------------------------------------------------
+// Resources the frame loop uses, looked up by
+// name once after loading
+//------------------------------------------------
+struct FrameResourceHandles
+{
+	VertexShaderHandle quadVS;
+	VertexShaderHandle skyVS;
+	VertexShaderHandle refractionVS;
+	VertexShaderHandle shadowInstancedVS;
+
+	PixelShaderHandle quadPS;
+	PixelShaderHandle postPS;
+	PixelShaderHandle blurPS;
+	PixelShaderHandle bloomExtractPS;
+	PixelShaderHandle bloomPS;
+	PixelShaderHandle dofPS;
+	PixelShaderHandle lensFlareThresholdPS;
+	PixelShaderHandle ghostGenPS;
+	PixelShaderHandle lensFlarePS;
+	PixelShaderHandle skyPS;
+	PixelShaderHandle refractionPS;
+
+	MeshHandle cube;
+
+	SRVHandle cubemap;
+	SRVHandle waterNormal2;
+	SRVHandle particle;
+	SRVHandle radial;
+};
+
+//------------------------------------------------
+// Variables of the fullscreen quad pixel shaders.
+// Each one is looked up for all of them, the ones
+// it doesn't have stay invalid.
+//------------------------------------------------
+struct QuadShaderHandles
+{
+	int pixels;
+	int sampler;
+	int blurValue;
+	int baseTexture;
+	int bloomTexture;
+	int blurredPixels;
+	int depth;
+	int distance;
+	int range;
+	int nearPlane;
+	int farPlane;
+	int radial;
+	int lensFlare;
+};
+
+//------------------------------------------------
+// Variables of the shaders the frame loop sets up
+// by hand, looked up along with the resources
+//------------------------------------------------
+struct FrameShaderHandles
+{
+	// Shadow map
+	int shadowWorld;
+	int shadowView;
+	int shadowProjection;
+	int shadowInstancedView;
+	int shadowInstancedProjection;
+
+	// Sky
+	int skyView;
+	int skyProjection;
+	int skyTexture;
+	int skySampler;
+
+	// Refraction vertex shader
+	int refractionWorld;
+	int refractionView;
+	int refractionProjection;
+	int refractionTime;
+	int refractionWaves;
+
+	// Refraction pixel shader
+	int refractionScenePixels;
+	int refractionNormalMap;
+	int refractionBasicSampler;
+	int refractionRefractSampler;
+	int refractionCameraPosition;
+	int refractionNormalView;
+
+	// Post processing
+	QuadShaderHandles quad;
+	QuadShaderHandles post;
+	QuadShaderHandles blur;
+	QuadShaderHandles bloomExtract;
+	QuadShaderHandles bloom;
+	QuadShaderHandles dof;
+	QuadShaderHandles lensFlareThreshold;
+	QuadShaderHandles ghostGen;
+	QuadShaderHandles lensFlare;
+};
+
 class Game 
 	: public DXCore
 {
@@ -37,7 +161,7 @@ public:
 
 	// Overridden setup and game loop methods, which
 	// will be called automatically
-	void Init();
+	HRESULT Init();
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
@@ -54,6 +178,7 @@ private:
 	void InitializeEntities();
 	void InitializeRenderer();
 	void DrawSky();
+	void ResolveFrameHandles();
 
 	Entity* refractionEntity;
 
@@ -64,10 +189,7 @@ private:
 	void DepthOfFieldPostProcess(ID3D11ShaderResourceView*  texture);
 	void LensFlare(ID3D11ShaderResourceView*  texture);
 
-	void CreateRipple(float x, float y, float z, float duration, float ringSize = 0);
-	bool projectileHitWater;
 	bool isDofEnabled;
-	std::vector<Ripple> ripples;
 
 	SimpleVertexShader*			vertexShader;
 	SimplePixelShader*			pixelShader;
@@ -90,6 +212,27 @@ private:
 	std::unordered_map<std::string, Mesh*> models;
 	std::vector<Entity*> entities;	
 
+	// Every entity that can move, their transforms are rebuilt together each frame
+	std::vector<Entity*> transformEntities;
+
+	// Entities are culled against the camera before drawing
+	FrustumCuller culler;
+	std::vector<Entity*> drawEntities;
+	std::vector<Entity*> visibleEntities;
+	std::vector<Entity*> shadowCasters;
+	void CullEntities();
+
+	// Sorted draws for the refraction and main passes
+	RenderQueue renderQueue;
+	RenderQueueStats renderStats;
+	int renderStatsFrames;
+	float renderStatsTime;
+	void ReportRenderStats(float totalTime);
+
+	WaterShaderHandles waterHandles;
+	FrameResourceHandles frameHandles;
+	FrameShaderHandles shaderHandles;
+
 	ID3D11SamplerState* sampler;
 	ID3D11SamplerState* displacementSampler;
 
@@ -157,13 +300,19 @@ private:
 
 	std::unique_ptr<TreeManager> trees;
 	std::unique_ptr<FishController> fishes;
-	Emitter* emitter;
 	ID3D11BlendState* particleBlendState;
 	ID3D11DepthStencilState* particleDepthState;
-	std::vector<std::shared_ptr<Emitter>> emitters;
+	std::unique_ptr<ParticleSystem> particles;
+	Simulation simulation;
+
+	// Shared by everything that splits its work into jobs
+	std::unique_ptr<JobSystem> jobs;
 
-	//Virtual vertices for approximating collision on the water
-	VirtualVertices virtualVertices;
+	// The menu shows as soon as its own assets are in, the scene is
+	// set up once the rest have loaded
+	std::shared_future<void> sceneAssets;
+	bool sceneReady;
+	void InitializeScene();
 
 	//Canvas
 	Canvas *canvas;
@@ -0,0 +1,290 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+// Which system and queue the current thread works for. Threads that
+// are not workers (like the main thread) all share queue 0.
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local unsigned int currentQueue = 0;
+
+// Tries to find work before a worker goes to sleep
+const int WORKER_SPIN_COUNT = 64;
+
+// -----------------------------------------------------
+// Spin up the worker threads, each with its own queue
+// -----------------------------------------------------
+JobSystem::JobSystem(int workerCount)
+{
+	if (workerCount < 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+	}
+
+	queueCount = workerCount + 1;
+	queues = std::unique_ptr<WorkQueue[]>(new WorkQueue[queueCount]);
+	jobs = std::unique_ptr<Job[]>(new Job[MAX_JOBS]);
+	for (int i = 0; i < MAX_JOBS; i++)
+		jobs[i].unfinished = 0;
+	nextJob = 0;
+	queuedJobs = 0;
+	sleepingWorkers = 0;
+	shuttingDown = false;
+
+	for (int i = 0; i < workerCount; ++i)
+	{
+		threads.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+	}
+}
+
+// -----------------------------------------------------
+// Wake everyone up and wait for them to exit
+// -----------------------------------------------------
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		shuttingDown = true;
+	}
+	wakeCondition.notify_all();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+// -----------------------------------------------------
+// Take the next job from the ring. With more than
+// MAX_JOBS jobs in flight the slot is still live, so
+// we help out until it is done instead of overwriting
+// it. A job that is never run keeps its slot forever.
+// -----------------------------------------------------
+Job* JobSystem::CreateJob(const std::function<void()>& work)
+{
+	Job* job = &jobs[nextJob.fetch_add(1) & (MAX_JOBS - 1)];
+	Wait(job);
+	job->work = work;
+	job->parent = nullptr;
+	job->unfinished = 1;
+	job->waitingOn = 1;
+	job->dependentCount = 0;
+	return job;
+}
+
+Job* JobSystem::CreateChildJob(Job* parent, const std::function<void()>& work)
+{
+	parent->unfinished++;
+	Job* job = CreateJob(work);
+	job->parent = parent;
+	return job;
+}
+
+// -----------------------------------------------------
+// Once before has MAX_JOB_DEPENDENTS dependents, its
+// last one is handed to an empty relay job that waits
+// on before and starts both it and after
+// -----------------------------------------------------
+void JobSystem::AddDependency(Job* before, Job* after)
+{
+	if (before->dependentCount == MAX_JOB_DEPENDENTS)
+	{
+		Job* relay = CreateJob();
+		relay->dependents[relay->dependentCount++] = before->dependents[MAX_JOB_DEPENDENTS - 1];
+		before->dependents[MAX_JOB_DEPENDENTS - 1] = relay;
+		relay->waitingOn++;
+		Run(relay);
+		before = relay;
+	}
+
+	before->dependents[before->dependentCount++] = after;
+	after->waitingOn++;
+}
+
+// -----------------------------------------------------
+// Queued straight away, or once the last job it
+// depends on finishes
+// -----------------------------------------------------
+void JobSystem::Run(Job* job)
+{
+	if (--job->waitingOn == 0)
+		Push(job);
+}
+
+bool JobSystem::IsDone(const Job* job) const
+{
+	return job->unfinished.load() == 0;
+}
+
+// -----------------------------------------------------
+// Help out until the job is done
+// -----------------------------------------------------
+void JobSystem::Wait(const Job* job)
+{
+	while (!IsDone(job))
+	{
+		Job* next = Pop();
+		if (next)
+			Execute(next);
+		else
+			std::this_thread::yield();
+	}
+}
+
+// -----------------------------------------------------
+// One child job per chunk, the caller helps until
+// they are all done
+// -----------------------------------------------------
+void JobSystem::ParallelFor(int count, int grainSize, const std::function<void(int, int)>& body)
+{
+	if (count <= 0)
+		return;
+
+	// The root holds its slot until every chunk is done, so the chunks
+	// must not need more slots than the ring has
+	grainSize = (std::max)(grainSize, 1);
+	grainSize = (std::max)(grainSize, count / (MAX_JOBS / 2) + 1);
+
+	// Not worth splitting up
+	if (threads.empty() || count <= grainSize)
+	{
+		body(0, count);
+		return;
+	}
+
+	Job* root = CreateJob();
+	for (int begin = 0; begin < count; begin += grainSize)
+	{
+		int end = (std::min)(begin + grainSize, count);
+		Run(CreateChildJob(root, [&body, begin, end]() { body(begin, end); }));
+	}
+	Run(root);
+	Wait(root);
+}
+
+unsigned int JobSystem::GetWorkerCount() const
+{
+	return (unsigned int)threads.size();
+}
+
+unsigned int JobSystem::GetQueueIndex() const
+{
+	return currentSystem == this ? currentQueue : 0;
+}
+
+void JobSystem::Push(Job* job)
+{
+	WorkQueue& queue = queues[GetQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+
+	// A worker counts itself as sleeping before it checks for
+	// work, so one of the two always sees the other
+	queuedJobs++;
+	if (sleepingWorkers.load() > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wakeCondition.notify_one();
+	}
+}
+
+// -----------------------------------------------------
+// Newest job from our own queue, otherwise the
+// oldest job from somebody else's
+// -----------------------------------------------------
+Job* JobSystem::Pop()
+{
+	if (queuedJobs.load() == 0)
+		return nullptr;
+
+	unsigned int index = GetQueueIndex();
+	for (unsigned int i = 0; i < queueCount; i++)
+	{
+		WorkQueue& queue = queues[(index + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			continue;
+
+		Job* job;
+		if (i == 0)
+		{
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = queue.jobs.front();
+			queue.jobs.pop_front();
+		}
+		queuedJobs--;
+		return job;
+	}
+	return nullptr;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	if (job->work)
+		job->work();
+	Finish(job);
+}
+
+// -----------------------------------------------------
+// The last one out starts the dependents and lets
+// the parent know
+// -----------------------------------------------------
+void JobSystem::Finish(Job* job)
+{
+	// Whoever waits on the job may reuse it the moment it is done,
+	// so everything we need afterwards is read first
+	Job* parent = job->parent;
+	int dependentCount = job->dependentCount;
+	Job* dependents[MAX_JOB_DEPENDENTS];
+	for (int i = 0; i < dependentCount; i++)
+		dependents[i] = job->dependents[i];
+
+	if (--job->unfinished != 0)
+		return;
+
+	for (int i = 0; i < dependentCount; i++)
+		Run(dependents[i]);
+
+	if (parent)
+		Finish(parent);
+}
+
+void JobSystem::WorkerLoop(unsigned int queueIndex)
+{
+	currentSystem = this;
+	currentQueue = queueIndex;
+
+	int idleSpins = 0;
+	while (true)
+	{
+		Job* job = Pop();
+		if (job)
+		{
+			Execute(job);
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < WORKER_SPIN_COUNT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers++;
+		wakeCondition.wait(lock, [this]() { return shuttingDown || queuedJobs.load() > 0; });
+		sleepingWorkers--;
+		if (shuttingDown)
+			return;
+		idleSpins = 0;
+	}
+}
+
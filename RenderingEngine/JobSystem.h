@@ -0,0 +1,95 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+
+// Jobs come from a ring. Creating more than this many in flight at once
+// waits for the oldest to finish.
+#define MAX_JOBS 4096
+// Stored in the job, more than this go through extra empty jobs
+#define MAX_JOB_DEPENDENTS 8
+
+//------------------------------------------------
+// One piece of work in the job graph. A job is
+// finished once its work and all of its children
+// are done, and then starts any jobs that were
+// waiting on it.
+//------------------------------------------------
+struct Job
+{
+	std::function<void()> work;
+	Job* parent;
+	std::atomic<int> unfinished;	// Itself plus unfinished children
+	std::atomic<int> waitingOn;		// Unfinished dependencies, plus one until it is run
+	Job* dependents[MAX_JOB_DEPENDENTS];
+	int dependentCount;
+};
+
+//------------------------------------------------
+// Engine wide job system. Every thread has its
+// own queue of jobs and takes work from the back
+// of it, idle threads steal from the front of
+// the others. A thread waiting on a job works on
+// other jobs in the meantime.
+//------------------------------------------------
+class JobSystem
+{
+public:
+	// A negative workerCount uses (hardware threads - 1)
+	JobSystem(int workerCount = -1);
+	~JobSystem();
+
+	Job* CreateJob(const std::function<void()>& work = nullptr);
+
+	// The parent does not finish until the child has. Children are
+	// created before the parent is run or from inside its work.
+	Job* CreateChildJob(Job* parent, const std::function<void()>& work);
+
+	// after does not start until before has finished. Both jobs must be
+	// set up this way before either of them is run.
+	void AddDependency(Job* before, Job* after);
+
+	void Run(Job* job);
+	void Wait(const Job* job);
+	bool IsDone(const Job* job) const;
+
+	// Calls body(begin, end) over [0, count) in chunks of grainSize
+	// and blocks until every chunk has been processed
+	void ParallelFor(int count, int grainSize, const std::function<void(int, int)>& body);
+
+	unsigned int GetWorkerCount() const;
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Job*> jobs;
+	};
+
+	std::vector<std::thread> threads;
+	std::unique_ptr<WorkQueue[]> queues;	// Queue 0 belongs to threads outside the pool
+	unsigned int queueCount;
+
+	std::unique_ptr<Job[]> jobs;
+	std::atomic<unsigned int> nextJob;
+
+	// Workers sleep when there is nothing to steal
+	std::atomic<int> queuedJobs;
+	std::atomic<int> sleepingWorkers;
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	bool shuttingDown;
+
+	void WorkerLoop(unsigned int queueIndex);
+	unsigned int GetQueueIndex() const;
+	void Push(Job* job);
+	Job* Pop();
+	void Execute(Job* job);
+	void Finish(Job* job);
+};
+
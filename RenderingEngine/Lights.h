@@ -25,6 +25,19 @@ struct PointLight : public ILight
 	float Range;
 };
 
+// Same layout as the lightData constant buffer in the lit
+// pixel shaders. HLSL keeps a float3 from straddling a
+// 16 byte boundary, hence the padding before it.
+struct LightData
+{
+	DirectionalLight DirLights[MAX_LIGHTS];
+	PointLight PointLights[MAX_LIGHTS];
+	int DirectionalLightCount;
+	int PointLightCount;
+	float CountPadding[2];
+	XMFLOAT3 CameraPosition;
+	float CameraPadding;
+};
 
 struct Light
 {
@@ -1,6 +1,34 @@
 
 #include <Windows.h>
 #include "Game.h"
+#include "Simulation.h"
+#include "Benchmarks.h"
+#include "Tests.h"
+
+// The modes below print their results, so they need a console. Started
+// from a command prompt they print into it, otherwise they open their
+// own and keep it up until enter is pressed. Returns true for the latter.
+static bool OpenConsole()
+{
+	bool ownConsole = !AttachConsole(ATTACH_PARENT_PROCESS);
+	if (ownConsole)
+		AllocConsole();
+	FILE* stream;
+	freopen_s(&stream, "CONIN$", "r", stdin);
+	freopen_s(&stream, "CONOUT$", "w", stdout);
+	return ownConsole;
+}
+
+static void CloseConsole(bool ownConsole)
+{
+	if (ownConsole)
+	{
+		printf("\nPress enter to exit");
+		getchar();
+	}
+	else
+		printf("\n");
+}
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -44,6 +72,37 @@ int WINAPI WinMain(
 		}
 	}
 
+	// "-headless [steps]" runs only the simulation, with no window or
+	// device, and prints how many steps per second it manages
+	const char* headless = strstr(lpCmdLine, "-headless");
+	if (headless)
+	{
+		bool ownConsole = OpenConsole();
+		int steps = atoi(headless + strlen("-headless"));
+		Simulation::RunHeadless(steps > 0 ? steps : 100000);
+		CloseConsole(ownConsole);
+		return 0;
+	}
+
+	// "-benchmark" times the engine's hot paths instead of starting it.
+	// "-test" checks them against the code they replaced. Both exit with
+	// the number of failures, so a script can tell.
+	if (strstr(lpCmdLine, "-benchmark"))
+	{
+		bool ownConsole = OpenConsole();
+		int failed = RunBenchmarks();
+		CloseConsole(ownConsole);
+		return failed;
+	}
+
+	if (strstr(lpCmdLine, "-test"))
+	{
+		bool ownConsole = OpenConsole();
+		int failed = RunTests();
+		CloseConsole(ownConsole);
+		return failed;
+	}
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
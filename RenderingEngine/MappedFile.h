@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+//------------------------------------------------
+// A read only view of a whole file. The bytes
+// stay valid until the file is closed.
+//------------------------------------------------
+class MappedFile
+{
+	const uint8_t* data;
+	size_t size;
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+public:
+	MappedFile();
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+	const uint8_t* GetData() const;
+	size_t GetSize() const;
+};
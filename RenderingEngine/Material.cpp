@@ -4,12 +4,16 @@
 
 Material::Material()
 {
+	vertexShader = nullptr;
+	pixelShader = nullptr;
+	ResolveHandles();
 }
 
 Material::Material(SimpleVertexShader *vertexShader, SimplePixelShader *pixelShader)
 {
 	this->vertexShader = vertexShader;
 	this->pixelShader = pixelShader;
+	ResolveHandles();
 }
 
 Material::Material(SimpleVertexShader *vertexShader, SimplePixelShader *pixelShader, ID3D11ShaderResourceView *srv, ID3D11SamplerState *samplerState)
@@ -20,6 +24,7 @@ Material::Material(SimpleVertexShader *vertexShader, SimplePixelShader *pixelSha
 	sampler = samplerState;
 	normalSRV = nullptr;
 	roughnessSRV = nullptr;
+	ResolveHandles();
 }
 
 Material::Material(SimpleVertexShader *vertexShader, SimplePixelShader *pixelShader, ID3D11ShaderResourceView *srv, ID3D11ShaderResourceView *normal, ID3D11SamplerState *samplerState)
@@ -30,7 +35,8 @@ Material::Material(SimpleVertexShader *vertexShader, SimplePixelShader *pixelSha
 	sampler = samplerState;
 	normalSRV = normal;
 	auto rm = Resources::GetInstance();
-	roughnessSRV = rm->shaderResourceViews["defaultSpecular"];
+	roughnessSRV = rm->shaderResourceViews.Find("defaultSpecular");
+	ResolveHandles();
 }
 
 Material::Material(SimpleVertexShader *vertexShader, SimplePixelShader *pixelShader, ID3D11ShaderResourceView *srv, ID3D11ShaderResourceView *normal, ID3D11ShaderResourceView *roughness, ID3D11SamplerState *samplerState)
@@ -41,8 +47,35 @@ Material::Material(SimpleVertexShader *vertexShader, SimplePixelShader *pixelSha
 	sampler = samplerState;
 	normalSRV = normal;
 	roughnessSRV = roughness;
+	ResolveHandles();
 }
 
+// --------------------------------------------------------
+// Handles of a missing shader keep their invalid default
+// --------------------------------------------------------
+void Material::ResolveHandles()
+{
+	handles = MaterialHandles();
+
+	if (vertexShader)
+	{
+		handles.world = vertexShader->GetVariableHandle("world");
+		handles.view = vertexShader->GetVariableHandle("view");
+		handles.projection = vertexShader->GetVariableHandle("projection");
+		handles.shadowView = vertexShader->GetVariableHandle("shadowView");
+		handles.shadowProjection = vertexShader->GetVariableHandle("shadowProjection");
+	}
+
+	if (pixelShader)
+	{
+		handles.basicSampler = pixelShader->GetSamplerHandle("basicSampler");
+		handles.shadowSampler = pixelShader->GetSamplerHandle("shadowSampler");
+		handles.diffuseTexture = pixelShader->GetShaderResourceViewHandle("diffuseTexture");
+		handles.normalTexture = pixelShader->GetShaderResourceViewHandle("normalTexture");
+		handles.roughnessTexture = pixelShader->GetShaderResourceViewHandle("roughnessTexture");
+		handles.shadowMapTexture = pixelShader->GetShaderResourceViewHandle("shadowMapTexture");
+	}
+}
 
 Material::~Material()
 {
@@ -77,3 +110,8 @@ ID3D11SamplerState * Material::GetSampler()
 {
 	return sampler;
 }
+
+const MaterialHandles & Material::GetHandles() const
+{
+	return handles;
+}
@@ -2,6 +2,30 @@
 
 #include "SimpleShader.h"
 
+// --------------------------------------------------------
+// Shader variables and resources that entities set for
+// every material, looked up once when it is created.
+// Names the shader doesn't use stay invalid and setting
+// them does nothing, same as setting by name.
+// --------------------------------------------------------
+struct MaterialHandles
+{
+	// Vertex shader
+	int world = SIMPLE_SHADER_INVALID_HANDLE;
+	int view = SIMPLE_SHADER_INVALID_HANDLE;
+	int projection = SIMPLE_SHADER_INVALID_HANDLE;
+	int shadowView = SIMPLE_SHADER_INVALID_HANDLE;
+	int shadowProjection = SIMPLE_SHADER_INVALID_HANDLE;
+
+	// Pixel shader
+	int basicSampler = SIMPLE_SHADER_INVALID_HANDLE;
+	int shadowSampler = SIMPLE_SHADER_INVALID_HANDLE;
+	int diffuseTexture = SIMPLE_SHADER_INVALID_HANDLE;
+	int normalTexture = SIMPLE_SHADER_INVALID_HANDLE;
+	int roughnessTexture = SIMPLE_SHADER_INVALID_HANDLE;
+	int shadowMapTexture = SIMPLE_SHADER_INVALID_HANDLE;
+};
+
 class Material
 {
 	SimpleVertexShader*			vertexShader;
@@ -10,6 +34,8 @@ class Material
 	ID3D11ShaderResourceView*	normalSRV;
 	ID3D11ShaderResourceView*	roughnessSRV;
 	ID3D11SamplerState*			sampler;
+	MaterialHandles				handles;
+	void ResolveHandles();
 public:
 	Material();
 	Material(SimpleVertexShader*, SimplePixelShader*);
@@ -24,5 +50,6 @@ public:
 	ID3D11ShaderResourceView*	GetNormalSRV();
 	ID3D11ShaderResourceView*	GetRoughnessSRV();
 	ID3D11SamplerState*			GetSampler();
+	const MaterialHandles&		GetHandles() const;
 };
 
@@ -1,4 +1,6 @@
 #include "Mesh.h"
+#include "VertexWeld.h"
+#include "MeshOptimizer.h"
 
 
 
@@ -103,6 +105,25 @@ void Mesh::Initialize(VertexTerrain * vertices, UINT vertexCount, UINT * indices
 }
 
 Mesh::Mesh(const char *objFile, ID3D11Device *device)
+{
+	std::vector<Vertex> verts;
+	std::vector<UINT> indices;
+	if (!LoadObj(objFile, verts, indices))
+	{
+		vertexBuffer = nullptr;
+		indexBuffer = nullptr;
+		indexCount = 0;
+		vertexCount = 0;
+		return;
+	}
+
+	// Every face corner comes out as its own vertex, share the identical ones
+	WeldVertices(verts, indices);
+	OptimizeMesh(verts, indices);
+	Initialize(verts.data(), (UINT)verts.size(), indices.data(), (UINT)indices.size(), device);
+}
+
+bool Mesh::LoadObj(const char *objFile, std::vector<Vertex>& verts, std::vector<UINT>& indices)
 {
 	// File input object
 	std::ifstream obj(objFile);
@@ -110,15 +131,15 @@ Mesh::Mesh(const char *objFile, ID3D11Device *device)
 	// Check for successful open
 	if (!obj.is_open())
 	{
-		return;
+		return false;
 	}
 
 	// Variables used while reading the file
 	std::vector<XMFLOAT3> positions;     // Positions from the file
 	std::vector<XMFLOAT3> normals;       // Normals from the file
 	std::vector<XMFLOAT2> uvs;           // UVs from the file
-	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
+	verts.clear();
+	indices.clear();
 	unsigned int vertCounter = 0;        // Count of vertices/indices
 	char chars[100];                     // String for line reading
 
@@ -259,10 +280,8 @@ Mesh::Mesh(const char *objFile, ID3D11Device *device)
 		}
 	}
 
-	// Close the file and create the actual buffers
 	obj.close();
-
-	Initialize(verts.data(), (UINT)verts.size(), indices.data(), (UINT)indices.size(), device);
+	return true;
 }
 
 //------------------------------------------
@@ -270,21 +289,16 @@ Mesh::Mesh(const char *objFile, ID3D11Device *device)
 //------------------------------------------
 void Mesh::Initialize(Vertex *vertices, UINT vertexCount, UINT *indices, UINT indexCount, ID3D11Device *device)
 {
-	//Calculate max and min dimensions
-	minDimensions = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
-	maxDimensions = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-	for (UINT i = 0; i < vertexCount; ++i)
-	{
-		auto pos = vertices[i].Position;
-		if (pos.x < minDimensions.x)minDimensions.x = pos.x;
-		if (pos.y < minDimensions.y)minDimensions.y = pos.y;
-		if (pos.z < minDimensions.z)minDimensions.z = pos.z;
-		if (pos.x > maxDimensions.x)maxDimensions.x = pos.x;
-		if (pos.y > maxDimensions.y)maxDimensions.y = pos.y;
-		if (pos.z > maxDimensions.z)maxDimensions.z = pos.z;
-	}
-
+	XMFLOAT3 minBounds, maxBounds;
+	CalculateBounds(vertices, vertexCount, minBounds, maxBounds);
 	CalculateTangents(vertices, vertexCount, indices, indexCount);
+	Initialize((const Vertex*)vertices, vertexCount, indices, indexCount, minBounds, maxBounds, device);
+}
+
+void Mesh::Initialize(const Vertex *vertices, UINT vertexCount, const UINT *indices, UINT indexCount, XMFLOAT3 minDimensions, XMFLOAT3 maxDimensions, ID3D11Device *device)
+{
+	this->minDimensions = minDimensions;
+	this->maxDimensions = maxDimensions;
 	this->indexCount = indexCount;
 	this->vertexCount = vertexCount;
 
@@ -313,6 +327,22 @@ void Mesh::Initialize(Vertex *vertices, UINT vertexCount, UINT *indices, UINT in
 	device->CreateBuffer(&ibd, &initialIndexData, &indexBuffer);
 }
 
+void Mesh::CalculateBounds(const Vertex * vertices, UINT vertexCount, XMFLOAT3 & minDimensions, XMFLOAT3 & maxDimensions)
+{
+	minDimensions = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	maxDimensions = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (UINT i = 0; i < vertexCount; ++i)
+	{
+		auto pos = vertices[i].Position;
+		if (pos.x < minDimensions.x)minDimensions.x = pos.x;
+		if (pos.y < minDimensions.y)minDimensions.y = pos.y;
+		if (pos.z < minDimensions.z)minDimensions.z = pos.z;
+		if (pos.x > maxDimensions.x)maxDimensions.x = pos.x;
+		if (pos.y > maxDimensions.y)maxDimensions.y = pos.y;
+		if (pos.z > maxDimensions.z)maxDimensions.z = pos.z;
+	}
+}
+
 void Mesh::CalculateTangents(Vertex * vertices, UINT vertexCount, UINT * indices, UINT indexCount)
 {
 	XMFLOAT3 *tan1 = new XMFLOAT3[vertexCount * 2];
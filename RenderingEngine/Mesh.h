@@ -28,9 +28,18 @@ public:
 	UINT GetVertexCount() const;
 	void Initialize(Vertex *vertices, UINT vertexCount, UINT *indices, UINT indexCount, ID3D11Device *device);
 	void Initialize(VertexTerrain *vertices, UINT vertexCount, UINT *indices, UINT indexCount, ID3D11Device *device);
-	void CalculateTangents(Vertex *vertices, UINT vertexCount, UINT *indices, UINT indexCount);
-	void CalculateTangents(VertexTerrain *vertices, UINT vertexCount, UINT *indices, UINT indexCount);
-	void CalculateTangents(VertexAnimated *vertices, UINT vertexCount, UINT *indices, UINT indexCount);
+
+	// For vertices that already have their tangents and bounds, e.g.
+	// straight out of the mesh cache. Nothing is computed or copied.
+	void Initialize(const Vertex *vertices, UINT vertexCount, const UINT *indices, UINT indexCount, XMFLOAT3 minDimensions, XMFLOAT3 maxDimensions, ID3D11Device *device);
+
+	// Reads an OBJ the way the filename constructor does, without
+	// calculating tangents or touching the GPU
+	static bool LoadObj(const char* filename, std::vector<Vertex>& vertices, std::vector<UINT>& indices);
+	static void CalculateBounds(const Vertex *vertices, UINT vertexCount, XMFLOAT3& minDimensions, XMFLOAT3& maxDimensions);
+	static void CalculateTangents(Vertex *vertices, UINT vertexCount, UINT *indices, UINT indexCount);
+	static void CalculateTangents(VertexTerrain *vertices, UINT vertexCount, UINT *indices, UINT indexCount);
+	static void CalculateTangents(VertexAnimated *vertices, UINT vertexCount, UINT *indices, UINT indexCount);
 	XMFLOAT3 GetMaxDimensions() const;
 	XMFLOAT3 GetMinDimensions() const;
 private:
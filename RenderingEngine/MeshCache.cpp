@@ -0,0 +1,230 @@
+#include "MeshCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+struct MeshCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexStride;
+	uint32_t meshCount;
+	uint64_t sourceHash;
+	uint64_t sourceSize;
+	int64_t sourceTime;
+};
+
+// Offsets are from the start of the file
+struct MeshCacheRecord
+{
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t textureOffset;
+	uint32_t textureLength;
+	uint32_t vertexOffset;
+	uint32_t vertexCount;
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	DirectX::XMFLOAT3 minDimensions;
+	DirectX::XMFLOAT3 maxDimensions;
+};
+
+// Size and last write time, in seconds
+static bool GetFileStamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+#ifdef _WIN32
+	struct _stat64 status;
+	if (_stat64(path.c_str(), &status) != 0)
+		return false;
+#else
+	struct stat status;
+	if (stat(path.c_str(), &status) != 0)
+		return false;
+#endif
+	size = (uint64_t)status.st_size;
+	time = (int64_t)status.st_mtime;
+	return true;
+}
+
+static uint64_t HashBytes(const uint8_t* bytes, size_t size)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// -----------------------------------------------------
+// Anything that doesn't add up (wrong version, vertex
+// layout, source or sizes) is a miss and the caller
+// cooks the source again. A miss doesn't keep the file
+// mapped, so the caller can write the new cache over it.
+// -----------------------------------------------------
+bool MeshCache::Open(const std::string & cachePath, const std::string & sourcePath)
+{
+	entries.clear();
+	if (!file.Open(cachePath))
+		return false;
+
+	if (!ReadEntries(sourcePath))
+	{
+		entries.clear();
+		file.Close();
+		return false;
+	}
+	return true;
+}
+
+bool MeshCache::ReadEntries(const std::string & sourcePath)
+{
+	const uint8_t* base = file.GetData();
+	uint64_t size = file.GetSize();
+	if (size < sizeof(MeshCacheHeader))
+		return false;
+
+	MeshCacheHeader header;
+	memcpy(&header, base, sizeof(header));
+	if (header.magic != MESH_CACHE_MAGIC || header.version != MESH_CACHE_VERSION || header.vertexStride != sizeof(Vertex))
+		return false;
+
+	// Same size and time is taken as unchanged. Anything else, like a
+	// fresh checkout, falls back to comparing the contents.
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if (!GetFileStamp(sourcePath, sourceSize, sourceTime) || sourceSize != header.sourceSize)
+		return false;
+	if (sourceTime != header.sourceTime)
+	{
+		MappedFile source;
+		if (!source.Open(sourcePath) || source.GetSize() != header.sourceSize)
+			return false;
+		if (HashBytes(source.GetData(), source.GetSize()) != header.sourceHash)
+			return false;
+	}
+
+	uint64_t recordsEnd = sizeof(MeshCacheHeader) + (uint64_t)header.meshCount * sizeof(MeshCacheRecord);
+	if (recordsEnd > size)
+		return false;
+
+	const MeshCacheRecord* records = (const MeshCacheRecord*)(base + sizeof(MeshCacheHeader));
+	for (uint32_t i = 0; i < header.meshCount; i++)
+	{
+		const MeshCacheRecord& record = records[i];
+		if ((uint64_t)record.nameOffset + record.nameLength > size ||
+			(uint64_t)record.textureOffset + record.textureLength > size ||
+			(uint64_t)record.vertexOffset + (uint64_t)record.vertexCount * sizeof(Vertex) > size ||
+			(uint64_t)record.indexOffset + (uint64_t)record.indexCount * sizeof(uint32_t) > size ||
+			record.vertexOffset % 4 != 0 || record.indexOffset % 4 != 0)
+			return false;
+
+		MeshCacheEntry entry;
+		entry.name.assign((const char*)base + record.nameOffset, record.nameLength);
+		entry.texture.assign((const char*)base + record.textureOffset, record.textureLength);
+		entry.vertices = (const Vertex*)(base + record.vertexOffset);
+		entry.vertexCount = record.vertexCount;
+		entry.indices = (const uint32_t*)(base + record.indexOffset);
+		entry.indexCount = record.indexCount;
+		entry.minDimensions = record.minDimensions;
+		entry.maxDimensions = record.maxDimensions;
+		entries.push_back(entry);
+	}
+	return true;
+}
+
+const std::vector<MeshCacheEntry>& MeshCache::GetEntries() const
+{
+	return entries;
+}
+
+// -----------------------------------------------------
+// Header, one record per mesh, the names, then the
+// vertex and index blobs each starting 16 byte aligned
+// -----------------------------------------------------
+bool MeshCache::Write(const std::string & cachePath, const std::string & sourcePath, const std::vector<MeshCacheEntry>& entries)
+{
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(Vertex);
+	header.meshCount = (uint32_t)entries.size();
+	{
+		// Stamped before hashing, so an edit in between leaves a stamp
+		// that won't match and the next Open hashes again
+		uint64_t stampSize;
+		MappedFile source;
+		if (!GetFileStamp(sourcePath, stampSize, header.sourceTime) || !source.Open(sourcePath))
+			return false;
+		header.sourceHash = HashBytes(source.GetData(), source.GetSize());
+		header.sourceSize = source.GetSize();
+	}
+
+	std::vector<MeshCacheRecord> records(entries.size());
+	uint64_t offset = sizeof(MeshCacheHeader) + records.size() * sizeof(MeshCacheRecord);
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		records[i].nameOffset = (uint32_t)offset;
+		records[i].nameLength = (uint32_t)entries[i].name.size();
+		offset += entries[i].name.size();
+		records[i].textureOffset = (uint32_t)offset;
+		records[i].textureLength = (uint32_t)entries[i].texture.size();
+		offset += entries[i].texture.size();
+	}
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		offset = (offset + 15) & ~15ull;
+		records[i].vertexOffset = (uint32_t)offset;
+		records[i].vertexCount = entries[i].vertexCount;
+		offset += (uint64_t)entries[i].vertexCount * sizeof(Vertex);
+		offset = (offset + 15) & ~15ull;
+		records[i].indexOffset = (uint32_t)offset;
+		records[i].indexCount = entries[i].indexCount;
+		offset += (uint64_t)entries[i].indexCount * sizeof(uint32_t);
+		records[i].minDimensions = entries[i].minDimensions;
+		records[i].maxDimensions = entries[i].maxDimensions;
+	}
+	if (offset > UINT32_MAX)
+		return false;
+
+	std::vector<uint8_t> bytes((size_t)offset, 0);
+	memcpy(bytes.data(), &header, sizeof(header));
+	if (!records.empty())
+		memcpy(bytes.data() + sizeof(header), records.data(), records.size() * sizeof(MeshCacheRecord));
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		memcpy(bytes.data() + records[i].nameOffset, entries[i].name.data(), records[i].nameLength);
+		memcpy(bytes.data() + records[i].textureOffset, entries[i].texture.data(), records[i].textureLength);
+		memcpy(bytes.data() + records[i].vertexOffset, entries[i].vertices, records[i].vertexCount * sizeof(Vertex));
+		memcpy(bytes.data() + records[i].indexOffset, entries[i].indices, records[i].indexCount * sizeof(uint32_t));
+	}
+
+	// Written beside the real thing and swapped in, so a crash part way
+	// through never leaves a cache that looks valid
+	std::string tempPath = cachePath + ".tmp";
+	std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+	output.write((const char*)bytes.data(), bytes.size());
+	output.close();
+	if (output.fail())
+	{
+		remove(tempPath.c_str());
+		return false;
+	}
+	remove(cachePath.c_str());
+	return rename(tempPath.c_str(), cachePath.c_str()) == 0;
+}
+
+std::string MeshCache::GetCachePath(const std::string & sourcePath)
+{
+	return sourcePath + ".meshcache";
+}
+
+uint64_t MeshCache::HashFile(const std::string & path)
+{
+	MappedFile source;
+	if (!source.Open(path))
+		return 0;
+	return HashBytes(source.GetData(), source.GetSize());
+}
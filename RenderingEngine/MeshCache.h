@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Vertex.h"
+#include "MappedFile.h"
+
+// Bump whenever the layout below or the way meshes are cooked changes
+#define MESH_CACHE_VERSION 4
+#define MESH_CACHE_MAGIC 0x4843534D	// "MSCH"
+
+//------------------------------------------------
+// One mesh as it goes into or comes out of the
+// cache. Vertices have their tangents already.
+//------------------------------------------------
+struct MeshCacheEntry
+{
+	std::string name;
+	std::string texture;	// Diffuse map from the OBJ's material, may be empty
+	const Vertex* vertices;
+	uint32_t vertexCount;
+	const uint32_t* indices;
+	uint32_t indexCount;
+	DirectX::XMFLOAT3 minDimensions;
+	DirectX::XMFLOAT3 maxDimensions;
+};
+
+//------------------------------------------------
+// Cooked meshes of one source file, kept next to
+// it. The cache is stamped with the source's size,
+// modified time and hash, so editing the source
+// invalidates it. The source is only hashed again
+// when its size or time no longer match.
+//------------------------------------------------
+class MeshCache
+{
+	MappedFile file;
+	std::vector<MeshCacheEntry> entries;
+	bool ReadEntries(const std::string& sourcePath);
+public:
+	// Maps the cache and checks it was cooked from sourcePath as it is
+	// now. Entries point straight into the mapped file.
+	bool Open(const std::string& cachePath, const std::string& sourcePath);
+	const std::vector<MeshCacheEntry>& GetEntries() const;
+
+	static bool Write(const std::string& cachePath, const std::string& sourcePath, const std::vector<MeshCacheEntry>& entries);
+
+	// Where the cache for a source file lives
+	static std::string GetCachePath(const std::string& sourcePath);
+
+	// FNV-1a of the file's bytes, 0 if it can't be read
+	static uint64_t HashFile(const std::string& path);
+};
@@ -0,0 +1,264 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+// -----------------------------------------------------
+// A vertex is in the cache while fewer than cacheSize
+// others were added after it, which is a FIFO without
+// having to keep one
+// -----------------------------------------------------
+struct VertexCacheTimestamps
+{
+	std::vector<unsigned int> added;
+	unsigned int time;
+	unsigned int cacheSize;
+
+	VertexCacheTimestamps(unsigned int vertexCount, int cacheSize) :
+		added(vertexCount, 0), time(cacheSize + 1), cacheSize(cacheSize)
+	{
+	}
+
+	bool InCache(unsigned int vertex) const
+	{
+		return time - added[vertex] <= cacheSize;
+	}
+
+	// Returns true on a miss
+	bool Use(unsigned int vertex)
+	{
+		if (InCache(vertex))
+			return false;
+		added[vertex] = time++;
+		return true;
+	}
+
+	void Flush()
+	{
+		time += cacheSize + 1;
+	}
+};
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int * indices, size_t indexCount, unsigned int vertexCount, int cacheSize)
+{
+	VertexCacheTimestamps cache(vertexCount, cacheSize);
+	std::vector<bool> used(vertexCount, false);
+	size_t misses = 0, usedCount = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (cache.Use(indices[i]))
+			misses++;
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			usedCount++;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.acmr = indexCount >= 3 ? (float)misses / (indexCount / 3) : 0.0f;
+	stats.atvr = usedCount ? (float)misses / usedCount : 0.0f;
+	return stats;
+}
+
+// Back along the triangles just emitted, then on through the vertices
+static int SkipDeadEnd(const std::vector<unsigned int>& liveTriangles, std::vector<unsigned int>& deadEnds, unsigned int& cursor)
+{
+	while (!deadEnds.empty())
+	{
+		unsigned int vertex = deadEnds.back();
+		deadEnds.pop_back();
+		if (liveTriangles[vertex] > 0)
+			return (int)vertex;
+	}
+	for (; cursor < liveTriangles.size(); cursor++)
+	{
+		if (liveTriangles[cursor] > 0)
+			return (int)cursor;
+	}
+	return -1;
+}
+
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>* clusters, int cacheSize)
+{
+	size_t triangleCount = indices.size() / 3;
+
+	// Triangles around each vertex, packed one vertex after another
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		liveTriangles[indices[i]]++;
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+	VertexCacheTimestamps cache(vertexCount, cacheSize);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnds;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> ordered;
+	ordered.reserve(triangleCount * 3);
+	deadEnds.reserve(triangleCount * 3);
+	unsigned int cursor = 0;
+
+	if (clusters)
+		clusters->clear();
+
+	bool jumped = true;
+	int fan = SkipDeadEnd(liveTriangles, deadEnds, cursor);
+	while (fan >= 0)
+	{
+		if (jumped && clusters)
+			clusters->push_back((unsigned int)(ordered.size() / 3));
+
+		// Every triangle left around the fanning vertex
+		candidates.clear();
+		for (unsigned int a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++)
+		{
+			unsigned int triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				unsigned int vertex = indices[triangle * 3 + corner];
+				ordered.push_back(vertex);
+				deadEnds.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+				cache.Use(vertex);
+			}
+			emitted[triangle] = true;
+		}
+
+		// Next fan around the vertex that has been in the cache longest
+		// but will still be there after its remaining triangles are drawn.
+		// One that would drop out scores 0 and is never picked, as in
+		// Tipsify, so the dead-end stack takes over instead.
+		fan = -1;
+		int bestPriority = 0;
+		for (unsigned int vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+			int age = (int)(cache.time - cache.added[vertex]);
+			int priority = age + 2 * (int)liveTriangles[vertex] <= cacheSize ? age : 0;
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				fan = (int)vertex;
+			}
+		}
+
+		jumped = fan < 0;
+		if (jumped)
+			fan = SkipDeadEnd(liveTriangles, deadEnds, cursor);
+	}
+
+	indices.swap(ordered);
+}
+
+struct OverdrawCluster
+{
+	unsigned int begin;
+	unsigned int end;
+	float sortKey;
+};
+
+// -----------------------------------------------------
+// Clusters are cut wherever the cluster so far is
+// about as cache friendly as the whole mesh, then put
+// in order of how far their centroid lies in front of
+// the mesh's centroid along their average normal
+// -----------------------------------------------------
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<XMFLOAT3>& positions, const std::vector<unsigned int>& clusters, int cacheSize, float threshold)
+{
+	unsigned int triangleCount = (unsigned int)(indices.size() / 3);
+	if (triangleCount == 0)
+		return;
+
+	float meshAcmr = AnalyzeVertexCache(indices.data(), triangleCount * 3, (unsigned int)positions.size(), cacheSize).acmr;
+
+	std::vector<unsigned int> hardBoundaries = clusters;
+	if (hardBoundaries.empty() || hardBoundaries[0] != 0)
+		hardBoundaries.insert(hardBoundaries.begin(), 0);
+
+	std::vector<OverdrawCluster> split;
+	VertexCacheTimestamps cache((unsigned int)positions.size(), cacheSize);
+	for (size_t h = 0; h < hardBoundaries.size(); h++)
+	{
+		unsigned int end = h + 1 < hardBoundaries.size() ? hardBoundaries[h + 1] : triangleCount;
+		unsigned int begin = hardBoundaries[h];
+		unsigned int misses = 0;
+		cache.Flush();
+		for (unsigned int t = begin; t < end; t++)
+		{
+			for (int corner = 0; corner < 3; corner++)
+				misses += cache.Use(indices[t * 3 + corner]) ? 1 : 0;
+
+			unsigned int clusterTriangles = t + 1 - begin;
+			if (t + 1 < end && misses <= threshold * meshAcmr * clusterTriangles)
+			{
+				split.push_back({ begin, t + 1, 0.0f });
+				begin = t + 1;
+				misses = 0;
+				cache.Flush();
+			}
+		}
+		if (begin < end)
+			split.push_back({ begin, end, 0.0f });
+	}
+
+	// Area weighted centroids, normals summed unnormalized so bigger
+	// triangles count for more
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0;
+	std::vector<XMFLOAT3> centroids(split.size());
+	std::vector<XMFLOAT3> normals(split.size());
+	for (size_t c = 0; c < split.size(); c++)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0;
+		for (unsigned int t = split[c].begin; t < split[c].end; t++)
+		{
+			XMVECTOR a = XMLoadFloat3(&positions[indices[t * 3]]);
+			XMVECTOR b = XMLoadFloat3(&positions[indices[t * 3 + 1]]);
+			XMVECTOR d = XMLoadFloat3(&positions[indices[t * 3 + 2]]);
+			XMVECTOR cross = XMVector3Cross(b - a, d - a);
+			float triangleArea = XMVectorGetX(XMVector3Length(cross)) * 0.5f;
+			centroid += (a + b + d) * (triangleArea / 3.0f);
+			normal += cross;
+			area += triangleArea;
+		}
+		meshCentroid += centroid;
+		meshArea += area;
+		XMStoreFloat3(&centroids[c], area > 0 ? centroid / area : centroid);
+		XMStoreFloat3(&normals[c], XMVector3Normalize(normal));
+	}
+	if (meshArea > 0)
+		meshCentroid /= meshArea;
+
+	for (size_t c = 0; c < split.size(); c++)
+	{
+		XMVECTOR offset = XMLoadFloat3(&centroids[c]) - meshCentroid;
+		float sortKey = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&normals[c])));
+		split[c].sortKey = sortKey == sortKey ? sortKey : 0.0f;
+	}
+	std::stable_sort(split.begin(), split.end(), [](const OverdrawCluster& a, const OverdrawCluster& b)
+	{
+		return a.sortKey > b.sortKey;
+	});
+
+	std::vector<unsigned int> sorted;
+	sorted.reserve(indices.size());
+	for (auto& cluster : split)
+		sorted.insert(sorted.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+	sorted.insert(sorted.end(), indices.begin() + triangleCount * 3, indices.end());
+
+	float sortedAcmr = AnalyzeVertexCache(sorted.data(), triangleCount * 3, (unsigned int)positions.size(), cacheSize).acmr;
+	if (sortedAcmr <= meshAcmr * OVERDRAW_MAX_ACMR_LOSS)
+		indices.swap(sorted);
+}
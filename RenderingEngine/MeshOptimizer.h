@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+// Entries in the FIFO post-transform cache the optimizer aims for and
+// the simulator models
+#define VERTEX_CACHE_SIZE 16
+
+// Clusters are split while they stay within this factor of the
+// mesh's ACMR, trading a little cache efficiency for sortable clusters
+#define OVERDRAW_CLUSTER_THRESHOLD 1.05f
+
+// Sorting clusters loses the cache hits between them. When the sorted
+// order's ACMR is more than this factor worse, the cache order stays.
+#define OVERDRAW_MAX_ACMR_LOSS 1.15f
+
+struct VertexCacheStats
+{
+	float acmr;	// Vertices transformed per triangle, 3 at worst and around 0.5 on a large regular grid
+	float atvr;	// Vertices transformed per vertex used, 1 at best
+};
+
+// -----------------------------------------------------
+// Runs triangles through a FIFO post-transform cache
+// of cacheSize entries, counting the misses
+// -----------------------------------------------------
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, unsigned int vertexCount, int cacheSize = VERTEX_CACHE_SIZE);
+
+// -----------------------------------------------------
+// Tipsify (Sander, Nehab and Barczak 2007): reorders
+// triangles for the post-transform cache. Where the
+// order had to jump to an unconnected part of the mesh
+// the triangle offset goes into clusters.
+// -----------------------------------------------------
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, std::vector<unsigned int>* clusters, int cacheSize = VERTEX_CACHE_SIZE);
+
+// -----------------------------------------------------
+// Splits the clusters from OptimizeVertexCache further
+// and sorts them so the ones facing out from the middle
+// of the mesh draw first, letting early Z reject what
+// they hide. Leaves the order alone if that costs too
+// many cache misses.
+// -----------------------------------------------------
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<DirectX::XMFLOAT3>& positions, const std::vector<unsigned int>& clusters, int cacheSize = VERTEX_CACHE_SIZE, float threshold = OVERDRAW_CLUSTER_THRESHOLD);
+
+// -----------------------------------------------------
+// Moves vertices into the order the indices first use
+// them, so vertex fetches walk the buffer forwards.
+// Unused vertices are dropped.
+// -----------------------------------------------------
+template<typename T>
+void OptimizeVertexFetch(std::vector<T>& vertices, std::vector<unsigned int>& indices)
+{
+	const unsigned int unassigned = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(vertices.size(), unassigned);
+	std::vector<T> reordered;
+	reordered.reserve(vertices.size());
+	for (auto& index : indices)
+	{
+		if (remap[index] == unassigned)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(reordered);
+}
+
+// Cache order, then overdraw order, then fetch order. Vertices need a
+// Position with x, y and z.
+template<typename T>
+void OptimizeMesh(std::vector<T>& vertices, std::vector<unsigned int>& indices)
+{
+	std::vector<unsigned int> clusters;
+	OptimizeVertexCache(indices, (unsigned int)vertices.size(), &clusters);
+
+	std::vector<DirectX::XMFLOAT3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		positions[i] = DirectX::XMFLOAT3(vertices[i].Position.x, vertices[i].Position.y, vertices[i].Position.z);
+	OptimizeOverdraw(indices, positions, clusters);
+
+	OptimizeVertexFetch(vertices, indices);
+}
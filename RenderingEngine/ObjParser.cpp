@@ -0,0 +1,719 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// Files are only split up when every chunk gets at least this many bytes
+#define OBJ_PARSER_MIN_CHUNK_SIZE (256 * 1024)
+
+// Parts of a face vertex ("v/vt/vn") that are looked at
+#define OBJ_PARSER_MAX_VERTEX_PARTS 3
+
+struct ObjText
+{
+	const char* begin;
+	const char* end;
+
+	bool Empty() const { return begin == end; }
+	bool Is(const char* text) const
+	{
+		size_t length = strlen(text);
+		return (size_t)(end - begin) == length && memcmp(begin, text, length) == 0;
+	}
+	std::string ToString() const { return std::string(begin, end); }
+};
+
+struct ObjEvent
+{
+	enum Type { Group, UseMaterial, MaterialLibrary };
+	Type type;
+	bool named;			// "o" or "g", rather than a line that merely starts with 'g'
+	std::string text;
+	size_t vertexMark;	// How much of the chunk's output came before this line
+	size_t indexMark;
+};
+
+struct ObjChunk
+{
+	const char* begin;
+	const char* end;
+
+	std::vector<objl::Vector3> positions;
+	std::vector<objl::Vector2> texCoords;
+	std::vector<objl::Vector3> normals;
+
+	// How many of each came before this chunk
+	size_t positionBase;
+	size_t texCoordBase;
+	size_t normalBase;
+
+	// Indices count from the chunk's first vertex
+	std::vector<objl::Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<ObjEvent> events;
+};
+
+static bool IsBlank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+// -----------------------------------------------------
+// The next line without its newline. A CR before the
+// newline goes too, as it would reading in text mode.
+// -----------------------------------------------------
+static const char* NextLine(const char* position, const char* end, ObjText& line)
+{
+	const char* newline = (const char*)memchr(position, '\n', end - position);
+	line.begin = position;
+	line.end = newline ? newline : end;
+	if (newline && line.end > line.begin && line.end[-1] == '\r')
+		line.end--;
+	return newline ? newline + 1 : end;
+}
+
+// objl::algorithm::firstToken
+static ObjText FirstToken(ObjText line)
+{
+	const char* start = line.begin;
+	while (start < line.end && IsBlank(*start))
+		start++;
+	const char* stop = start;
+	while (stop < line.end && !IsBlank(*stop))
+		stop++;
+	return { start, stop };
+}
+
+// objl::algorithm::tail
+static ObjText Tail(ObjText line)
+{
+	ObjText token = FirstToken(line);
+	const char* start = token.end;
+	while (start < line.end && IsBlank(*start))
+		start++;
+	const char* stop = line.end;
+	while (stop > start && IsBlank(stop[-1]))
+		stop--;
+	return { start, stop };
+}
+
+// -----------------------------------------------------
+// objl::algorithm::split on a one character token: a
+// plain split, except a trailing empty piece is
+// dropped. Returns how many pieces there are, only the
+// first maxParts are kept.
+// -----------------------------------------------------
+static int Split(ObjText text, char token, ObjText* parts, int maxParts)
+{
+	int count = 0;
+	const char* piece = text.begin;
+	for (const char* c = text.begin; c < text.end; c++)
+	{
+		if (*c != token)
+			continue;
+		if (count < maxParts)
+			parts[count] = { piece, c };
+		count++;
+		piece = c + 1;
+	}
+	if (piece < text.end)
+	{
+		if (count < maxParts)
+			parts[count] = { piece, text.end };
+		count++;
+	}
+	return count;
+}
+
+static bool IsSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// What std::stoi reads from the start of the text
+static int ParseInt(ObjText text)
+{
+	const char* c = text.begin;
+	while (c < text.end && IsSpace(*c))
+		c++;
+	bool negative = false;
+	if (c < text.end && (*c == '-' || *c == '+'))
+		negative = *c++ == '-';
+	int value = 0;
+	while (c < text.end && *c >= '0' && *c <= '9')
+		value = value * 10 + (*c++ - '0');
+	return negative ? -value : value;
+}
+
+// -----------------------------------------------------
+// Every step is exact while the digits fit in a float
+// and the power of ten does too, so the one rounding
+// happens in the final multiply or divide, same as
+// strtof would round
+// -----------------------------------------------------
+float ObjParser::ParseFloat(const char* begin, const char* end)
+{
+	static const float powersOfTen[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+	const char* c = begin;
+	while (c < end && IsSpace(*c))
+		c++;
+	bool negative = false;
+	if (c < end && (*c == '-' || *c == '+'))
+		negative = *c++ == '-';
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	bool anyDigits = false;
+	bool exact = true;
+	for (; c < end && *c >= '0' && *c <= '9'; c++)
+	{
+		anyDigits = true;
+		if (mantissa == 0 && *c == '0')
+			continue;
+		if (digits++ < 19)
+			mantissa = mantissa * 10 + (*c - '0');
+		else
+			exact = false;
+	}
+	if (c < end && *c == '.')
+	{
+		for (c++; c < end && *c >= '0' && *c <= '9'; c++)
+		{
+			anyDigits = true;
+			if (mantissa == 0 && *c == '0')
+			{
+				exponent--;
+				continue;
+			}
+			if (digits++ < 19)
+			{
+				mantissa = mantissa * 10 + (*c - '0');
+				exponent--;
+			}
+			else
+				exact = false;
+		}
+	}
+	if (c < end && (*c == 'e' || *c == 'E'))
+	{
+		const char* e = c + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+			negativeExponent = *e++ == '-';
+		if (e < end && *e >= '0' && *e <= '9')
+		{
+			int value = 0;
+			for (; e < end && *e >= '0' && *e <= '9'; e++)
+				value = value < 10000 ? value * 10 + (*e - '0') : value;
+			exponent += negativeExponent ? -value : value;
+		}
+	}
+
+	if (anyDigits && exact)
+	{
+		if (mantissa == 0)
+			return negative ? -0.0f : 0.0f;
+		while (mantissa % 10 == 0)
+		{
+			mantissa /= 10;
+			exponent++;
+		}
+		if (mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10)
+		{
+			float value = (float)mantissa;
+			value = exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+			return negative ? -value : value;
+		}
+	}
+
+	// Long mantissas, huge exponents, hex, inf and nan
+	char buffer[64];
+	size_t length = (size_t)(end - begin);
+	if (length < sizeof(buffer))
+	{
+		memcpy(buffer, begin, length);
+		buffer[length] = 0;
+		return strtof(buffer, nullptr);
+	}
+	return strtof(std::string(begin, end).c_str(), nullptr);
+}
+
+template<typename T>
+static T GetElement(const std::vector<T>& elements, size_t count, ObjText index)
+{
+	// objl::algorithm::getElement, with negative indices counting back
+	// from the elements read so far
+	int i = ParseInt(index);
+	i = i < 0 ? (int)count + i : i - 1;
+	return i >= 0 && i < (int)elements.size() ? elements[i] : T();
+}
+
+// -----------------------------------------------------
+// First pass, every chunk on its own: positions, uvs
+// and normals
+// -----------------------------------------------------
+static void ParseAttributes(ObjChunk& chunk)
+{
+	ObjText line;
+	ObjText parts[3];
+	for (const char* position = chunk.begin; position < chunk.end;)
+	{
+		position = NextLine(position, chunk.end, line);
+		ObjText token = FirstToken(line);
+		if (token.Is("v") || token.Is("vn"))
+		{
+			int count = Split(Tail(line), ' ', parts, 3);
+			objl::Vector3 value;
+			if (count > 0) value.X = ObjParser::ParseFloat(parts[0].begin, parts[0].end);
+			if (count > 1) value.Y = ObjParser::ParseFloat(parts[1].begin, parts[1].end);
+			if (count > 2) value.Z = ObjParser::ParseFloat(parts[2].begin, parts[2].end);
+			if (token.Is("v"))
+				chunk.positions.push_back(value);
+			else
+				chunk.normals.push_back(value);
+		}
+		else if (token.Is("vt"))
+		{
+			int count = Split(Tail(line), ' ', parts, 2);
+			objl::Vector2 value;
+			if (count > 0) value.X = ObjParser::ParseFloat(parts[0].begin, parts[0].end);
+			if (count > 1) value.Y = ObjParser::ParseFloat(parts[1].begin, parts[1].end);
+			chunk.texCoords.push_back(value);
+		}
+	}
+}
+
+// -----------------------------------------------------
+// Second pass, once every chunk's attributes are in
+// place: faces, plus the lines that start new meshes,
+// which are left for the merge to act on
+// -----------------------------------------------------
+static void ParseFaces(ObjChunk& chunk, const std::vector<objl::Vector3>& positions, const std::vector<objl::Vector2>& texCoords, const std::vector<objl::Vector3>& normals)
+{
+	objl::Loader triangulator;
+	std::vector<objl::Vertex> faceVertices;
+	std::vector<unsigned int> faceIndices;
+	size_t positionCount = chunk.positionBase;
+	size_t texCoordCount = chunk.texCoordBase;
+	size_t normalCount = chunk.normalBase;
+
+	ObjText line;
+	for (const char* position = chunk.begin; position < chunk.end;)
+	{
+		position = NextLine(position, chunk.end, line);
+		ObjText token = FirstToken(line);
+
+		bool named = token.Is("o") || token.Is("g");
+		if (named || (line.begin < line.end && line.begin[0] == 'g'))
+		{
+			chunk.events.push_back({ ObjEvent::Group, named, Tail(line).ToString(), chunk.vertices.size(), chunk.indices.size() });
+			continue;
+		}
+
+		if (token.Is("v"))
+			positionCount++;
+		else if (token.Is("vt"))
+			texCoordCount++;
+		else if (token.Is("vn"))
+			normalCount++;
+		else if (token.Is("usemtl"))
+			chunk.events.push_back({ ObjEvent::UseMaterial, false, Tail(line).ToString(), chunk.vertices.size(), chunk.indices.size() });
+		else if (token.Is("mtllib"))
+			chunk.events.push_back({ ObjEvent::MaterialLibrary, false, Tail(line).ToString(), chunk.vertices.size(), chunk.indices.size() });
+		else if (token.Is("f"))
+		{
+			// objl::Loader::GenVerticesFromRawOBJ
+			faceVertices.clear();
+			objl::Vertex vertex;
+			bool noNormal = false;
+			ObjText tail = Tail(line);
+			ObjText parts[OBJ_PARSER_MAX_VERTEX_PARTS];
+			const char* piece = tail.begin;
+			for (const char* c = tail.begin; c <= tail.end; c++)
+			{
+				bool pieceEnds = c == tail.end || *c == ' ';
+				if (!pieceEnds)
+					continue;
+				// Split drops the last piece only when it's empty
+				if (c == tail.end && piece == c)
+					break;
+				ObjText cornerText = { piece, c };
+				piece = c + 1;
+
+				int count = Split(cornerText, '/', parts, OBJ_PARSER_MAX_VERTEX_PARTS);
+				int type = 0;
+				if (count == 1) type = 1;
+				if (count == 2) type = 2;
+				if (count == 3) type = parts[1].Empty() ? 3 : 4;
+
+				switch (type)
+				{
+				case 1: // P
+					vertex.Position = GetElement(positions, positionCount, parts[0]);
+					vertex.TextureCoordinate = objl::Vector2(0, 0);
+					noNormal = true;
+					faceVertices.push_back(vertex);
+					break;
+				case 2: // P/T
+					vertex.Position = GetElement(positions, positionCount, parts[0]);
+					vertex.TextureCoordinate = GetElement(texCoords, texCoordCount, parts[1]);
+					noNormal = true;
+					faceVertices.push_back(vertex);
+					break;
+				case 3: // P//N
+					vertex.Position = GetElement(positions, positionCount, parts[0]);
+					vertex.TextureCoordinate = objl::Vector2(0, 0);
+					vertex.Normal = GetElement(normals, normalCount, parts[2]);
+					faceVertices.push_back(vertex);
+					break;
+				case 4: // P/T/N
+					vertex.Position = GetElement(positions, positionCount, parts[0]);
+					vertex.TextureCoordinate = GetElement(texCoords, texCoordCount, parts[1]);
+					vertex.Normal = GetElement(normals, normalCount, parts[2]);
+					faceVertices.push_back(vertex);
+					break;
+				default:
+					break;
+				}
+			}
+
+			if (noNormal && faceVertices.size() >= 3)
+			{
+				objl::Vector3 a = faceVertices[0].Position - faceVertices[1].Position;
+				objl::Vector3 b = faceVertices[2].Position - faceVertices[1].Position;
+				objl::Vector3 normal = objl::math::CrossV3(a, b);
+				for (auto& faceVertex : faceVertices)
+					faceVertex.Normal = normal;
+			}
+
+			unsigned int first = (unsigned int)chunk.vertices.size();
+			chunk.vertices.insert(chunk.vertices.end(), faceVertices.begin(), faceVertices.end());
+			if (faceVertices.size() == 3)
+			{
+				chunk.indices.push_back(first);
+				chunk.indices.push_back(first + 1);
+				chunk.indices.push_back(first + 2);
+			}
+			else if (faceVertices.size() > 3)
+			{
+				faceIndices.clear();
+				triangulator.VertexTriangluation(faceIndices, faceVertices);
+				for (unsigned int index : faceIndices)
+					chunk.indices.push_back(first + index);
+			}
+		}
+	}
+}
+
+// Where objl looks for a material library named in the OBJ
+static std::string MaterialPath(const std::string& objPath, const std::string& library)
+{
+	std::vector<ObjText> parts(objPath.size() + 1);
+	ObjText path = { objPath.data(), objPath.data() + objPath.size() };
+	int count = Split(path, '/', parts.data(), (int)parts.size());
+
+	std::string materialPath;
+	if (count != 1)
+	{
+		for (int i = 0; i < count - 1; i++)
+			materialPath += parts[i].ToString() + "/";
+	}
+	return materialPath + library;
+}
+
+// objl reads the library a line at a time, so a CRLF one leaves
+// the CR on every name. Dropped here as the OBJ's own CRs are.
+static void TrimCR(std::string& text)
+{
+	if (!text.empty() && text.back() == '\r')
+		text.pop_back();
+}
+
+static void TrimCR(objl::Material& material)
+{
+	for (std::string* text : { &material.name, &material.map_Ka, &material.map_Kd, &material.map_Ks, &material.map_Ns, &material.map_d, &material.map_bump })
+		TrimCR(*text);
+}
+
+// -----------------------------------------------------
+// Chunks are cut at line ends so no line is split.
+// Faces can refer to attributes anywhere before them,
+// so all attributes are read before any face. The
+// chunks' meshes are stitched together in file order,
+// replaying objl's rules for starting a new mesh.
+// -----------------------------------------------------
+bool ObjParser::LoadFile(const std::string & path, JobSystem * jobs)
+{
+	LoadedMeshes.clear();
+	LoadedMaterials.clear();
+
+	if (path.size() < 4 || path.substr(path.size() - 4, 4) != ".obj")
+		return false;
+
+	MappedFile file;
+	if (!file.Open(path))
+		return false;
+
+	const char* text = (const char*)file.GetData();
+	size_t size = file.GetSize();
+
+	size_t chunkCount = 1;
+	if (jobs)
+		chunkCount = (std::max)((size_t)1, (std::min)((size_t)(jobs->GetWorkerCount() + 1) * 4, size / OBJ_PARSER_MIN_CHUNK_SIZE));
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* chunkStart = text;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = text + size * (i + 1) / chunkCount;
+		if (i + 1 < chunkCount)
+		{
+			const char* newline = chunkEnd > chunkStart ? (const char*)memchr(chunkEnd - 1, '\n', text + size - (chunkEnd - 1)) : nullptr;
+			chunkEnd = newline ? newline + 1 : text + size;
+		}
+		else
+			chunkEnd = text + size;
+		chunks[i].begin = chunkStart;
+		chunks[i].end = (std::max)(chunkStart, chunkEnd);
+		chunkStart = chunks[i].end;
+	}
+
+	auto parseAttributes = [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			ParseAttributes(chunks[i]);
+	};
+	if (jobs && chunkCount > 1)
+		jobs->ParallelFor((int)chunkCount, 1, parseAttributes);
+	else
+		parseAttributes(0, (int)chunkCount);
+
+	std::vector<objl::Vector3> positions;
+	std::vector<objl::Vector2> texCoords;
+	std::vector<objl::Vector3> normals;
+	if (chunkCount == 1)
+	{
+		positions.swap(chunks[0].positions);
+		texCoords.swap(chunks[0].texCoords);
+		normals.swap(chunks[0].normals);
+		chunks[0].positionBase = chunks[0].texCoordBase = chunks[0].normalBase = 0;
+	}
+	else
+	{
+		for (auto& chunk : chunks)
+		{
+			chunk.positionBase = positions.size();
+			chunk.texCoordBase = texCoords.size();
+			chunk.normalBase = normals.size();
+			positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+			texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+			normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+			std::vector<objl::Vector3>().swap(chunk.positions);
+			std::vector<objl::Vector2>().swap(chunk.texCoords);
+			std::vector<objl::Vector3>().swap(chunk.normals);
+		}
+	}
+
+	auto parseFaces = [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			ParseFaces(chunks[i], positions, texCoords, normals);
+	};
+	if (jobs && chunkCount > 1)
+		jobs->ParallelFor((int)chunkCount, 1, parseFaces);
+	else
+		parseFaces(0, (int)chunkCount);
+
+	// The rest follows objl::Loader::LoadFile line for line
+	objl::Loader materials;
+	std::vector<std::string> meshMaterialNames;
+	std::vector<objl::Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::string meshName;
+	bool listening = false;
+	size_t totalVertices = 0;
+
+	auto finishMesh = [&](const std::string& name)
+	{
+		LoadedMeshes.emplace_back();
+		LoadedMeshes.back().MeshName = name;
+		LoadedMeshes.back().Vertices.swap(vertices);
+		LoadedMeshes.back().Indices.swap(indices);
+	};
+	auto append = [&](const ObjChunk& chunk, size_t vertexBegin, size_t vertexEnd, size_t indexBegin, size_t indexEnd)
+	{
+		unsigned int offset = (unsigned int)vertices.size() - (unsigned int)vertexBegin;
+		vertices.insert(vertices.end(), chunk.vertices.begin() + vertexBegin, chunk.vertices.begin() + vertexEnd);
+		for (size_t i = indexBegin; i < indexEnd; i++)
+			indices.push_back(chunk.indices[i] + offset);
+		totalVertices += vertexEnd - vertexBegin;
+	};
+
+	for (auto& chunk : chunks)
+	{
+		size_t vertexCursor = 0;
+		size_t indexCursor = 0;
+		for (auto& event : chunk.events)
+		{
+			append(chunk, vertexCursor, event.vertexMark, indexCursor, event.indexMark);
+			vertexCursor = event.vertexMark;
+			indexCursor = event.indexMark;
+
+			bool hasMesh = !indices.empty() && !vertices.empty();
+			switch (event.type)
+			{
+			case ObjEvent::Group:
+				if (!listening)
+				{
+					listening = true;
+					meshName = event.named ? event.text : "unnamed";
+				}
+				else if (hasMesh)
+				{
+					finishMesh(meshName);
+					meshName = event.text;
+				}
+				else
+					meshName = event.named ? event.text : "unnamed";
+				break;
+			case ObjEvent::UseMaterial:
+				meshMaterialNames.push_back(event.text);
+				if (hasMesh)
+					finishMesh(meshName + "_2");
+				break;
+			case ObjEvent::MaterialLibrary:
+				materials.LoadMaterials(MaterialPath(path, event.text));
+				for (auto& material : materials.LoadedMaterials)
+					TrimCR(material);
+				break;
+			}
+		}
+		append(chunk, vertexCursor, chunk.vertices.size(), indexCursor, chunk.indices.size());
+	}
+
+	if (!indices.empty() && !vertices.empty())
+		finishMesh(meshName);
+
+	for (size_t i = 0; i < meshMaterialNames.size() && i < LoadedMeshes.size(); i++)
+	{
+		for (auto& material : materials.LoadedMaterials)
+		{
+			if (material.name == meshMaterialNames[i])
+			{
+				LoadedMeshes[i].MeshMaterial = material;
+				break;
+			}
+		}
+	}
+	LoadedMaterials = materials.LoadedMaterials;
+
+	return !LoadedMeshes.empty() || totalVertices > 0;
+}
+
+bool ObjParser::SameMeshes(const std::vector<objl::Mesh>& a, const std::vector<objl::Mesh>& b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].MeshName != b[i].MeshName || a[i].MeshMaterial.name != b[i].MeshMaterial.name || a[i].MeshMaterial.map_Kd != b[i].MeshMaterial.map_Kd ||
+			a[i].Vertices.size() != b[i].Vertices.size() || a[i].Indices != b[i].Indices)
+			return false;
+		if (!a[i].Vertices.empty() && memcmp(a[i].Vertices.data(), b[i].Vertices.data(), a[i].Vertices.size() * sizeof(objl::Vertex)) != 0)
+			return false;
+	}
+	return true;
+}
+
+// The benchmark's grid goes in the temp folder, where it does no harm
+// if the benchmark dies before deleting it
+static std::string GetTempFilePath(const char* name)
+{
+#ifdef _WIN32
+	char folder[MAX_PATH];
+	DWORD length = GetTempPathA(MAX_PATH, folder);
+	if (length > 0 && length < MAX_PATH)
+		return std::string(folder) + name;
+	return name;
+#else
+	return std::string("/tmp/") + name;
+#endif
+}
+
+// -----------------------------------------------------
+// A wavy grid, written the way exporters usually do:
+// six decimals and full v/vt/vn faces
+// -----------------------------------------------------
+bool ObjParser::Benchmark(int triangleCount, int iterations, JobSystem * jobs)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	int side = 1;
+	while (2 * side * side < triangleCount)
+		side++;
+	int row = side + 1;
+
+	std::string path = GetTempFilePath("objParserBenchmark.obj");
+	{
+		std::ofstream output(path, std::ios::binary);
+		char line[160];
+		for (int z = 0; z < row; z++)
+		{
+			for (int x = 0; x < row; x++)
+			{
+				float y = 0.25f * sinf(x * 0.37f) * cosf(z * 0.21f);
+				output.write(line, snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", x * 0.5f, y, -z * 0.5f));
+				output.write(line, snprintf(line, sizeof(line), "vt %.6f %.6f\n", (float)x / side, (float)z / side));
+				output.write(line, snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", -y * 0.3f, 0.953939f, y * 0.1f));
+			}
+		}
+		for (int z = 0; z < side; z++)
+		{
+			for (int x = 0; x < side; x++)
+			{
+				int a = z * row + x + 1, b = a + 1, c = a + row, d = c + 1;
+				output.write(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, b, b, b));
+				output.write(line, snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d\n", b, b, b, c, c, c, d, d, d));
+			}
+		}
+	}
+
+	MappedFile file;
+	double megabytes = file.Open(path) ? file.GetSize() / (1024.0 * 1024.0) : 0;
+	file.Close();
+
+	auto start = Clock::now();
+	objl::Loader loader;
+	loader.LoadFile(path);
+	double objlMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	ObjParser parser;
+	start = Clock::now();
+	for (int i = 0; i < iterations; i++)
+		parser.LoadFile(path);
+	double singleMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+	bool singleSame = SameMeshes(loader.LoadedMeshes, parser.LoadedMeshes);
+
+	start = Clock::now();
+	for (int i = 0; i < iterations; i++)
+		parser.LoadFile(path, jobs);
+	double jobsMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+	bool jobsSame = SameMeshes(loader.LoadedMeshes, parser.LoadedMeshes);
+
+	remove(path.c_str());
+
+	printf("\nOBJ parsing (%d triangles, %.1f MB): objl %.1f ms, parser %.1f ms (%.0f MB/s), on jobs %.1f ms (%.0f MB/s)",
+		2 * side * side, megabytes, objlMs,
+		singleMs, megabytes / (singleMs / 1000.0),
+		jobsMs, megabytes / (jobsMs / 1000.0));
+	return singleSame && jobsSame;
+}
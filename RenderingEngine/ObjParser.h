@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ObjLoader.h"
+
+class JobSystem;
+
+//------------------------------------------------
+// Reads an OBJ into exactly the meshes and
+// materials objl::Loader::LoadFile gives, but
+// straight off the mapped file: one pass, no
+// strings per line and no stof. Big files are
+// split into chunks when given a job system.
+// CRLF files read as if they were LF, where objl
+// keeps the CR in names and loses the materials.
+//------------------------------------------------
+class ObjParser
+{
+public:
+	bool LoadFile(const std::string& path, JobSystem* jobs = nullptr);
+
+	std::vector<objl::Mesh> LoadedMeshes;
+	std::vector<objl::Material> LoadedMaterials;
+
+	// Same result as std::stof on the start of the text. Plain decimals
+	// are parsed here, anything unusual goes through strtof.
+	static float ParseFloat(const char* begin, const char* end);
+
+	// True if both hold the same meshes, with the same names and
+	// materials and byte for byte the same vertices and indices
+	static bool SameMeshes(const std::vector<objl::Mesh>& a, const std::vector<objl::Mesh>& b);
+
+	// Writes a grid of triangleCount triangles to a temporary OBJ, then
+	// times objl against this parser on one thread and on the job
+	// system. False if the three didn't read the same meshes.
+	static bool Benchmark(int triangleCount, int iterations, JobSystem* jobs);
+};
@@ -39,13 +39,19 @@ struct RippleData {
 	float rippleRadius;
 };
 
-cbuffer externalData : register(b0)
+// Filled in once a frame by the renderer and shared by
+// every lit shader
+cbuffer lightData : register(b2)
 {
 	DirectionalLight dirLights[MAX_LIGHTS];
-	PointLight pointLights[MAX_LIGHTS];	
+	PointLight pointLights[MAX_LIGHTS];
 	int DirectionalLightCount;
 	int PointLightCount;
 	float3 cameraPosition;
+}
+
+cbuffer externalData : register(b0)
+{
 	float translate;
 	RippleData ripples[MAX_RIPPLES];
 	int rippleCount;
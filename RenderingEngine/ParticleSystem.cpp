@@ -0,0 +1,362 @@
+#include "ParticleSystem.h"
+#include <malloc.h>
+#include <algorithm>
+#include <chrono>
+
+using namespace DirectX;
+
+// Below this many living particles a job costs more than it saves
+const int PARALLEL_PARTICLE_COUNT = 4096;
+
+// -----------------------------------------------------
+// Allocate the pool and the shared buffers up front
+// -----------------------------------------------------
+ParticleSystem::ParticleSystem(ID3D11Device* device, SimpleVertexShader* vs, SimplePixelShader* ps, int maxParticles, int maxEmitters, uint64_t seed)
+{
+	this->vs = vs;
+	this->ps = ps;
+	this->maxParticles = maxParticles;
+	this->jobs = nullptr;
+	random.Seed(seed);
+
+	// Make the particle arrays, all in one aligned block
+	const int arrayCount = sizeof(ParticleArrays) / sizeof(float*);
+	paddedParticles = (maxParticles + 3) & ~3;
+	particleMemory = (float*)_aligned_malloc(sizeof(float) * paddedParticles * arrayCount, 16);
+	memset(particleMemory, 0, sizeof(float) * paddedParticles * arrayCount);
+
+	float** arrays = reinterpret_cast<float**>(&particles);
+	for (int i = 0; i < arrayCount; i++)
+		arrays[i] = particleMemory + i * paddedParticles;
+
+	// Emitter slots, all free to start with. The free range list can
+	// never be longer than one more than the number of emitters.
+	emitters.resize(maxEmitters);
+	activeEmitters.reserve(maxEmitters);
+	freeEmitters.reserve(maxEmitters);
+	for (int i = maxEmitters - 1; i >= 0; i--)
+		freeEmitters.push_back(i);
+
+	freeRanges.reserve(maxEmitters + 1);
+	freeRanges.push_back(ParticleRange{ 0, paddedParticles });
+
+	batches.reserve(maxEmitters);
+
+	instanceBuffer = nullptr;
+	indexBuffer = nullptr;
+	viewHandle = SIMPLE_SHADER_INVALID_HANDLE;
+	projectionHandle = SIMPLE_SHADER_INVALID_HANDLE;
+	particleHandle = SIMPLE_SHADER_INVALID_HANDLE;
+
+	// No device means simulation only (used for benchmarking)
+	if (device == nullptr)
+		return;
+
+	viewHandle = vs->GetVariableHandle("view");
+	projectionHandle = vs->GetVariableHandle("projection");
+	particleHandle = ps->GetShaderResourceViewHandle("particle");
+
+	// DYNAMIC instance buffer (no initial data necessary)
+	D3D11_BUFFER_DESC vbDesc = {};
+	vbDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	vbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	vbDesc.Usage = D3D11_USAGE_DYNAMIC;
+	vbDesc.ByteWidth = sizeof(ParticleInstance) * paddedParticles;
+	device->CreateBuffer(&vbDesc, 0, &instanceBuffer);
+
+	// One quad, the vertex shader builds the corners from these ids
+	unsigned int indices[] = { 0, 1, 2, 0, 2, 3 };
+	D3D11_SUBRESOURCE_DATA indexData = {};
+	indexData.pSysMem = indices;
+
+	D3D11_BUFFER_DESC ibDesc = {};
+	ibDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	ibDesc.CPUAccessFlags = 0;
+	ibDesc.Usage = D3D11_USAGE_IMMUTABLE;
+	ibDesc.ByteWidth = sizeof(indices);
+	device->CreateBuffer(&ibDesc, &indexData, &indexBuffer);
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	_aligned_free(particleMemory);
+	if (instanceBuffer) instanceBuffer->Release();
+	if (indexBuffer) indexBuffer->Release();
+}
+
+// -----------------------------------------------------
+// Grab a free emitter slot and enough particles for it
+// -----------------------------------------------------
+Emitter* ParticleSystem::CreateEmitter(
+	int maxParticles,
+	int particlesPerSecond,
+	float lifetime,
+	float startSize,
+	float endSize,
+	DirectX::XMFLOAT4 startColor,
+	DirectX::XMFLOAT4 endColor,
+	DirectX::XMFLOAT3 startVelocity,
+	DirectX::XMFLOAT3 emitterAcceleration,
+	ID3D11ShaderResourceView* texture,
+	DirectX::XMFLOAT3 emitterPosition,
+	bool loop)
+{
+	if (freeEmitters.empty())
+		return nullptr;
+
+	int start;
+	if (!AllocateRange(maxParticles, start))
+		return nullptr;
+
+	int index = freeEmitters.back();
+	freeEmitters.pop_back();
+	activeEmitters.push_back(index);
+
+	ParticleArrays range = particles;
+	float** arrays = reinterpret_cast<float**>(&range);
+	for (int i = 0; i < (int)(sizeof(ParticleArrays) / sizeof(float*)); i++)
+		arrays[i] += start;
+
+	emitters[index].Initialize(maxParticles, particlesPerSecond, lifetime, startSize, endSize,
+		startColor, endColor, startVelocity, emitterAcceleration, texture, emitterPosition, loop,
+		range, start, random.Split());
+	return &emitters[index];
+}
+
+// -----------------------------------------------------
+// First fit. Ranges are kept a multiple of 4 so every
+// emitter's arrays start 16 byte aligned.
+// -----------------------------------------------------
+bool ParticleSystem::AllocateRange(int count, int& start)
+{
+	count = (count + 3) & ~3;
+	for (size_t i = 0; i < freeRanges.size(); i++)
+	{
+		if (freeRanges[i].count < count)
+			continue;
+
+		start = freeRanges[i].start;
+		freeRanges[i].start += count;
+		freeRanges[i].count -= count;
+		if (freeRanges[i].count == 0)
+			freeRanges.erase(freeRanges.begin() + i);
+		return true;
+	}
+	return false;
+}
+
+// -----------------------------------------------------
+// Put a range back, merging it with its neighbours
+// -----------------------------------------------------
+void ParticleSystem::FreeRange(int start, int count)
+{
+	count = (count + 3) & ~3;
+
+	size_t i = 0;
+	while (i < freeRanges.size() && freeRanges[i].start < start)
+		i++;
+
+	bool joinsPrevious = i > 0 && freeRanges[i - 1].start + freeRanges[i - 1].count == start;
+	bool joinsNext = i < freeRanges.size() && start + count == freeRanges[i].start;
+
+	if (joinsPrevious && joinsNext)
+	{
+		freeRanges[i - 1].count += count + freeRanges[i].count;
+		freeRanges.erase(freeRanges.begin() + i);
+	}
+	else if (joinsPrevious)
+	{
+		freeRanges[i - 1].count += count;
+	}
+	else if (joinsNext)
+	{
+		freeRanges[i].start = start;
+		freeRanges[i].count += count;
+	}
+	else
+	{
+		freeRanges.insert(freeRanges.begin() + i, ParticleRange{ start, count });
+	}
+}
+
+void ParticleSystem::SetJobSystem(JobSystem* jobs)
+{
+	this->jobs = jobs;
+}
+
+// -----------------------------------------------------
+// Update every emitter and recycle the finished ones.
+// Emitters own separate ranges of the pool and their
+// own random stream, so they can run side by side.
+// -----------------------------------------------------
+void ParticleSystem::Update(float dt)
+{
+	int livingParticles = 0;
+	for (int index : activeEmitters)
+		livingParticles += emitters[index].GetLivingParticleCount();
+
+	auto updateEmitters = [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+			emitters[activeEmitters[i]].Update(dt);
+	};
+
+	if (jobs != nullptr && livingParticles >= PARALLEL_PARTICLE_COUNT)
+		jobs->ParallelFor((int)activeEmitters.size(), 1, updateEmitters);
+	else
+		updateEmitters(0, (int)activeEmitters.size());
+
+	for (size_t i = 0; i < activeEmitters.size(); )
+	{
+		Emitter& emitter = emitters[activeEmitters[i]];
+		if (!emitter.doneEmit)
+		{
+			i++;
+			continue;
+		}
+
+		FreeRange(emitter.GetFirstParticle(), emitter.GetMaxParticles());
+		freeEmitters.push_back(activeEmitters[i]);
+		activeEmitters[i] = activeEmitters.back();
+		activeEmitters.pop_back();
+	}
+}
+
+int ParticleSystem::GetActiveEmitterCount() const
+{
+	return (int)activeEmitters.size();
+}
+
+// -----------------------------------------------------
+// Emitters are packed back to back, so only living
+// particles are written. Neighbours with the same
+// texture end up in the same batch.
+// -----------------------------------------------------
+int ParticleSystem::PackParticles(ParticleInstance* instances)
+{
+	batches.clear();
+
+	int total = 0;
+	for (int index : activeEmitters)
+	{
+		const Emitter& emitter = emitters[index];
+		int count = emitter.PackParticles(instances + total);
+		if (count == 0)
+			continue;
+
+		if (!batches.empty() && batches.back().texture == emitter.GetTexture())
+			batches.back().count += count;
+		else
+			batches.push_back(ParticleBatch{ emitter.GetTexture(), total, count });
+
+		total += count;
+	}
+	return total;
+}
+
+// -----------------------------------------------------
+// One map for every emitter, returns the instance count
+// -----------------------------------------------------
+int ParticleSystem::CopyParticlesToGPU(ID3D11DeviceContext* context)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped = {};
+	context->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+	int count = PackParticles((ParticleInstance*)mapped.pData);
+	context->Unmap(instanceBuffer, 0);
+	return count;
+}
+
+void ParticleSystem::Draw(ID3D11DeviceContext* context, Camera* camera)
+{
+	int livingParticles = 0;
+	for (int index : activeEmitters)
+		livingParticles += emitters[index].GetLivingParticleCount();
+
+	if (livingParticles == 0)
+		return;
+
+	// Copy to dynamic buffer
+	CopyParticlesToGPU(context);
+
+	// Instances go in slot 1, nothing is read per vertex
+	commandList.Reset();
+	commandList.SetVertexBuffer(1, instanceBuffer, sizeof(ParticleInstance));
+	commandList.SetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT);
+	commandList.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	vs->SetCommandList(&commandList);
+	ps->SetCommandList(&commandList);
+
+	vs->SetMatrix4x4(viewHandle, camera->GetViewMatrix());
+	vs->SetMatrix4x4(projectionHandle, camera->GetProjectionMatrix());
+	vs->SetShader();
+	vs->CopyAllBufferData();
+
+	ps->SetShader();
+
+	for (const ParticleBatch& batch : batches)
+	{
+		ps->SetShaderResourceView(particleHandle, batch.texture);
+		ps->CopyAllBufferData();
+		commandList.DrawIndexedInstanced(6, batch.count, 0, 0, batch.start);
+	}
+
+	vs->SetCommandList(nullptr);
+	ps->SetCommandList(nullptr);
+
+	D3D11CommandBackend backend(context);
+	commandList.Execute(backend);
+}
+
+// -----------------------------------------------------
+// Fills looping emitters with particles that never
+// die and times the update with more and more
+// threads. Needs no device.
+// -----------------------------------------------------
+void ParticleSystem::Benchmark(int particleCount, int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const int emitterCount = 64;
+	const int emitterParticles = (particleCount / emitterCount) & ~3;
+	particleCount = emitterParticles * emitterCount;
+
+	ParticleInstance* instances = new ParticleInstance[particleCount];
+	unsigned int hardwareThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+	double singleThreadMs = 0.0;
+
+	for (unsigned int threadCount = 1; threadCount <= hardwareThreads; threadCount++)
+	{
+		JobSystem jobs(threadCount - 1);
+		ParticleSystem system(nullptr, nullptr, nullptr, particleCount, emitterCount);
+		system.SetJobSystem(&jobs);
+		for (int i = 0; i < emitterCount; i++)
+		{
+			Emitter* emitter = system.CreateEmitter(emitterParticles, 1, 1000.0f, 0.7f, 0.1f,
+				XMFLOAT4(0.9f, 0.9f, 1.0f, 0.5f), XMFLOAT4(1, 1, 1, 0),
+				XMFLOAT3(0, 7.2f, 0), XMFLOAT3(0, -50, 0),
+				nullptr, XMFLOAT3(0, 0, 0), true);
+			emitter->SpawnParticles(emitterParticles);
+		}
+
+		auto start = Clock::now();
+		for (int i = 0; i < iterations; i++)
+			system.Update(1.0f / 60.0f);
+		auto updateEnd = Clock::now();
+
+		double updateMs = std::chrono::duration<double, std::milli>(updateEnd - start).count() / iterations;
+		if (threadCount == 1)
+		{
+			singleThreadMs = updateMs;
+
+			// Packing runs on one thread, so it is only timed once
+			int packed = 0;
+			for (int i = 0; i < iterations; i++)
+				packed = system.PackParticles(instances);
+			double packMs = std::chrono::duration<double, std::milli>(Clock::now() - updateEnd).count() / iterations;
+			printf("\nParticles (%d in %d emitters): %.3f ms to pack %d instances (%d KB)",
+				particleCount, emitterCount, packMs, packed, (int)(packed * sizeof(ParticleInstance) / 1024));
+		}
+		printf("\n  %2u threads: %.3f ms per update, %.2fx", threadCount, updateMs, singleThreadMs / updateMs);
+	}
+
+	delete[] instances;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <d3d11.h>
+#include <DirectXMath.h>
+
+#include "Camera.h"
+#include "SimpleShader.h"
+#include "Emitter.h"
+#include "JobSystem.h"
+#include "D3D11CommandBackend.h"
+
+//------------------------------------------------
+// A contiguous run of particles in the pool
+//------------------------------------------------
+struct ParticleRange
+{
+	int start;
+	int count;
+};
+
+//------------------------------------------------
+// Living instances that share a texture and are
+// drawn with one call
+//------------------------------------------------
+struct ParticleBatch
+{
+	ID3D11ShaderResourceView* texture;
+	int start;
+	int count;
+};
+
+//------------------------------------------------
+// Owns every particle in the game. All emitters
+// borrow a range of one pooled set of particle
+// arrays and draw from one shared instance
+// buffer. Emitters are recycled once they
+// are done, so spawning an effect never touches
+// the heap or the device.
+//------------------------------------------------
+class ParticleSystem
+{
+public:
+	ParticleSystem(ID3D11Device* device, SimpleVertexShader* vs, SimplePixelShader* ps, int maxParticles, int maxEmitters, uint64_t seed = 0);
+	~ParticleSystem();
+
+	// Returns nullptr if the pool is out of emitters or particles.
+	// The emitter is only valid until it is done emitting.
+	Emitter* CreateEmitter(
+		int maxParticles,
+		int particlesPerSecond,
+		float lifetime,
+		float startSize,
+		float endSize,
+		DirectX::XMFLOAT4 startColor,
+		DirectX::XMFLOAT4 endColor,
+		DirectX::XMFLOAT3 startVelocity,
+		DirectX::XMFLOAT3 emitterAcceleration,
+		ID3D11ShaderResourceView* texture,
+		DirectX::XMFLOAT3 emitterPosition = DirectX::XMFLOAT3(0, 0, 0),
+		bool loop = false
+		);
+
+	// Emitters are updated side by side once there are enough particles
+	void SetJobSystem(JobSystem* jobs);
+	void Update(float dt);
+	void Draw(ID3D11DeviceContext* context, Camera* camera);
+	int GetActiveEmitterCount() const;
+
+	// Packs every living particle into instances (room for maxParticles)
+	// and groups them into batches. Returns the number of instances.
+	int PackParticles(ParticleInstance* instances);
+
+	// Times Update and packing on a device-less system kept full of
+	// particles, once for every thread count up to the core count
+	static void Benchmark(int particleCount, int iterations);
+private:
+	int maxParticles;
+	int paddedParticles;
+	float* particleMemory;
+	ParticleArrays particles;
+
+	std::vector<Emitter> emitters;
+	std::vector<int> freeEmitters;
+	std::vector<int> activeEmitters;
+	std::vector<ParticleRange> freeRanges;	// sorted by start
+	std::vector<ParticleBatch> batches;
+
+	// Each new emitter gets the next stream from this
+	Random random;
+	JobSystem* jobs;
+
+	// Rendering
+	ID3D11Buffer* instanceBuffer;
+	ID3D11Buffer* indexBuffer;
+	SimpleVertexShader* vs;
+	SimplePixelShader* ps;
+	int viewHandle;
+	int projectionHandle;
+	int particleHandle;
+	CommandList commandList;
+
+	bool AllocateRange(int count, int& start);
+	void FreeRange(int start, int count);
+	int CopyParticlesToGPU(ID3D11DeviceContext* context);
+};
+
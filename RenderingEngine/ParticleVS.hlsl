@@ -6,13 +6,14 @@ cbuffer externalData : register(b0)
 	matrix projection;
 };
 
-// Describes individual vertex data
+// One of these per particle, the quad corners
+// come from the vertex id
 struct VertexShaderInput
 {
-	float3 position		: POSITION;
-	float2 uv			: TEXCOORD;
-	float4 color		: COLOR;
-	float size : SIZE;
+	float3 position		: POSITION_PER_INSTANCE;
+	float size			: SIZE_PER_INSTANCE;
+	float4 color		: COLOR_PER_INSTANCE;
+	uint id				: SV_VertexID;
 };
 
 // Defines the output data of our vertex shader
@@ -33,15 +34,20 @@ VertexToPixel main(VertexShaderInput input)
 	matrix viewProj = mul(view, projection);
 	output.position = mul(float4(input.position, 1.0f), viewProj);
 
+	// Corners 0-3 go (0,0) (1,0) (1,1) (0,1)
+	float2 uv = float2(
+		(input.id == 1 || input.id == 2) ? 1.0f : 0.0f,
+		input.id >= 2 ? 1.0f : 0.0f);
+
 	// Use UV to offset position (billboarding)
-	float2 offset = input.uv * 2 - 1;
+	float2 offset = uv * 2 - 1;
 	offset *= input.size;
 	offset.y *= -1;
 	output.position.xy += offset;
 
 	// Pass uv through
-	output.uv = input.uv;
+	output.uv = uv;
 	output.color = input.color;
 
 	return output;
-}
\ No newline at end of file
+}
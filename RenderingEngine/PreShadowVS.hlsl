@@ -1,11 +1,15 @@
 // Constant Buffer for external (C++) data
-cbuffer externalData : register(b0)
+cbuffer perFrame : register(b0)
 {
-	matrix world;
 	matrix view;
 	matrix projection;
 };
 
+cbuffer perObject : register(b1)
+{
+	matrix world;
+};
+
 // Struct representing a single vertex worth of data
 struct VertexShaderInput
 {
@@ -19,6 +19,7 @@ void ProjectileEntity::Update(float deltaTime, float totalTime)
 		auto dir = XMLoadFloat3(&shotDirection);
 		pos = pos + dir * speed;
 		XMStoreFloat3(&position, pos);
+		TransformChanged();
 	}
 	else
 	{
@@ -49,6 +50,7 @@ void ProjectileEntity::Update(float deltaTime, float totalTime)
 		}
 
 		XMStoreFloat3(&position, pos);
+		TransformChanged();
 	}
 }
 
@@ -0,0 +1,74 @@
+#include "Random.h"
+
+Random::Random(uint64_t seed)
+{
+	Seed(seed);
+}
+
+// -----------------------------------------------------
+// Expand the seed with splitmix64, which never leaves
+// the state all zero
+// -----------------------------------------------------
+void Random::Seed(uint64_t seed)
+{
+	for (int i = 0; i < 4; i += 2)
+	{
+		uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		z = z ^ (z >> 31);
+
+		state[i] = (uint32_t)z;
+		state[i + 1] = (uint32_t)(z >> 32);
+	}
+}
+
+void Random::Jump()
+{
+	static const uint32_t JUMP[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+
+	uint32_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int b = 0; b < 32; b++)
+		{
+			if (JUMP[i] & (1u << b))
+			{
+				s0 ^= state[0];
+				s1 ^= state[1];
+				s2 ^= state[2];
+				s3 ^= state[3];
+			}
+			NextUInt();
+		}
+	}
+
+	state[0] = s0;
+	state[1] = s1;
+	state[2] = s2;
+	state[3] = s3;
+}
+
+// -----------------------------------------------------
+// Hand out the current stream and move on to the next
+// -----------------------------------------------------
+Random Random::Split()
+{
+	Random stream = *this;
+	Jump();
+	return stream;
+}
+
+void Random::Fill(float* values, int count, float min, float max)
+{
+	float scale = (max - min) * (1.0f / 16777216.0f);
+	for (int i = 0; i < count; i++)
+		values[i] = min + (NextUInt() >> 8) * scale;
+}
+
+void Random::Fill(int* values, int count, int min, int max)
+{
+	uint64_t range = (uint64_t)((int64_t)max - min + 1);
+	for (int i = 0; i < count; i++)
+		values[i] = min + (int)((NextUInt() * range) >> 32);
+}
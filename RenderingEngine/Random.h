@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+//------------------------------------------------
+// Small, fast random number generator
+// (xoshiro128**). Every system that needs random
+// numbers owns its own stream, so there is no
+// shared hidden state and a given seed always
+// plays out the same way.
+//------------------------------------------------
+class Random
+{
+public:
+	Random(uint64_t seed = 0);
+
+	void Seed(uint64_t seed);
+
+	// Moves this stream 2^64 numbers ahead. Copying a stream and
+	// then jumping the original gives two that never overlap.
+	void Jump();
+	Random Split();
+
+	inline uint32_t NextUInt();
+	inline float NextFloat();							// [0, 1)
+	inline float NextFloat(float min, float max);		// [min, max)
+	inline int NextInt(int min, int max);				// [min, max]
+
+	// Batch versions of NextFloat(min, max) and NextInt(min, max)
+	void Fill(float* values, int count, float min, float max);
+	void Fill(int* values, int count, int min, int max);
+private:
+	uint32_t state[4];
+
+	static inline uint32_t RotateLeft(uint32_t value, int bits);
+};
+
+inline uint32_t Random::RotateLeft(uint32_t value, int bits)
+{
+	return (value << bits) | (value >> (32 - bits));
+}
+
+inline uint32_t Random::NextUInt()
+{
+	uint32_t result = RotateLeft(state[1] * 5, 7) * 9;
+	uint32_t t = state[1] << 9;
+
+	state[2] ^= state[0];
+	state[3] ^= state[1];
+	state[1] ^= state[2];
+	state[0] ^= state[3];
+	state[2] ^= t;
+	state[3] = RotateLeft(state[3], 11);
+
+	return result;
+}
+
+inline float Random::NextFloat()
+{
+	// Top 24 bits fill a float mantissa exactly
+	return (NextUInt() >> 8) * (1.0f / 16777216.0f);
+}
+
+inline float Random::NextFloat(float min, float max)
+{
+	return min + (max - min) * NextFloat();
+}
+
+inline int Random::NextInt(int min, int max)
+{
+	uint64_t range = (uint64_t)((int64_t)max - min + 1);
+	return min + (int)((NextUInt() * range) >> 32);
+}
@@ -0,0 +1,219 @@
+#include "RenderQueue.h"
+#include "Entity.h"
+#include "Random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+using namespace DirectX;
+
+#define RENDER_KEY_DEPTH_SHIFT 0
+#define RENDER_KEY_MESH_SHIFT (RENDER_KEY_DEPTH_SHIFT + RENDER_KEY_DEPTH_BITS)
+#define RENDER_KEY_MATERIAL_SHIFT (RENDER_KEY_MESH_SHIFT + RENDER_KEY_MESH_BITS)
+#define RENDER_KEY_SHADER_SHIFT (RENDER_KEY_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS)
+#define RENDER_KEY_PASS_SHIFT (RENDER_KEY_SHADER_SHIFT + RENDER_KEY_SHADER_BITS)
+
+// Clearing and walking the histograms costs more than an insertion
+// sort below this many keys
+#define RADIX_SORT_MIN_COUNT 64
+
+int RenderQueueStats::GetSkippedCount() const
+{
+	return shaderChangesSkipped + materialChangesSkipped + meshChangesSkipped;
+}
+
+RenderQueueStats& RenderQueueStats::operator+=(const RenderQueueStats& other)
+{
+	draws += other.draws;
+	shaderChanges += other.shaderChanges;
+	shaderChangesSkipped += other.shaderChangesSkipped;
+	materialChanges += other.materialChanges;
+	materialChangesSkipped += other.materialChangesSkipped;
+	meshChanges += other.meshChanges;
+	meshChangesSkipped += other.meshChangesSkipped;
+	return *this;
+}
+
+RenderQueue::RenderQueue()
+{
+	viewPosition = XMFLOAT3(0, 0, 0);
+}
+
+void RenderQueue::Begin(XMFLOAT3 viewPosition)
+{
+	this->viewPosition = viewPosition;
+	items.clear();
+}
+
+// -----------------------------------------------------
+// Opaque draws go front to back within the same mesh,
+// so nearer ones fill the depth buffer first
+// -----------------------------------------------------
+void RenderQueue::Add(Entity* entity, unsigned int pass)
+{
+	Material* material = entity->GetMaterial();
+	BoundingSphere bounds = entity->GetDrawBounds();
+	float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&bounds.Center), XMLoadFloat3(&viewPosition))));
+	float depth = (std::min)(distance / RENDER_QUEUE_MAX_DEPTH, 1.0f);
+	uint64_t depthBits = (uint64_t)(depth * ((1 << RENDER_KEY_DEPTH_BITS) - 1));
+
+	uint64_t key =
+		((uint64_t)(pass & ((1 << RENDER_KEY_PASS_BITS) - 1)) << RENDER_KEY_PASS_SHIFT) |
+		((uint64_t)GetShaderId(material->GetVertexShader(), material->GetPixelShader()) << RENDER_KEY_SHADER_SHIFT) |
+		((uint64_t)GetId(materialIds, material, 1 << RENDER_KEY_MATERIAL_BITS) << RENDER_KEY_MATERIAL_SHIFT) |
+		((uint64_t)GetId(meshIds, entity->GetMesh(), 1 << RENDER_KEY_MESH_BITS) << RENDER_KEY_MESH_SHIFT) |
+		(depthBits << RENDER_KEY_DEPTH_SHIFT);
+
+	items.push_back(RenderItem{ key, entity });
+}
+
+void RenderQueue::Sort()
+{
+	if (scratch.size() < items.size())
+		scratch.resize(items.size());
+	RadixSort(items.data(), scratch.data(), (int)items.size());
+}
+
+int RenderQueue::GetCount() const
+{
+	return (int)items.size();
+}
+
+Entity* RenderQueue::GetEntity(int index) const
+{
+	return items[index].entity;
+}
+
+unsigned int RenderQueue::GetPass(int index) const
+{
+	return (unsigned int)(items[index].key >> RENDER_KEY_PASS_SHIFT);
+}
+
+// -----------------------------------------------------
+// Ids wrap once there are more objects than bits.
+// Sorting stays correct, only the grouping suffers.
+// -----------------------------------------------------
+uint32_t RenderQueue::GetId(std::unordered_map<const void*, uint32_t>& ids, const void* object, uint32_t limit)
+{
+	auto it = ids.find(object);
+	if (it == ids.end())
+		it = ids.insert(std::make_pair(object, (uint32_t)ids.size())).first;
+	return it->second & (limit - 1);
+}
+
+uint32_t RenderQueue::GetShaderId(const void* vertexShader, const void* pixelShader)
+{
+	auto shaders = std::make_pair(vertexShader, pixelShader);
+	auto it = shaderIds.find(shaders);
+	if (it == shaderIds.end())
+		it = shaderIds.insert(std::make_pair(shaders, (uint32_t)shaderIds.size())).first;
+	return it->second & ((1 << RENDER_KEY_SHADER_BITS) - 1);
+}
+
+// -----------------------------------------------------
+// Small queues use an insertion sort. Otherwise all
+// eight histograms are counted in one read of the
+// keys. A scene has a handful of shaders, materials
+// and meshes, so most of the high digits are the same
+// for every key and are skipped.
+// -----------------------------------------------------
+void RenderQueue::RadixSort(RenderItem* items, RenderItem* scratch, int count)
+{
+	if (count < RADIX_SORT_MIN_COUNT)
+	{
+		for (int i = 1; i < count; i++)
+		{
+			RenderItem item = items[i];
+			int j = i;
+			for (; j > 0 && items[j - 1].key > item.key; j--)
+				items[j] = items[j - 1];
+			items[j] = item;
+		}
+		return;
+	}
+
+	int histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (int i = 0; i < count; i++)
+	{
+		uint64_t key = items[i].key;
+		for (int digit = 0; digit < 8; digit++)
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+	}
+
+	RenderItem* source = items;
+	RenderItem* destination = scratch;
+	for (int digit = 0; digit < 8; digit++)
+	{
+		int* histogram = histograms[digit];
+		int shift = digit * 8;
+		if (histogram[(source[0].key >> shift) & 0xFF] == count)
+			continue;
+
+		int offsets[256];
+		int total = 0;
+		for (int bucket = 0; bucket < 256; bucket++)
+		{
+			offsets[bucket] = total;
+			total += histogram[bucket];
+		}
+
+		for (int i = 0; i < count; i++)
+			destination[offsets[(source[i].key >> shift) & 0xFF]++] = source[i];
+		std::swap(source, destination);
+	}
+
+	if (source != items)
+		memcpy(items, source, sizeof(RenderItem) * count);
+}
+
+// -----------------------------------------------------
+// Keys shaped like a real frame: few shaders, more
+// materials and meshes, random depths
+// -----------------------------------------------------
+bool RenderQueue::Benchmark(int itemCount, int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	Random random(1);
+	std::vector<RenderItem> original(itemCount);
+	for (int i = 0; i < itemCount; i++)
+	{
+		uint64_t key =
+			((uint64_t)random.NextInt(0, 1) << RENDER_KEY_PASS_SHIFT) |
+			((uint64_t)random.NextInt(0, 7) << RENDER_KEY_SHADER_SHIFT) |
+			((uint64_t)random.NextInt(0, 63) << RENDER_KEY_MATERIAL_SHIFT) |
+			((uint64_t)random.NextInt(0, 127) << RENDER_KEY_MESH_SHIFT) |
+			((uint64_t)random.NextInt(0, 0xFFFF) << RENDER_KEY_DEPTH_SHIFT);
+		original[i] = RenderItem{ key, nullptr };
+	}
+
+	std::vector<RenderItem> items(itemCount);
+	std::vector<RenderItem> scratch(itemCount);
+	auto byKey = [](const RenderItem& a, const RenderItem& b) { return a.key < b.key; };
+
+	double compareMs = 0, radixMs = 0;
+	bool matches = true;
+	for (int n = 0; n < iterations; n++)
+	{
+		items = original;
+		auto start = Clock::now();
+		std::sort(items.begin(), items.end(), byKey);
+		auto sorted = Clock::now();
+		compareMs += std::chrono::duration<double, std::milli>(sorted - start).count();
+		std::vector<RenderItem> reference = items;
+
+		items = original;
+		start = Clock::now();
+		RadixSort(items.data(), scratch.data(), itemCount);
+		sorted = Clock::now();
+		radixMs += std::chrono::duration<double, std::milli>(sorted - start).count();
+
+		for (int i = 0; i < itemCount && matches; i++)
+			matches = items[i].key == reference[i].key;
+	}
+
+	printf("\nRender queue sort (%d keys): std::sort %.3f ms, radix %.3f ms",
+		itemCount, compareMs / iterations, radixMs / iterations);
+	return matches;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <cstdint>
+#include <DirectXMath.h>
+
+class Entity;
+
+// Bits of the sort key, from the most significant down
+#define RENDER_KEY_PASS_BITS 4
+#define RENDER_KEY_SHADER_BITS 12
+#define RENDER_KEY_MATERIAL_BITS 16
+#define RENDER_KEY_MESH_BITS 16
+#define RENDER_KEY_DEPTH_BITS 16
+
+// Depth is quantized over this distance from the viewer
+#define RENDER_QUEUE_MAX_DEPTH 1000.0f
+
+//------------------------------------------------
+// What a submit did and did not have to bind
+//------------------------------------------------
+struct RenderQueueStats
+{
+	int draws;
+	int shaderChanges;
+	int shaderChangesSkipped;
+	int materialChanges;
+	int materialChangesSkipped;
+	int meshChanges;
+	int meshChangesSkipped;
+
+	int GetSkippedCount() const;
+	RenderQueueStats& operator+=(const RenderQueueStats& other);
+};
+
+struct RenderItem
+{
+	uint64_t key;
+	Entity* entity;
+};
+
+//------------------------------------------------
+// Draws for one frame, each reduced to a 64 bit
+// key of pass, shader, material, mesh and depth.
+// Sorting the keys puts draws that share state
+// next to each other, so the renderer can skip
+// binding it again.
+//------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	// Empties the queue. Depth is measured from viewPosition.
+	void Begin(DirectX::XMFLOAT3 viewPosition);
+
+	// Lower passes are drawn first
+	void Add(Entity* entity, unsigned int pass);
+
+	// Radix sorts the keys, call once everything is added
+	void Sort();
+
+	int GetCount() const;
+
+	// In sorted order once Sort has been called
+	Entity* GetEntity(int index) const;
+	unsigned int GetPass(int index) const;
+
+	// Least significant digit first, 8 bits per pass. Digits that are
+	// the same for every key are skipped. scratch needs count entries.
+	static void RadixSort(RenderItem* items, RenderItem* scratch, int count);
+
+	// Times RadixSort against std::sort on random keys. False if the
+	// two sorted differently.
+	static bool Benchmark(int itemCount, int iterations);
+private:
+	DirectX::XMFLOAT3 viewPosition;
+	std::vector<RenderItem> items;
+	std::vector<RenderItem> scratch;
+
+	// Small ids handed out the first time something is seen, they
+	// stay the same from frame to frame
+	std::map<std::pair<const void*, const void*>, uint32_t> shaderIds;
+	std::unordered_map<const void*, uint32_t> materialIds;
+	std::unordered_map<const void*, uint32_t> meshIds;
+	uint32_t GetShaderId(const void* vertexShader, const void* pixelShader);
+	uint32_t GetId(std::unordered_map<const void*, uint32_t>& ids, const void* object, uint32_t limit);
+};
+
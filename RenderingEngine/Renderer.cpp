@@ -1,4 +1,7 @@
 #include "Renderer.h"
+#include <cstring>
+
+static_assert(sizeof(LightData) % 16 == 0, "Constant buffers are a multiple of 16 bytes");
 
 void Renderer::SetShadowViewProj(DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection, ID3D11SamplerState* sampler, ID3D11ShaderResourceView* srv)
 {
@@ -38,14 +41,48 @@ void Renderer::SetLights(std::unordered_map<std::string, Light*> lightsMap)
 	lights = lightsMap;
 }
 
+// -----------------------------------------------------
+// The shaders bind this buffer directly, so entities
+// don't touch lights at all when they draw
+// -----------------------------------------------------
+void Renderer::UpdateLightBuffer()
+{
+	LightData data = {};
+	for (auto& element : lights)
+	{
+		Light* light = element.second;
+		switch (light->Type)
+		{
+		case Directional:
+			if (data.DirectionalLightCount < MAX_LIGHTS)
+				data.DirLights[data.DirectionalLightCount++] = *light->GetLight<DirectionalLight>();
+			break;
+		case Point:
+			if (data.PointLightCount < MAX_LIGHTS)
+				data.PointLights[data.PointLightCount++] = *light->GetLight<PointLight>();
+			break;
+		}
+	}
+	data.CameraPosition = camera->GetPosition();
+
+	if (memcmp(&data, &lightData, sizeof(LightData)) == 0)
+		return;
+
+	lightData = data;
+	context->UpdateSubresource(lightBuffer, 0, 0, &lightData, 0, 0);
+}
+
+ID3D11Buffer * Renderer::GetLightBuffer()
+{
+	return lightBuffer;
+}
+
 void Renderer::Draw(Entity* entity)
 {
 	if (!entity->isAnimated)
 	{
 		UINT stride = sizeof(Vertex);
 		UINT offset = 0;
-		entity->SetCameraPosition(camera->GetPosition());
-		entity->SetLights(lights);
 		if (entity->hasShadow)
 			entity->PrepareMaterialWithShadows(camera->GetViewMatrix(), camera->GetProjectionMatrix(), shadowViewMatrix, shadowProjectionMatrix, shadowSampler, shadowSRV);
 		else
@@ -60,10 +97,8 @@ void Renderer::Draw(Entity* entity)
 	{
 		UINT stride = sizeof(VertexAnimated);
 		UINT offset = 0;
-		entity->SetCameraPosition(camera->GetPosition());
-		entity->SetLights(lights);
 
-		entity->PrepareMaterialAnimated(camera->GetViewMatrix(), camera->GetProjectionMatrix(), &resources->fishFBX);
+		entity->PrepareMaterialAnimated(camera->GetViewMatrix(), camera->GetProjectionMatrix(), resources->fishFBX.get());
 
 
 		auto mesh = entity->GetMesh();
@@ -81,8 +116,6 @@ void Renderer::Draw(Terrain * entity)
 {
 	UINT stride = sizeof(VertexTerrain);
 	UINT offset = 0;
-	entity->SetCameraPosition(camera->GetPosition());
-	entity->SetLights(lights);
 	if (entity->hasShadow)
 		entity->PrepareMaterialWithShadows(camera->GetViewMatrix(), camera->GetProjectionMatrix(), shadowViewMatrix, shadowProjectionMatrix, shadowSampler, shadowSRV);
 	else
@@ -98,8 +131,6 @@ void Renderer::DrawAsLineList(Entity * entity)
 {
 	UINT stride = sizeof(Vertex);
 	UINT offset = 0;
-	entity->SetCameraPosition(camera->GetPosition());
-	entity->SetLights(lights);
 	entity->PrepareMaterial(camera->GetViewMatrix(), camera->GetProjectionMatrix());
 	auto mesh = entity->GetMesh();
 	auto vertexBuffer = mesh->GetVertexBuffer();
@@ -110,6 +141,143 @@ void Renderer::DrawAsLineList(Entity * entity)
 	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST); //Reset to triangle list
 }
 
+// -----------------------------------------------------
+// Points a pair of shaders at the command list so their
+// binds and uploads are recorded rather than made
+// -----------------------------------------------------
+void Renderer::RecordShaders(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader)
+{
+	ISimpleShader* shaders[2] = { vertexShader, pixelShader };
+	for (auto shader : shaders)
+	{
+		if (shader->GetCommandList() == &commandList)
+			continue;
+		shader->SetCommandList(&commandList);
+		recordingShaders.push_back(shader);
+	}
+}
+
+// -----------------------------------------------------
+// Replays whatever has been recorded and hands the
+// shaders back to the context
+// -----------------------------------------------------
+void Renderer::FlushCommands()
+{
+	commandList.Execute(commandBackend);
+	commandList.Reset();
+	for (auto shader : recordingShaders)
+		shader->SetCommandList(nullptr);
+	recordingShaders.clear();
+}
+
+// -----------------------------------------------------
+// Per shader state (constants, the shadow map) is
+// set when the shader changes, per material state when
+// the material changes, and only the transforms are
+// uploaded for every draw
+// -----------------------------------------------------
+RenderQueueStats Renderer::Submit(RenderQueue & queue)
+{
+	RenderQueueStats stats = {};
+	queue.Sort();
+
+	XMFLOAT4X4 view = camera->GetViewMatrix();
+	XMFLOAT4X4 projection = camera->GetProjectionMatrix();
+
+	SimpleVertexShader* currentVS = nullptr;
+	SimplePixelShader* currentPS = nullptr;
+	Material* currentMaterial = nullptr;
+	Mesh* currentMesh = nullptr;
+	bool shadowMapBound = false;
+	unsigned int currentPass = 0;
+
+	commandList.Reset();
+	commandList.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	for (int i = 0; i < queue.GetCount(); i++)
+	{
+		Entity* entity = queue.GetEntity(i);
+		stats.draws++;
+
+		// Every pass starts from empty texture slots
+		if (i > 0 && queue.GetPass(i) != currentPass)
+		{
+			for (unsigned int slot = 0; slot < 4; slot++)
+				commandList.SetShaderResource(CommandStage::Pixel, slot, nullptr);
+			currentMaterial = nullptr;
+			shadowMapBound = false;
+		}
+		currentPass = queue.GetPass(i);
+
+		// Animated entities upload their bones on every draw, so they
+		// go the long way and nothing bound before can be trusted
+		if (entity->isAnimated)
+		{
+			FlushCommands();
+			Draw(entity);
+			currentVS = nullptr;
+			currentPS = nullptr;
+			currentMaterial = nullptr;
+			currentMesh = nullptr;
+			continue;
+		}
+
+		Material* material = entity->GetMaterial();
+		Mesh* mesh = entity->GetMesh();
+		auto vertexShader = material->GetVertexShader();
+		auto pixelShader = material->GetPixelShader();
+
+		if (vertexShader != currentVS || pixelShader != currentPS)
+		{
+			RecordShaders(vertexShader, pixelShader);
+			pixelShader->CopyAllBufferData();
+			vertexShader->SetShader();
+			pixelShader->SetShader();
+			currentVS = vertexShader;
+			currentPS = pixelShader;
+			currentMaterial = nullptr;
+			shadowMapBound = false;
+			stats.shaderChanges++;
+		}
+		else
+			stats.shaderChangesSkipped++;
+
+		if (material != currentMaterial)
+		{
+			entity->BindMaterial();
+			currentMaterial = material;
+			stats.materialChanges++;
+		}
+		else
+			stats.materialChangesSkipped++;
+
+		entity->SetTransforms(view, projection);
+		if (entity->hasShadow)
+		{
+			entity->SetShadowTransforms(shadowViewMatrix, shadowProjectionMatrix);
+			if (!shadowMapBound)
+			{
+				entity->BindShadowMap(shadowSampler, shadowSRV);
+				shadowMapBound = true;
+			}
+		}
+		vertexShader->CopyAllBufferData();
+
+		if (mesh != currentMesh)
+		{
+			commandList.SetVertexBuffer(0, mesh->GetVertexBuffer(), sizeof(Vertex));
+			commandList.SetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT);
+			currentMesh = mesh;
+			stats.meshChanges++;
+		}
+		else
+			stats.meshChangesSkipped++;
+
+		commandList.DrawIndexed((UINT)mesh->GetIndexCount());
+	}
+	FlushCommands();
+	return stats;
+}
+
 void Renderer::Present()
 {
 	swapChain->Present(0, 0);
@@ -122,9 +290,22 @@ Renderer::Renderer(ID3D11DeviceContext *ctx,
 	context(ctx),
 	backBufferRTV(backBuffer),
 	depthStencilView(depthStencil),
-	swapChain(inSwapChain)
+	swapChain(inSwapChain),
+	commandBackend(ctx)
 {	
 	depthStencilView = depthStencil;
+
+	ID3D11Device* device;
+	context->GetDevice(&device);
+	D3D11_BUFFER_DESC lightBufferDesc = {};
+	lightBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	lightBufferDesc.ByteWidth = sizeof(LightData);
+	lightBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	lightData = {};
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = &lightData;
+	device->CreateBuffer(&lightBufferDesc, &initialData, &lightBuffer);
+	device->Release();
 }
 
 void Renderer::SetBackBuffer(ID3D11RenderTargetView* _backBufferRTV)
@@ -134,4 +315,5 @@ void Renderer::SetBackBuffer(ID3D11RenderTargetView* _backBufferRTV)
 
 Renderer::~Renderer()
 {
+	if (lightBuffer) lightBuffer->Release();
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include "Water.h"
 #include "Resources.h"
 #include "Terrain.h"
+#include "RenderQueue.h"
+#include "D3D11CommandBackend.h"
 
 class Renderer
 {
@@ -25,6 +27,17 @@ class Renderer
 	ID3D11SamplerState* shadowSampler;
 	ID3D11ShaderResourceView* shadowSRV;
 
+	// Per frame light constant buffer every lit shader binds
+	LightData lightData;
+	ID3D11Buffer* lightBuffer;
+
+	// Submit records the queue here, then replays it on the context
+	CommandList commandList;
+	D3D11CommandBackend commandBackend;
+	std::vector<ISimpleShader*> recordingShaders;
+	void RecordShaders(SimpleVertexShader* vertexShader, SimplePixelShader* pixelShader);
+	void FlushCommands();
+
 public:
 	void SetShadowViewProj(DirectX::XMFLOAT4X4, DirectX::XMFLOAT4X4, ID3D11SamplerState*, ID3D11ShaderResourceView*);
 	void SetDepthStencilView(ID3D11DepthStencilView *depthStencilView);
@@ -32,9 +45,19 @@ public:
 	void ClearScreen(const float color[4]);
 	void SetCamera(Camera* cam);
 	void SetLights(std::unordered_map<std::string, Light*> lightsMap);
+
+	// Packs the lights and camera position, uploads them if they
+	// changed. Call once a frame before drawing anything lit.
+	void UpdateLightBuffer();
+	ID3D11Buffer* GetLightBuffer();
 	void Draw(Entity *entity);
 	void Draw(Terrain *entity);
 	void DrawAsLineList(Entity *entity);
+
+	// Sorts the queue and draws it, only binding shaders, materials
+	// and meshes when they differ from the previous draw. The draws
+	// are recorded into a command list and replayed in one go.
+	RenderQueueStats Submit(RenderQueue& queue);
 	void Present();
 	Renderer(ID3D11DeviceContext *ctx, ID3D11RenderTargetView *backBuffer, ID3D11DepthStencilView *depthStencil, IDXGISwapChain *inSwapChain);
 	void SetBackBuffer(ID3D11RenderTargetView* backBufferRTV);
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+//------------------------------------------------
+// Refers to one slot of a ResourceRegistry<T>.
+// The generation goes up every time the slot is
+// freed, so a handle to something that has been
+// removed stops resolving instead of pointing at
+// whatever took its place.
+//------------------------------------------------
+template<typename T>
+struct ResourceHandle
+{
+	uint32_t index;
+	uint32_t generation;
+
+	ResourceHandle() : index(0), generation(0) {}
+	ResourceHandle(uint32_t index, uint32_t generation) : index(index), generation(generation) {}
+
+	// Generations start at 1, so a default handle never resolves
+	bool IsValid() const { return generation != 0; }
+	bool operator==(const ResourceHandle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const ResourceHandle& other) const { return !(*this == other); }
+};
+
+//------------------------------------------------
+// Resources of one type kept in dense arrays and
+// named only while loading. Code that runs every
+// frame resolves a handle once and then goes
+// through Get, which is an index and a compare.
+// The registry does not own what it holds.
+//------------------------------------------------
+template<typename T>
+class ResourceRegistry
+{
+public:
+	typedef ResourceHandle<T> Handle;
+	typedef typename std::vector<T*>::const_iterator Iterator;
+
+	// Names are unique, adding one twice keeps the first and
+	// returns its handle. The item passed in is then still the
+	// caller's to free, check Get(handle) against it.
+	Handle Add(const std::string& name, T* item)
+	{
+		auto it = nameTable.find(name);
+		if (it != nameTable.end())
+			return Handle(it->second, generations[it->second]);
+
+		uint32_t index;
+		if (!freeSlots.empty())
+		{
+			index = freeSlots.back();
+			freeSlots.pop_back();
+			items[index] = item;
+			names[index] = name;
+		}
+		else
+		{
+			index = (uint32_t)items.size();
+			items.push_back(item);
+			generations.push_back(1);
+			names.push_back(name);
+		}
+		nameTable[name] = index;
+		return Handle(index, generations[index]);
+	}
+
+	// Frees the slot and hands back what was in it, so the caller
+	// can release it. Every outstanding handle to it goes stale.
+	T* Remove(Handle handle)
+	{
+		T* item = Get(handle);
+		if (!item)
+			return nullptr;
+
+		nameTable.erase(names[handle.index]);
+		items[handle.index] = nullptr;
+		names[handle.index].clear();
+		if (++generations[handle.index] == 0)
+			generations[handle.index] = 1;
+		freeSlots.push_back(handle.index);
+		return item;
+	}
+
+	// Load time only, an invalid handle if nothing has that name
+	Handle GetHandle(const std::string& name) const
+	{
+		auto it = nameTable.find(name);
+		if (it == nameTable.end())
+			return Handle();
+		return Handle(it->second, generations[it->second]);
+	}
+
+	// Null if the handle is invalid or stale
+	T* Get(Handle handle) const
+	{
+		if (handle.index >= items.size() || generations[handle.index] != handle.generation)
+			return nullptr;
+		return items[handle.index];
+	}
+
+	// Load time only, null if nothing has that name
+	T* Find(const std::string& name) const
+	{
+		auto it = nameTable.find(name);
+		return it == nameTable.end() ? nullptr : items[it->second];
+	}
+
+	int GetCount() const { return (int)nameTable.size(); }
+
+	// Walks every slot, freed ones are null
+	Iterator begin() const { return items.begin(); }
+	Iterator end() const { return items.end(); }
+private:
+	std::vector<T*> items;
+	std::vector<uint32_t> generations;
+	std::vector<std::string> names;
+	std::vector<uint32_t> freeSlots;
+	std::unordered_map<std::string, uint32_t> nameTable;
+};
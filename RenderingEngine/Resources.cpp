@@ -1,9 +1,15 @@
 #include "Resources.h"
-#include "DDSTextureLoader.h"
-#include "ObjLoader.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "VertexWeld.h"
+#include "MeshOptimizer.h"
+#include "TextureData.h"
+#include "JobSystem.h"
 #include <locale>
 #include <codecvt>
 #include <string>
+#include <map>
+#include <chrono>
 
 std::wstring to_wstring(std::string narrow)
 {
@@ -32,36 +38,189 @@ std::vector<Vertex> MapObjlToVertex(std::vector<objl::Vertex> vertices)
 	return verts;
 }
 
-ID3D11ShaderResourceView* LoadSRV(std::wstring filename, ID3D11Device* device)
+// -----------------------------------------------------
+// Meshes as they come out of a source file. Once
+// cooked, vertices are welded, triangles and vertices
+// reordered for the GPU and tangents and bounds done,
+// ready to cache or upload.
+// -----------------------------------------------------
+struct CookedMesh
 {
-	ID3D11ShaderResourceView* srv = nullptr;
-	if (filename.find(L".dds") != std::string::npos)
+	std::string name;
+	std::string texture;
+	std::vector<Vertex> vertices;
+	std::vector<UINT> indices;
+	XMFLOAT3 minDimensions;
+	XMFLOAT3 maxDimensions;
+};
+
+typedef std::vector<CookedMesh>(*MeshReader)(const std::string& path);
+
+void FinishCooking(CookedMesh& mesh)
+{
+	WeldVertices(mesh.vertices, mesh.indices);
+	OptimizeMesh(mesh.vertices, mesh.indices);
+	Mesh::CalculateBounds(mesh.vertices.data(), (UINT)mesh.vertices.size(), mesh.minDimensions, mesh.maxDimensions);
+	Mesh::CalculateTangents(mesh.vertices.data(), (UINT)mesh.vertices.size(), mesh.indices.data(), (UINT)mesh.indices.size());
+}
+
+// Every mesh and material in the file, split up the way objl does it
+std::vector<CookedMesh> ReadObjlMeshes(const std::string& path)
+{
+	std::vector<CookedMesh> cooked;
+	ObjParser parser;
+	if (!parser.LoadFile(path))
+		return cooked;
+
+	for (auto& mesh : parser.LoadedMeshes)
 	{
-		CreateDDSTextureFromFile(device, filename.c_str(), nullptr, &srv);
+		CookedMesh cookedMesh;
+		cookedMesh.name = mesh.MeshName;
+		cookedMesh.texture = mesh.MeshMaterial.map_Kd;
+		cookedMesh.vertices = MapObjlToVertex(mesh.Vertices);
+		cookedMesh.indices = mesh.Indices;
+		cooked.push_back(std::move(cookedMesh));
 	}
+	return cooked;
+}
+
+// The whole file as one unnamed mesh, through Mesh's own parser
+std::vector<CookedMesh> ReadObjMesh(const std::string& path)
+{
+	std::vector<CookedMesh> cooked(1);
+	if (!Mesh::LoadObj(path.c_str(), cooked[0].vertices, cooked[0].indices))
+		return std::vector<CookedMesh>();
+	return cooked;
+}
+
+std::vector<CookedMesh> CookMeshes(const std::string& path, MeshReader read)
+{
+	std::vector<CookedMesh> cooked = read(path);
+	for (auto& mesh : cooked)
+		FinishCooking(mesh);
+	return cooked;
+}
+
+std::vector<MeshCacheEntry> GetCacheEntries(const std::vector<CookedMesh>& cooked)
+{
+	std::vector<MeshCacheEntry> entries;
+	for (auto& mesh : cooked)
+	{
+		MeshCacheEntry entry;
+		entry.name = mesh.name;
+		entry.texture = mesh.texture;
+		entry.vertices = mesh.vertices.data();
+		entry.vertexCount = (uint32_t)mesh.vertices.size();
+		entry.indices = mesh.indices.data();
+		entry.indexCount = (uint32_t)mesh.indices.size();
+		entry.minDimensions = mesh.minDimensions;
+		entry.maxDimensions = mesh.maxDimensions;
+		entries.push_back(entry);
+	}
+	return entries;
+}
+
+// -----------------------------------------------------
+// One manifest entry as a worker left it. Only the
+// part for the entry's type is filled in.
+// -----------------------------------------------------
+struct LoadedAsset
+{
+	AssetEntry entry;
+	int group;
+
+	TextureData texture;
+	ID3DBlob* shader;
+
+	// Models, the entries point into the cache or cooked
+	MeshCache cache;
+	std::vector<CookedMesh> cooked;
+	std::vector<MeshCacheEntry> meshes;
+	std::vector<TextureData> textures;	// One per mesh when its textures are loaded
+
+	// The animated fish comes with its mesh already made
+	std::unique_ptr<FBXLoader> fbx;
+	Mesh* animatedMesh;
+
+	LoadedAsset() : shader(nullptr), animatedMesh(nullptr) {}
+
+	// Upload hands these over, so they are only still here when the
+	// asset was never uploaded
+	~LoadedAsset()
+	{
+		if (shader)
+			shader->Release();
+		delete animatedMesh;
+	}
+};
+
+// -----------------------------------------------------
+// Straight out of the cache when it matches the
+// source. Otherwise the source is cooked and the
+// cache written for next time. Only the OBJ is hashed,
+// delete the cache by hand after editing its .mtl.
+// -----------------------------------------------------
+void ReadModel(const std::string& path, MeshReader read, bool loadTex, LoadedAsset& model)
+{
+	std::string cachePath = MeshCache::GetCachePath(path);
+	if (model.cache.Open(cachePath, path))
+		model.meshes = model.cache.GetEntries();
 	else
 	{
-		CreateWICTextureFromFile(device, filename.c_str(), nullptr, &srv);
+		model.cooked = CookMeshes(path, read);
+		model.meshes = GetCacheEntries(model.cooked);
+		MeshCache::Write(cachePath, path, model.meshes);
 	}
 
-	return srv;
+	if (loadTex)
+	{
+		std::wstring baseTexAddress = L"../../Assets/Textures/";
+		model.textures.resize(model.meshes.size());
+		for (size_t i = 0; i < model.meshes.size(); i++)
+			ReadTextureData(baseTexAddress + to_wstring(model.meshes[i].texture), model.textures[i]);
+	}
 }
 
-void AddToMeshMap(objl::Loader loader, MeshMap& map, ID3D11Device* device, std::string prefix, SRVMap& texMap, bool loadTex)
+// -----------------------------------------------------
+// Everything that doesn't need the context, run on a
+// worker. The FBX loader makes its mesh's buffers as
+// it goes, which the device allows from any thread.
+// -----------------------------------------------------
+void ReadAsset(LoadedAsset& asset, ID3D11Device* device)
 {
-	std::wstring baseTexAddress = L"../../Assets/Textures/";
-	for (auto mesh : loader.LoadedMeshes)
+	const AssetEntry& entry = asset.entry;
+	const std::string& path = entry.args[0];
+	bool read = true;
+	switch (entry.type)
 	{
-		auto verts = MapObjlToVertex(mesh.Vertices);
-		auto indices = mesh.Indices;
-		Mesh* m = new Mesh(verts.data(), (UINT)verts.size(), indices.data(), (UINT)indices.size(), device);
-		map.insert(MeshMapType(prefix + mesh.MeshName, m));
-		if (loadTex)
+	case TextureAsset:
+		read = ReadTextureData(to_wstring(path), asset.texture);
+		break;
+	case VertexShaderAsset:
+	case PixelShaderAsset:
+		read = SUCCEEDED(D3DReadFileToBlob(to_wstring(path).c_str(), &asset.shader));
+		break;
+	case ModelAsset:
+		if (entry.args[1] == "fbx")
 		{
-			auto texURI = baseTexAddress + to_wstring(mesh.MeshMaterial.map_Kd);
-			texMap.insert(SRVMapType(prefix + mesh.MeshName, LoadSRV(texURI, device)));
+			asset.fbx = std::unique_ptr<FBXLoader>(new FBXLoader(path.c_str()));
+			FbxNode* root = asset.fbx->scene->GetRootNode();
+			asset.fbx->LoadNodes(root, device);
+			asset.animatedMesh = asset.fbx->GetMesh(root->GetChild(1), device);
 		}
+		else
+		{
+			bool loadTex = entry.args.size() > 2 && entry.args[2] == "textures";
+			ReadModel(path, entry.args[1] == "objl" ? ReadObjlMeshes : ReadObjMesh, loadTex, asset);
+			read = !asset.meshes.empty();
+		}
+		break;
+	default:
+		break;
 	}
+
+	if (!read)
+		printf("\nCan't load %s", path.c_str());
 }
 
 Resources * Resources::GetInstance()
@@ -69,325 +228,476 @@ Resources * Resources::GetInstance()
 	return mInstance;
 }
 
-void Resources::LoadResources()
+bool Resources::LoadResources(JobSystem* jobs, const std::string& manifestPath)
 {
-	//Ideally all below resources should be read off of a config file and loaded from there. 
-
-	//Load Textures
-	ID3D11ShaderResourceView *srv;
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/metal.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("metal", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/metalNormal.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("metalNormal", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/fabric.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("fabric", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/fabricNormal.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("fabricNormal", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/wood.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("wood", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/woodNormal.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("woodNormal", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/grass01.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("grass", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/grass01_n.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("grassNormal", srv));
-
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/grass01_h.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("grassSpecular", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/spear.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("spear", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/spearNormal.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("spearNormal", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/default.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("default", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/defaultNormal.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("defaultNormal", srv));
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/defaultSpecular.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("defaultSpecular", srv));
+	std::vector<AssetEntry> manifest;
+	if (!ReadAssetManifest(manifestPath, manifest))
+		return false;
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/metalSpecular.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("metalSpecular", srv));
+	this->jobs = jobs;
+	loadStart = std::chrono::high_resolution_clock::now();
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/boattex.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("boat", srv));
-
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/boattexnm.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("boatNormal", srv));
-
-	CreateDDSTextureFromFile(device, L"../../Assets/Textures/SunnyCubeMap.dds", 0, &srv);
-	shaderResourceViews.insert(SRVMapType("cubemap", srv));
-
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/waterColor.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("waterColor", srv));
+	//Load Sampler
+	D3D11_SAMPLER_DESC samplerDesc = {};
+	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
+	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
+	samplerDesc.MaxAnisotropy = 16;
+	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/waterNormal2.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("waterNormal2", srv));
+	device->CreateSamplerState(&samplerDesc, &sampler);
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/waterNormal21.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("waterNormal", srv));
+	// Every group is counted before anything starts, so none of them
+	// can finish early
+	std::vector<int> assetGroups;
+	for (auto& entry : manifest)
+	{
+		int group = 0;
+		while (group < (int)groups.size() && groups[group].name != entry.group)
+			group++;
+		if (group == (int)groups.size())
+		{
+			groups.emplace_back();
+			groups[group].name = entry.group;
+			groups[group].unfinished = 0;
+			groups[group].future = groups[group].loaded.get_future().share();
+		}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/Heightmaptest.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("waterDisplacement", srv));
+		if (entry.type == MaterialAsset)
+			groups[group].materials.push_back(entry);
+		else
+			groups[group].unfinished++;
+		assetGroups.push_back(group);
+	}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/fishTexture.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("fishTexture", srv));
+	for (size_t i = 0; i < manifest.size(); i++)
+	{
+		if (manifest[i].type != MaterialAsset)
+			StartLoading(manifest[i], assetGroups[i]);
+	}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/fishNormal.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("fishNormal", srv));
+	for (auto& group : groups)
+	{
+		if (group.unfinished == 0)
+			FinishGroup(group);
+	}
+	return true;
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/tuna.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("tuna", srv));
+// -----------------------------------------------------
+// Jobs are taken in the order they start. Without any
+// workers to take them the asset is read right here.
+// -----------------------------------------------------
+void Resources::StartLoading(const AssetEntry& entry, int group)
+{
+	ID3D11Device* device = this->device;
+	auto work = [this, entry, group, device]()
+	{
+		std::unique_ptr<LoadedAsset> asset(new LoadedAsset());
+		asset->entry = entry;
+		asset->group = group;
+		ReadAsset(*asset, device);
+
+		// Notified under the lock, so ~Resources can't return in between
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		finished.push_back(std::move(asset));
+		reading--;
+		finishedCondition.notify_one();
+	};
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Terrain/splatmap.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("splatmap", srv));
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		reading++;
+	}
+	if (jobs->GetWorkerCount() == 0)
+		work();
+	else
+		jobs->Run(jobs->CreateJob(work));
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/sand.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("sand", srv));
+void Resources::ProcessUploads()
+{
+	std::deque<std::unique_ptr<LoadedAsset>> uploads;
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		uploads.swap(finished);
+	}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/sandNormal.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("sandNormal", srv));
+	for (auto& asset : uploads)
+	{
+		Upload(*asset);
+		AssetGroup& group = groups[asset->group];
+		if (--group.unfinished == 0)
+			FinishGroup(group);
+	}
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/gravel.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("gravel", srv));
+// -----------------------------------------------------
+// The registries don't own anything, so when a name
+// is already taken the new item would be dropped on
+// the floor. Keep the first, as the registry does, and
+// free the one that lost.
+// -----------------------------------------------------
+static void Free(ID3D11ShaderResourceView* item) { if (item) item->Release(); }
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/gravelNormal.jpg", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("gravelNormal", srv));
+template<typename T>
+static void Free(T* item) { delete item; }
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/particle1.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("particle", srv));
+template<typename T>
+static ResourceHandle<T> AddOrFree(ResourceRegistry<T>& registry, const std::string& name, T* item)
+{
+	auto handle = registry.Add(name, item);
+	if (registry.Get(handle) != item)
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("\nResource \"%s\" is already loaded, keeping the first", name.c_str());
+#endif
+		Free(item);
+	}
+	return handle;
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/Rudd-Fish_Colourmap.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("ruddTexture", srv));
+void Resources::Upload(LoadedAsset& asset)
+{
+	const AssetEntry& entry = asset.entry;
+	switch (entry.type)
+	{
+	case TextureAsset:
+		AddOrFree(shaderResourceViews, entry.name, CreateTexture(device, context, asset.texture));
+		break;
+	case VertexShaderAsset:
+	{
+		auto vertexShader = new SimpleVertexShader(device, context);
+		if (asset.shader)
+			vertexShader->LoadShaderBlob(asset.shader);
+		asset.shader = nullptr;
+		AddOrFree(vertexShaders, entry.name, vertexShader);
+		break;
+	}
+	case PixelShaderAsset:
+	{
+		auto pixelShader = new SimplePixelShader(device, context);
+		if (asset.shader)
+			pixelShader->LoadShaderBlob(asset.shader);
+		asset.shader = nullptr;
+		AddOrFree(pixelShaders, entry.name, pixelShader);
+		break;
+	}
+	case ModelAsset:
+		if (asset.fbx)
+		{
+			AddOrFree(meshes, entry.name, asset.animatedMesh);
+			asset.animatedMesh = nullptr;
+			fishFBX = std::move(asset.fbx);
+			break;
+		}
+		for (size_t i = 0; i < asset.meshes.size(); i++)
+		{
+			auto& mesh = asset.meshes[i];
+			Mesh* m = new Mesh();
+			m->Initialize(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, mesh.minDimensions, mesh.maxDimensions, device);
+			AddOrFree(meshes, entry.name + mesh.name, m);
+			if (i < asset.textures.size())
+				AddOrFree(shaderResourceViews, entry.name + mesh.name, CreateTexture(device, context, asset.textures[i]));
+		}
+		break;
+	default:
+		break;
+	}
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/Rudd-Fish_Normalmap.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("ruddNormal", srv));
+void Resources::FinishGroup(AssetGroup& group)
+{
+	for (auto& material : group.materials)
+		CreateMaterial(material);
+	group.loaded.set_value();
+
+#if defined(DEBUG) || defined(_DEBUG)
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+	printf("\nAsset group \"%s\" loaded %.1f ms after LoadResources", group.name.c_str(), ms);
+#endif
+}
 
-	//Button textures
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/button_normal.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("button_normal", srv));
+// Up to three textures, "-" for none
+void Resources::CreateMaterial(const AssetEntry& entry)
+{
+	auto vertexShader = vertexShaders.Find(entry.args[0]);
+	auto pixelShader = pixelShaders.Find(entry.args[1]);
+	ID3D11ShaderResourceView* textures[3] = {};
+	for (size_t i = 2; i < entry.args.size(); i++)
+	{
+		if (entry.args[i] != "-")
+			textures[i - 2] = shaderResourceViews.Find(entry.args[i]);
+	}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/button_hover.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("button_hover", srv));
+	Material* material;
+	if (entry.args.size() == 3)
+		material = new Material(vertexShader, pixelShader, textures[0], sampler);
+	else if (entry.args.size() == 4)
+		material = new Material(vertexShader, pixelShader, textures[0], textures[1], sampler);
+	else
+		material = new Material(vertexShader, pixelShader, textures[0], textures[1], textures[2], sampler);
+	AddOrFree(materials, entry.name, material);
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/button_press.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("button_press", srv));
+std::shared_future<void> Resources::GetGroup(const std::string & name)
+{
+	for (auto& group : groups)
+	{
+		if (group.name == name)
+			return group.future;
+	}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/radial.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("radial", srv));
+	// Nothing to wait for
+	printf("\nNo asset group named \"%s\"", name.c_str());
+	std::promise<void> empty;
+	empty.set_value();
+	return empty.get_future().share();
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/foam.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("foam", srv));
+bool Resources::IsLoaded(const std::shared_future<void>& group)
+{
+	return group.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/title.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("title", srv));
+void Resources::Wait(const std::shared_future<void>& group)
+{
+	while (!IsLoaded(group))
+	{
+		{
+			std::unique_lock<std::mutex> lock(finishedMutex);
+			finishedCondition.wait(lock, [this]() { return !finished.empty() || reading == 0; });
+
+			// Everything has been read and uploaded, nothing more is coming
+			if (finished.empty())
+			{
+				printf("\nWaited for an asset group that can't finish loading");
+				return;
+			}
+		}
+		ProcessUploads();
+	}
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/quit.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("quit", srv));
+ID3D11ShaderResourceView * Resources::GetSRV(std::string name)
+{
+	return shaderResourceViews.Find(name);
+}
 
-	CreateWICTextureFromFile(device, context, L"../../Assets/Textures/quit_hover.png", nullptr, &srv);
-	shaderResourceViews.insert(SRVMapType("quit_hover", srv));
+Resources::Resources(ID3D11Device *device, ID3D11DeviceContext *context, IDXGISwapChain* swapChain)
+{
+	this->device = device;
+	this->context = context;
+	this->swapChain = swapChain;
+	jobs = nullptr;
+	reading = 0;
+	sampler = nullptr;
+	mInstance = this;
+}
 
-	CreateDDSTextureFromFile(device, L"../../Assets/Textures/Space2.dds", 0, &srv);
-	shaderResourceViews.insert(SRVMapType("spacesky2", srv));
 
-	CreateDDSTextureFromFile(device, L"../../Assets/Textures/mountain.dds", 0, &srv);
-	shaderResourceViews.insert(SRVMapType("mountain", srv));
+Resources::~Resources()
+{
+	// Workers still reading write into this. What they read is
+	// dropped without going to the GPU.
+	{
+		std::unique_lock<std::mutex> lock(finishedMutex);
+		finishedCondition.wait(lock, [this]() { return reading == 0; });
+	}
+	finished.clear();
+
+	for (auto it : meshes)delete it;
+	for (auto it : materials)delete it;
+	for (auto it : shaderResourceViews)if (it) it->Release();
+	for (auto it : pixelShaders)delete it;
+	for (auto it : vertexShaders)delete it;
+	if (sampler) sampler->Release();
+}
 
-	//Load Sampler
-	D3D11_SAMPLER_DESC samplerDesc = {};
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
-	samplerDesc.MaxAnisotropy = 16;
-	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+// -----------------------------------------------------
+// Names shaped like the ones above, looked up in a
+// scattered order. The keys are built up front, so
+// the map is not charged for making strings out of
+// literals the way the draw code used to.
+// -----------------------------------------------------
+bool Resources::BenchmarkLookups(int resourceCount, int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	std::vector<int> values(resourceCount);
+	std::vector<std::string> names(resourceCount);
+	std::map<std::string, int*> map;
+	ResourceRegistry<int> registry;
+	std::vector<ResourceRegistry<int>::Handle> handles(resourceCount);
+	for (int i = 0; i < resourceCount; i++)
+	{
+		values[i] = i;
+		names[i] = "resource" + std::to_string(i) + "Normal";
+		map.insert(std::make_pair(names[i], &values[i]));
+		handles[i] = registry.Add(names[i], &values[i]);
+	}
 
-	device->CreateSamplerState(&samplerDesc, &sampler);
+	std::vector<int> order(resourceCount);
+	for (int i = 0; i < resourceCount; i++)
+		order[i] = (int)(((long long)i * 7919) % resourceCount);
 
-	//Load Shaders
-	auto vertexShader = new SimpleVertexShader(device, context);
-	vertexShader->LoadShaderFile(L"VertexShader.cso");
-	vertexShaders.insert(VertexShaderMapType("default", vertexShader));
+	long long mapSum = 0, handleSum = 0;
+	auto start = Clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		for (int i : order)
+			mapSum += *map.find(names[i])->second;
+	}
+	auto mapEnd = Clock::now();
+	for (int n = 0; n < iterations; n++)
+	{
+		for (int i : order)
+			handleSum += *registry.Get(handles[i]);
+	}
+	auto handleEnd = Clock::now();
+
+	double lookups = (double)iterations * resourceCount;
+	double mapNs = std::chrono::duration<double, std::nano>(mapEnd - start).count() / lookups;
+	double handleNs = std::chrono::duration<double, std::nano>(handleEnd - mapEnd).count() / lookups;
+	printf("\nResource lookups (%d resources): std::map %.1f ns, handle %.1f ns",
+		resourceCount, mapNs, handleNs);
+	return mapSum == handleSum;
+}
 
-	auto pixelShader = new SimplePixelShader(device, context);
-	pixelShader->LoadShaderFile(L"PixelShader.cso");
-	pixelShaders.insert(PixelShaderMapType("default", pixelShader));
+// The OBJ models LoadResources loads, for the benchmarks below
+struct BenchmarkModel
+{
+	const char* path;
+	MeshReader read;
+};
 
-	auto skyVS = new SimpleVertexShader(device, context);
-	skyVS->LoadShaderFile(L"SkyVS.cso");
-	vertexShaders.insert(VertexShaderMapType("sky", skyVS));
+static const BenchmarkModel benchmarkModels[] =
+{
+	{ "../../Assets/Models/sphere.obj", ReadObjMesh },
+	{ "../../Assets/Models/cone.obj", ReadObjMesh },
+	{ "../../Assets/Models/cylinder.obj", ReadObjMesh },
+	{ "../../Assets/Models/cube.obj", ReadObjMesh },
+	{ "../../Assets/Models/helix.obj", ReadObjMesh },
+	{ "../../Assets/Models/torus.obj", ReadObjMesh },
+	{ "../../Assets/Models/spear.obj", ReadObjMesh },
+	{ "../../Assets/Models/boat.obj", ReadObjMesh },
+	{ "../../Assets/Models/tuna.obj", ReadObjMesh },
+	{ "../../Assets/Models/palm_tree.obj", ReadObjlMeshes },
+	{ "../../Assets/Models/fish01.obj", ReadObjlMeshes },
+};
+
+bool Resources::BenchmarkMeshLoading(int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	const auto& models = benchmarkModels;
 
-	auto skyPS = new SimplePixelShader(device, context);
-	skyPS->LoadShaderFile(L"SkyPS.cso");
-	pixelShaders.insert(PixelShaderMapType("sky", skyPS));
+	double parseMs = 0, cacheMs = 0;
+	size_t parsedVertices = 0, cachedVertices = 0;
+	for (auto& model : models)
+	{
+		std::string cachePath = MeshCache::GetCachePath(model.path);
+		MeshCache cache;
+		if (!cache.Open(cachePath, model.path))
+			MeshCache::Write(cachePath, model.path, GetCacheEntries(CookMeshes(model.path, model.read)));
 
-	auto waterVS = new SimpleVertexShader(device, context);
-	waterVS->LoadShaderFile(L"VS_WaterShader.cso");
-	vertexShaders.insert(VertexShaderMapType("water", waterVS));
+		for (int n = 0; n < iterations; n++)
+		{
+			auto start = Clock::now();
+			auto cooked = CookMeshes(model.path, model.read);
+			auto parsed = Clock::now();
+			MeshCache opened;
+			opened.Open(cachePath, model.path);
+			auto mapped = Clock::now();
+
+			parseMs += std::chrono::duration<double, std::milli>(parsed - start).count();
+			cacheMs += std::chrono::duration<double, std::milli>(mapped - parsed).count();
+			for (auto& mesh : cooked)
+				parsedVertices += mesh.vertices.size();
+			for (auto& entry : opened.GetEntries())
+				cachedVertices += entry.vertexCount;
+		}
+	}
 
-	auto waterPS = new SimplePixelShader(device, context);
-	waterPS->LoadShaderFile(L"PS_WaterShader.cso");
-	pixelShaders.insert(PixelShaderMapType("water", waterPS));
+	printf("\nMesh loading (%d files): parse, weld and tangents %.3f ms, mesh cache %.3f ms",
+		(int)(sizeof(models) / sizeof(models[0])), parseMs / iterations, cacheMs / iterations);
+	return parsedVertices == cachedVertices;
+}
 
-	// Refraction shaders
-	auto quadVS = new SimpleVertexShader(device, context);
-	quadVS->LoadShaderFile(L"FullscreenQuadVS.cso");
-	vertexShaders.insert(VertexShaderMapType("quad", quadVS));
+void Resources::BenchmarkVertexWeld(int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
 
-	auto quadPS = new SimplePixelShader(device, context);
-	quadPS->LoadShaderFile(L"FullscreenQuadPS.cso");
-	pixelShaders.insert(PixelShaderMapType("quad", quadPS));
+	double readMs = 0, weldMs = 0;
+	size_t readVertices = 0, weldedVertices = 0, indexCount = 0;
+	for (int n = 0; n < iterations; n++)
+	{
+		readVertices = weldedVertices = indexCount = 0;
+		for (auto& model : benchmarkModels)
+		{
+			auto start = Clock::now();
+			auto meshes = model.read(model.path);
+			auto read = Clock::now();
+			for (auto& mesh : meshes)
+			{
+				readVertices += mesh.vertices.size();
+				weldedVertices += WeldVertices(mesh.vertices, mesh.indices);
+				indexCount += mesh.indices.size();
+			}
+			auto welded = Clock::now();
+
+			readMs += std::chrono::duration<double, std::milli>(read - start).count();
+			weldMs += std::chrono::duration<double, std::milli>(welded - read).count();
+		}
+	}
 
-	auto refractVS = new SimpleVertexShader(device, context);
-	refractVS->LoadShaderFile(L"RefractVS.cso");
-	vertexShaders.insert(VertexShaderMapType("refraction", refractVS));
-
-	auto refractPS = new SimplePixelShader(device, context);
-	refractPS->LoadShaderFile(L"RefractPS.cso");
-	pixelShaders.insert(PixelShaderMapType("refraction", refractPS));
-
-	auto shadowVS = new SimpleVertexShader(device, context);
-	shadowVS->LoadShaderFile(L"VS_Shadow.cso");
-	vertexShaders.insert(VertexShaderMapType("shadow", shadowVS));
-
-	auto shadowVSInstanced = new SimpleVertexShader(device, context);
-	shadowVSInstanced->LoadShaderFile(L"ShadowVSInstanced.cso");
-	vertexShaders.insert(VertexShaderMapType("shadowInstanced", shadowVSInstanced));
-
-	auto shadowPS = new SimplePixelShader(device, context);
-	shadowPS->LoadShaderFile(L"PS_Shadow.cso");
-	pixelShaders.insert(PixelShaderMapType("shadow", shadowPS));
-
-	auto postPS = new SimplePixelShader(device, context);
-	postPS->LoadShaderFile(L"PostPS.cso");
-	pixelShaders.insert(PixelShaderMapType("post", postPS));
-
-	auto preShadowVS = new SimpleVertexShader(device, context);
-	preShadowVS->LoadShaderFile(L"PreShadowVS.cso");
-	vertexShaders.insert(VertexShaderMapType("preShadow", preShadowVS));
-
-	auto treeVS = new SimpleVertexShader(device, context);
-	treeVS->LoadShaderFile(L"TreeVS.cso");
-	vertexShaders.insert(VertexShaderMapType("tree", treeVS));
-
-	auto bloomExtractPS = new SimplePixelShader(device, context);
-	bloomExtractPS->LoadShaderFile(L"BloomExtractPS.cso");
-	pixelShaders.insert(PixelShaderMapType("bloomExtract", bloomExtractPS));
-
-	auto blurPS = new SimplePixelShader(device, context);
-	blurPS->LoadShaderFile(L"BlurPS.cso");
-	pixelShaders.insert(PixelShaderMapType("blur", blurPS));
-
-	auto bloomPS = new SimplePixelShader(device, context);
-	bloomPS->LoadShaderFile(L"BloomPS.cso");
-	pixelShaders.insert(PixelShaderMapType("bloom", bloomPS));
-
-	auto dofPS = new SimplePixelShader(device, context);
-	dofPS->LoadShaderFile(L"DepthOfFieldPS.cso");
-	pixelShaders.insert(PixelShaderMapType("dof", dofPS));
-
-	auto terrainPS = new SimplePixelShader(device, context);
-	terrainPS->LoadShaderFile(L"TerrainPS.cso");
-	pixelShaders.insert(PixelShaderMapType("terrain", terrainPS));
-
-	auto terrainVS = new SimpleVertexShader(device, context);
-	terrainVS->LoadShaderFile(L"TerrainVS.cso");
-	vertexShaders.insert(VertexShaderMapType("terrain", terrainVS));
-
-	auto particlePS = new SimplePixelShader(device, context);
-	particlePS->LoadShaderFile(L"ParticlePS.cso");
-	pixelShaders.insert(PixelShaderMapType("particle", particlePS));
-
-	auto particleVS = new SimpleVertexShader(device, context);
-	particleVS->LoadShaderFile(L"ParticleVS.cso");
-	vertexShaders.insert(VertexShaderMapType("particle", particleVS));
-
-	auto animationVS = new SimpleVertexShader(device, context);
-	animationVS->LoadShaderFile(L"AnimationVS.cso");
-	vertexShaders.insert(VertexShaderMapType("animation", animationVS));
-
-	auto animationPS = new SimplePixelShader(device, context);
-	animationPS->LoadShaderFile(L"AnimationPS.cso");
-	pixelShaders.insert(PixelShaderMapType("animation", animationPS));
-
-	auto lfThresholdPS = new SimplePixelShader(device, context);
-	lfThresholdPS->LoadShaderFile(L"LFThresholdPS.cso");
-	pixelShaders.insert(PixelShaderMapType("lensFlareThreshold", lfThresholdPS));
-
-
-	auto ghostGenPS = new SimplePixelShader(device, context);
-	ghostGenPS->LoadShaderFile(L"GhostGenerationPS.cso");
-	pixelShaders.insert(PixelShaderMapType("ghostGen", ghostGenPS));
-
-	auto lensFlarePS = new SimplePixelShader(device, context);
-	lensFlarePS->LoadShaderFile(L"LensFlarePS.cso");
-	pixelShaders.insert(PixelShaderMapType("lensFlare", lensFlarePS));
-
-
-	//Load Materials
-	materials.insert(MaterialMapType("terrain", new Material(shadowVS, terrainPS, nullptr, sampler)));
-	materials.insert(MaterialMapType("metal", new Material(shadowVS, shadowPS, shaderResourceViews["metal"], shaderResourceViews["metalNormal"], shaderResourceViews["metalSpecular"], sampler)));
-	materials.insert(MaterialMapType("fabric", new Material(vertexShader, pixelShader, shaderResourceViews["fabric"], shaderResourceViews["fabricNormal"], sampler)));
-	materials.insert(MaterialMapType("wood", new Material(vertexShader, pixelShader, shaderResourceViews["wood"], shaderResourceViews["woodNormal"], sampler)));
-	materials.insert(MaterialMapType("grass", new Material(vertexShader, pixelShader, shaderResourceViews["grass"], shaderResourceViews["grassNormal"], shaderResourceViews["grassSpecular"], sampler)));
-	materials.insert(MaterialMapType("grassTerrain", new Material(terrainVS, terrainPS, shaderResourceViews["grass"], shaderResourceViews["grassNormal"], shaderResourceViews["grassSpecular"], sampler)));
-	materials.insert(MaterialMapType("spear", new Material(vertexShader, pixelShader, shaderResourceViews["spear"], shaderResourceViews["spearNormal"], sampler)));
-	materials.insert(MaterialMapType("boat", new Material(shadowVS, shadowPS, shaderResourceViews["boat"], shaderResourceViews["boatNormal"], sampler)));
-	materials.insert(MaterialMapType("water", new Material(waterVS, waterPS, shaderResourceViews["waterColor"], shaderResourceViews["waterNormal"], sampler)));
-	materials.insert(MaterialMapType("tuna", new Material(vertexShader, pixelShader, shaderResourceViews["tuna"], shaderResourceViews["defaultNormal"], sampler)));
-	materials.insert(MaterialMapType("fish", new Material(vertexShader, pixelShader, shaderResourceViews["fishTexture"], shaderResourceViews["fishNormal"], sampler)));
-
-	//Load Meshes
-	meshes.insert(std::pair<std::string, Mesh*>("sphere", new Mesh("../../Assets/Models/sphere.obj", device)));
-	meshes.insert(std::pair<std::string, Mesh*>("cone", new Mesh("../../Assets/Models/cone.obj", device)));
-	meshes.insert(std::pair<std::string, Mesh*>("cylinder", new Mesh("../../Assets/Models/cylinder.obj", device)));
-	meshes.insert(std::pair<std::string, Mesh*>("cube", new Mesh("../../Assets/Models/cube.obj", device)));
-	meshes.insert(std::pair<std::string, Mesh*>("helix", new Mesh("../../Assets/Models/helix.obj", device)));
-	meshes.insert(std::pair<std::string, Mesh*>("torus", new Mesh("../../Assets/Models/torus.obj", device)));
-	meshes.insert(std::pair<std::string, Mesh*>("spear", new Mesh("../../Assets/Models/spear.obj", device)));
-	meshes.insert(std::pair<std::string, Mesh*>("boat", new Mesh("../../Assets/Models/boat.obj", device)));
-	meshes.insert(std::pair<std::string, Mesh*>("tuna", new Mesh("../../Assets/Models/tuna.obj", device)));
-
-	objl::Loader loader;
-	loader.LoadFile("../../Assets/Models/palm_tree.obj");
-	AddToMeshMap(loader, meshes, device, "palm", shaderResourceViews, true);
-	materials.insert(MaterialMapType("palm", new Material(treeVS, pixelShader, shaderResourceViews["palm"], shaderResourceViews["defaultNormal"], sampler)));
-	materials.insert(MaterialMapType("palm_2", new Material(treeVS, pixelShader, shaderResourceViews["palm_2"], shaderResourceViews["defaultNormal"], sampler)));
-
-	loader.LoadFile("../../Assets/Models/fish01.obj");
-	AddToMeshMap(loader, meshes, device, "", shaderResourceViews, false);
-
-
-	// Animated fish data
-
-	fishFBX.LoadNodes(fishFBX.scene->GetRootNode(), device);
-	int numChildren = fishFBX.scene->GetRootNode()->GetChildCount();
-	FbxNode* childNode = fishFBX.scene->GetRootNode()->GetChild(1);
-	FbxString name1 = childNode->GetName();
-	meshes.insert(std::pair<std::string, Mesh*>("ruddFish", fishFBX.GetMesh(childNode, device)));
-	materials.insert(MaterialMapType("ruddFish", new Material(animationVS, animationPS, shaderResourceViews["ruddTexture"], shaderResourceViews["ruddNormal"], sampler)));
+	printf("\nVertex welding (%d files, %d indices): %d -> %d vertices (%.0f%% fewer, %.1f KB less to upload), read %.3f ms, weld %.3f ms",
+		(int)(sizeof(benchmarkModels) / sizeof(benchmarkModels[0])), (int)indexCount, (int)readVertices, (int)weldedVertices,
+		readVertices ? 100.0 * (readVertices - weldedVertices) / readVertices : 0.0,
+		(readVertices - weldedVertices) * sizeof(Vertex) / 1024.0,
+		readMs / iterations, weldMs / iterations);
 }
 
-ID3D11ShaderResourceView * Resources::GetSRV(std::string name)
+void Resources::BenchmarkMeshOptimization()
 {
-	return shaderResourceViews[name];
-}
+	typedef std::chrono::high_resolution_clock Clock;
 
-Resources::Resources(ID3D11Device *device, ID3D11DeviceContext *context, IDXGISwapChain* swapChain)
-{
-	this->device = device;
-	this->context = context;
-	this->swapChain = swapChain;
-	mInstance = this;
-}
+	// Everything in Assets/Models, including the models nothing loads yet
+	std::vector<BenchmarkModel> models(std::begin(benchmarkModels), std::end(benchmarkModels));
+	models.push_back({ "../../Assets/Models/spear2.obj", ReadObjlMeshes });
+	models.push_back({ "../../Assets/Models/plane.obj", ReadObjlMeshes });
 
+	printf("\nMesh optimization (%d entry FIFO cache), ACMR and ATVR in file order -> optimized:", VERTEX_CACHE_SIZE);
+	for (auto& model : models)
+	{
+		auto meshes = model.read(model.path);
+		size_t triangles = 0;
+		double before[2] = {}, after[2] = {}, optimizeMs = 0;
+		for (auto& mesh : meshes)
+		{
+			WeldVertices(mesh.vertices, mesh.indices);
+			VertexCacheStats stats = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), (unsigned int)mesh.vertices.size());
+			size_t meshTriangles = mesh.indices.size() / 3;
+			before[0] += stats.acmr * meshTriangles;
+			before[1] += stats.atvr * mesh.vertices.size();
+
+			auto start = Clock::now();
+			OptimizeMesh(mesh.vertices, mesh.indices);
+			optimizeMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			stats = AnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), (unsigned int)mesh.vertices.size());
+			after[0] += stats.acmr * meshTriangles;
+			after[1] += stats.atvr * mesh.vertices.size();
+			triangles += meshTriangles;
+		}
 
-Resources::~Resources()
-{
-	for (auto it : meshes)delete it.second;
-	for (auto it : materials)delete it.second;
-	for (auto it : shaderResourceViews)it.second->Release();
-	for (auto it : pixelShaders)delete it.second;
-	for (auto it : vertexShaders)delete it.second;
-	sampler->Release();
+		size_t vertices = 0;
+		for (auto& mesh : meshes)
+			vertices += mesh.vertices.size();
+		std::string name = model.path;
+		name = name.substr(name.find_last_of('/') + 1);
+		printf("\n  %-14s %6d triangles: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %.3f ms", name.c_str(), (int)triangles,
+			triangles ? before[0] / triangles : 0.0, triangles ? after[0] / triangles : 0.0,
+			vertices ? before[1] / vertices : 0.0, vertices ? after[1] / vertices : 0.0, optimizeMs);
+	}
 }
@@ -2,27 +2,50 @@
 
 #include "Mesh.h"
 #include "Material.h"
-#include <map>
 #include <string>
 #include <d3d11.h>
 #include "WICTextureLoader.h"
 #include "SimpleShader.h"
 #include "FBXLoader.h"
+#include "ResourceRegistry.h"
+#include "AssetManifest.h"
+#include <memory>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
 
+#define ASSET_MANIFEST_PATH "../../Assets/Manifest.txt"
 
-//Map pair types
-typedef std::pair<std::string, Mesh*> MeshMapType;
-typedef std::pair<std::string, Material*> MaterialMapType;
-typedef std::pair<std::string, ID3D11ShaderResourceView*> SRVMapType;
-typedef std::pair<std::string, SimpleVertexShader*> VertexShaderMapType;
-typedef std::pair<std::string, SimplePixelShader*> PixelShaderMapType;
+class JobSystem;
+struct LoadedAsset;
 
-//Map types
-typedef std::map<std::string, SimpleVertexShader*> VertexShaderMap;
-typedef std::map<std::string, SimplePixelShader*> PixelShaderMap;
-typedef std::map<std::string, ID3D11ShaderResourceView*> SRVMap;
-typedef std::map<std::string, Mesh*> MeshMap;
-typedef std::map<std::string, Material*> MaterialMap;
+
+typedef ResourceRegistry<Mesh> MeshRegistry;
+typedef ResourceRegistry<Material> MaterialRegistry;
+typedef ResourceRegistry<ID3D11ShaderResourceView> SRVRegistry;
+typedef ResourceRegistry<SimpleVertexShader> VertexShaderRegistry;
+typedef ResourceRegistry<SimplePixelShader> PixelShaderRegistry;
+
+typedef MeshRegistry::Handle MeshHandle;
+typedef MaterialRegistry::Handle MaterialHandle;
+typedef SRVRegistry::Handle SRVHandle;
+typedef VertexShaderRegistry::Handle VertexShaderHandle;
+typedef PixelShaderRegistry::Handle PixelShaderHandle;
+
+//------------------------------------------------
+// Assets that finish loading together, as the
+// manifest groups them
+//------------------------------------------------
+struct AssetGroup
+{
+	std::string name;
+	int unfinished;						// Assets not in the registries yet
+	std::vector<AssetEntry> materials;	// Made once everything else is in
+	std::promise<void> loaded;
+	std::shared_future<void> future;
+};
 
 class Resources
 {
@@ -30,19 +53,70 @@ class Resources
 	ID3D11Device *device;
 	ID3D11DeviceContext *context;
 	IDXGISwapChain* swapChain;
+
+	JobSystem* jobs;
+	std::vector<AssetGroup> groups;
+	std::chrono::high_resolution_clock::time_point loadStart;
+
+	// Read by a worker and waiting for ProcessUploads
+	std::deque<std::unique_ptr<LoadedAsset>> finished;
+	std::mutex finishedMutex;
+	std::condition_variable finishedCondition;
+	int reading;	// Started but not in finished yet, guarded by finishedMutex
+
+	void StartLoading(const AssetEntry& entry, int group);
+	void Upload(LoadedAsset& asset);
+	void FinishGroup(AssetGroup& group);
+	void CreateMaterial(const AssetEntry& entry);
 public:
 	ID3D11SamplerState *sampler;
-	MeshMap meshes;
-	MaterialMap materials;
-	SRVMap shaderResourceViews;
-	VertexShaderMap vertexShaders;
-	PixelShaderMap pixelShaders;
+	MeshRegistry meshes;
+	MaterialRegistry materials;
+	SRVRegistry shaderResourceViews;
+	VertexShaderRegistry vertexShaders;
+	PixelShaderRegistry pixelShaders;
 	static Resources* GetInstance();
-	void LoadResources();
+
+	// Reads the manifest and starts everything in it loading on the
+	// job system. Nothing is in the registries until ProcessUploads
+	// has run for it, wait for the group before looking anything up.
+	// False if the manifest can't be read, then nothing is loaded.
+	bool LoadResources(JobSystem* jobs, const std::string& manifestPath = ASSET_MANIFEST_PATH);
+
+	// Makes the device objects for whatever the workers have finished
+	// reading, all in one go. Call it on the main thread every frame
+	// while anything is still loading.
+	void ProcessUploads();
+
+	// Ready once everything in the group is in the registries
+	std::shared_future<void> GetGroup(const std::string& name);
+	static bool IsLoaded(const std::shared_future<void>& group);
+
+	// Processes uploads until the group has loaded, or until nothing
+	// is left to read and it still hasn't
+	void Wait(const std::shared_future<void>& group);
+
 	ID3D11ShaderResourceView* GetSRV(std::string name);
 	Resources(ID3D11Device *device, ID3D11DeviceContext *context, IDXGISwapChain* swapChain);
 	~Resources();
 
-	FBXLoader fishFBX;
+	// Times a handle lookup against the string keyed map it replaced.
+	// False if they found different things.
+	static bool BenchmarkLookups(int resourceCount, int iterations);
+
+	// Times parsing the OBJ models and calculating their tangents
+	// against opening their mesh caches. Nothing goes to the GPU.
+	// False if the caches hold different meshes than the models.
+	static bool BenchmarkMeshLoading(int iterations);
+
+	// Reads the OBJ models and times welding their vertices, printing
+	// how many vertices the weld saves
+	static void BenchmarkVertexWeld(int iterations);
+
+	// Simulates the post-transform cache on every OBJ in Assets/Models,
+	// before and after OptimizeMesh
+	static void BenchmarkMeshOptimization();
+
+	std::unique_ptr<FBXLoader> fishFBX;
 };
 
@@ -3,6 +3,8 @@
 /// </summary>
 /// 
 #include "SimpleShader.h"
+#include <chrono>
+#include <cstdio>
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
@@ -16,6 +18,7 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 	// Save the device
 	this->device = device;
 	this->deviceContext = context;
+	commandList = 0;
 
 	// Set up fields
 	constantBufferCount = 0;
@@ -59,6 +62,7 @@ void ISimpleShader::CleanUp()
 		delete samplerStates[i];
 
 	// Clean up tables
+	variables.clear();
 	varTable.clear();
 	cbTable.clear();
 	samplerTable.clear();
@@ -77,12 +81,28 @@ void ISimpleShader::CleanUp()
 bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 {
 	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
+	ID3DBlob* blob;
+	HRESULT hr = D3DReadFileToBlob(shaderFile, &blob);
 	if (hr != S_OK)
 	{
 		return false;
 	}
 
+	return LoadShaderBlob(blob);
+}
+
+// --------------------------------------------------------
+// Creates the shader from compiled code that has already
+// been read, so the file can be read on another thread.
+//
+// blob - The compiled shader, which this shader now owns
+// 
+// Returns true if shader is loaded properly, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::LoadShaderBlob(ID3DBlob* blob)
+{
+	shaderBlob = blob;
+
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
 	shaderValid = CreateShader(shaderBlob);
@@ -180,6 +200,8 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 		constantBuffers[b].Size = bufferDesc.Size;
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
 		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		constantBuffers[b].Dirty = true;
+		constantBuffers[b].External = false;
 
 		// Loop through all variables in this buffer
 		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
@@ -202,7 +224,8 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 			std::string varName(varDesc.Name);
 
 			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			varTable.insert(std::pair<std::string, unsigned int>(varName, (unsigned int)variables.size()));
+			variables.push_back(varStruct);
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
@@ -222,7 +245,7 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
+	std::unordered_map<std::string, unsigned int>::iterator result =
 		varTable.find(name);
 
 	// Did we find the key?
@@ -230,7 +253,7 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 		return 0;
 
 	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	SimpleShaderVariable* var = &variables[result->second];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -283,13 +306,33 @@ void ISimpleShader::CopyAllBufferData()
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
+		CopyBufferData(&constantBuffers[i]);
 	}
 }
 
+// --------------------------------------------------------
+// Uploads a buffer if anything in it changed. D3D 11.0
+// can't update part of a constant buffer, so a changed
+// buffer always goes up whole.
+// --------------------------------------------------------
+void ISimpleShader::CopyBufferData(SimpleConstantBuffer* cb)
+{
+	if (!cb->Dirty || cb->External)
+		return;
+
+	if (commandList)
+	{
+		commandList->UpdateConstants(cb->ConstantBuffer, cb->LocalDataBuffer, cb->Size);
+		cb->Dirty = false;
+		return;
+	}
+
+	deviceContext->UpdateSubresource(
+		cb->ConstantBuffer, 0, 0,
+		cb->LocalDataBuffer, 0, 0);
+	cb->Dirty = false;
+}
+
 // --------------------------------------------------------
 // Copies local data to the shader's specified constant buffer
 //
@@ -315,9 +358,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	CopyBufferData(cb);
 }
 
 // --------------------------------------------------------
@@ -337,12 +378,36 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	CopyBufferData(cb);
 }
 
 
+// --------------------------------------------------------
+// Swaps in a buffer owned by someone else. It is held
+// like our own, so clean up releases it the same way.
+//
+// Returns false if the shader has no buffer of that name
+// or it is a different size
+// --------------------------------------------------------
+bool ISimpleShader::SetExternalConstantBuffer(std::string bufferName, ID3D11Buffer* buffer)
+{
+	SimpleConstantBuffer* cb = FindConstantBuffer(bufferName);
+	if (!cb || !buffer)
+		return false;
+
+	D3D11_BUFFER_DESC desc;
+	buffer->GetDesc(&desc);
+	if (desc.ByteWidth != cb->Size)
+		return false;
+
+	buffer->AddRef();
+	cb->ConstantBuffer->Release();
+	cb->ConstantBuffer = buffer;
+	cb->External = true;
+	cb->Dirty = false;
+	return true;
+}
+
 // --------------------------------------------------------
 // Sets a variable by name with arbitrary data of the specified size
 //
@@ -360,11 +425,15 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 	if (var == 0)
 		return false;
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	// Set the data in the local data buffer, the buffer only
+	// needs another upload if this actually changed it
+	SimpleConstantBuffer* cb = &constantBuffers[var->ConstantBufferIndex];
+	unsigned char* destination = cb->LocalDataBuffer + var->ByteOffset;
+	if (memcmp(destination, data, size) != 0)
+	{
+		memcpy(destination, data, size);
+		cb->Dirty = true;
+	}
 
 	// Success
 	return true;
@@ -450,6 +519,121 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 dat
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Looks up a variable once so it can be set by handle
+//
+// Returns SIMPLE_SHADER_INVALID_HANDLE if there is no
+// variable with that name
+// --------------------------------------------------------
+int ISimpleShader::GetVariableHandle(std::string name)
+{
+	std::unordered_map<std::string, unsigned int>::iterator result =
+		varTable.find(name);
+	if (result == varTable.end())
+		return SIMPLE_SHADER_INVALID_HANDLE;
+
+	return (int)result->second;
+}
+
+// --------------------------------------------------------
+// Resource handles are the registers they are bound to
+// --------------------------------------------------------
+int ISimpleShader::GetShaderResourceViewHandle(std::string name)
+{
+	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
+	return srvInfo ? (int)srvInfo->BindIndex : SIMPLE_SHADER_INVALID_HANDLE;
+}
+
+int ISimpleShader::GetSamplerHandle(std::string name)
+{
+	const SimpleSampler* sampInfo = GetSamplerInfo(name);
+	return sampInfo ? (int)sampInfo->BindIndex : SIMPLE_SHADER_INVALID_HANDLE;
+}
+
+// --------------------------------------------------------
+// Sets a variable by handle with arbitrary data of the
+// specified size, same rules as setting it by name
+// --------------------------------------------------------
+bool ISimpleShader::SetData(int handle, const void* data, unsigned int size)
+{
+	if (handle < 0 || handle >= (int)variables.size())
+		return false;
+
+	SimpleShaderVariable* var = &variables[handle];
+	if (var->Size != size)
+		return false;
+
+	SimpleConstantBuffer* cb = &constantBuffers[var->ConstantBufferIndex];
+	unsigned char* destination = cb->LocalDataBuffer + var->ByteOffset;
+	if (memcmp(destination, data, size) != 0)
+	{
+		memcpy(destination, data, size);
+		cb->Dirty = true;
+	}
+	return true;
+}
+
+bool ISimpleShader::SetInt(int handle, int data)
+{
+	return SetData(handle, &data, sizeof(int));
+}
+
+bool ISimpleShader::SetFloat(int handle, float data)
+{
+	return SetData(handle, &data, sizeof(float));
+}
+
+bool ISimpleShader::SetFloat3(int handle, const DirectX::XMFLOAT3& data)
+{
+	return SetData(handle, &data, sizeof(float) * 3);
+}
+
+bool ISimpleShader::SetFloat4(int handle, const DirectX::XMFLOAT4& data)
+{
+	return SetData(handle, &data, sizeof(float) * 4);
+}
+
+bool ISimpleShader::SetMatrix4x4(int handle, const DirectX::XMFLOAT4X4& data)
+{
+	return SetData(handle, &data, sizeof(float) * 16);
+}
+
+// --------------------------------------------------------
+// Sets the same variable by name and by handle and
+// prints the time per call for each. The value changes
+// every call, so both go through the full copy.
+// --------------------------------------------------------
+void ISimpleShader::BenchmarkHandles(std::string name, int iterations)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	const SimpleShaderVariable* var = FindVariable(name, -1);
+	if (var == 0)
+		return;
+
+	std::vector<unsigned char> data(var->Size);
+	int handle = GetVariableHandle(name);
+
+	auto start = Clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		data[0] = (unsigned char)i;
+		SetData(name, data.data(), var->Size);
+	}
+	auto named = Clock::now();
+	for (int i = 0; i < iterations; i++)
+	{
+		data[0] = (unsigned char)i;
+		SetData(handle, data.data(), var->Size);
+	}
+	auto handled = Clock::now();
+
+	double nameNs = std::chrono::duration<double, std::nano>(named - start).count() / iterations;
+	double handleNs = std::chrono::duration<double, std::nano>(handled - named).count() / iterations;
+	printf("\nShader setter \"%s\" (%u bytes): by name %.1f ns, by handle %.1f ns",
+		name.c_str(), var->Size, nameNs, handleNs);
+}
+
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
@@ -679,6 +863,11 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
 		refl->GetInputParameterDesc(i, &paramDesc);
 
+		// System generated values (SV_VertexID, SV_InstanceID) are
+		// not part of any vertex buffer
+		if (paramDesc.SystemValueType != D3D_NAME_UNDEFINED)
+			continue;
+
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
 		std::string sem = paramDesc.SemanticName;
@@ -736,6 +925,13 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		inputLayoutDesc.push_back(elementDesc);
 	}
 
+	// Nothing to read from vertex buffers, so no layout is needed
+	if (inputLayoutDesc.empty())
+	{
+		refl->Release();
+		return true;
+	}
+
 	// Try to create Input Layout
 	HRESULT hr = device->CreateInputLayout(
 		&inputLayoutDesc[0], 
@@ -758,6 +954,15 @@ void SimpleVertexShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 
+	if (commandList)
+	{
+		commandList->SetInputLayout(inputLayout);
+		commandList->SetVertexShader(shader);
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+			commandList->SetConstantBuffer(CommandStage::Vertex, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		return;
+	}
+
 	// Set the shader and input layout
 	deviceContext->IASetInputLayout(inputLayout);
 	deviceContext->VSSetShader(shader, 0, 0);
@@ -788,7 +993,10 @@ bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderRes
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (commandList)
+		commandList->SetShaderResource(CommandStage::Vertex, srvInfo->BindIndex, srv);
+	else
+		deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -810,12 +1018,42 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 		return false;
 
 	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (commandList)
+		commandList->SetSampler(CommandStage::Vertex, sampInfo->BindIndex, samplerState);
+	else
+		deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view or sampler by handle
+// --------------------------------------------------------
+bool SimpleVertexShader::SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv)
+{
+	if (handle < 0)
+		return false;
+
+	if (commandList)
+		commandList->SetShaderResource(CommandStage::Vertex, handle, srv);
+	else
+		deviceContext->VSSetShaderResources(handle, 1, &srv);
+	return true;
+}
+
+bool SimpleVertexShader::SetSamplerState(int handle, ID3D11SamplerState* samplerState)
+{
+	if (handle < 0)
+		return false;
+
+	if (commandList)
+		commandList->SetSampler(CommandStage::Vertex, handle, samplerState);
+	else
+		deviceContext->VSSetSamplers(handle, 1, &samplerState);
+	return true;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ SIMPLE PIXEL SHADER -------------------------------------------------
@@ -880,6 +1118,14 @@ void SimplePixelShader::SetShaderAndCBs()
 	// Is shader valid?
 	if (!shaderValid) return;
 	
+	if (commandList)
+	{
+		commandList->SetPixelShader(shader);
+		for (unsigned int i = 0; i < constantBufferCount; i++)
+			commandList->SetConstantBuffer(CommandStage::Pixel, constantBuffers[i].BindIndex, constantBuffers[i].ConstantBuffer);
+		return;
+	}
+
 	// Set the shader
 	deviceContext->PSSetShader(shader, 0, 0);
 
@@ -909,7 +1155,10 @@ bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderReso
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	if (commandList)
+		commandList->SetShaderResource(CommandStage::Pixel, srvInfo->BindIndex, srv);
+	else
+		deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
 
 	// Success
 	return true;
@@ -931,12 +1180,42 @@ bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* sa
 		return false;
 
 	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	if (commandList)
+		commandList->SetSampler(CommandStage::Pixel, sampInfo->BindIndex, samplerState);
+	else
+		deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
 
 	// Success
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view or sampler by handle
+// --------------------------------------------------------
+bool SimplePixelShader::SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv)
+{
+	if (handle < 0)
+		return false;
+
+	if (commandList)
+		commandList->SetShaderResource(CommandStage::Pixel, handle, srv);
+	else
+		deviceContext->PSSetShaderResources(handle, 1, &srv);
+	return true;
+}
+
+bool SimplePixelShader::SetSamplerState(int handle, ID3D11SamplerState* samplerState)
+{
+	if (handle < 0)
+		return false;
+
+	if (commandList)
+		commandList->SetSampler(CommandStage::Pixel, handle, samplerState);
+	else
+		deviceContext->PSSetSamplers(handle, 1, &samplerState);
+	return true;
+}
+
 
 
 
@@ -1060,6 +1339,27 @@ bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view or sampler by handle
+// --------------------------------------------------------
+bool SimpleDomainShader::SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv)
+{
+	if (handle < 0)
+		return false;
+
+	deviceContext->DSSetShaderResources(handle, 1, &srv);
+	return true;
+}
+
+bool SimpleDomainShader::SetSamplerState(int handle, ID3D11SamplerState* samplerState)
+{
+	if (handle < 0)
+		return false;
+
+	deviceContext->DSSetSamplers(handle, 1, &samplerState);
+	return true;
+}
+
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -1182,6 +1482,27 @@ bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* sam
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view or sampler by handle
+// --------------------------------------------------------
+bool SimpleHullShader::SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv)
+{
+	if (handle < 0)
+		return false;
+
+	deviceContext->HSSetShaderResources(handle, 1, &srv);
+	return true;
+}
+
+bool SimpleHullShader::SetSamplerState(int handle, ID3D11SamplerState* samplerState)
+{
+	if (handle < 0)
+		return false;
+
+	deviceContext->HSSetSamplers(handle, 1, &samplerState);
+	return true;
+}
+
 
 
 
@@ -1426,6 +1747,27 @@ bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState*
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view or sampler by handle
+// --------------------------------------------------------
+bool SimpleGeometryShader::SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv)
+{
+	if (handle < 0)
+		return false;
+
+	deviceContext->GSSetShaderResources(handle, 1, &srv);
+	return true;
+}
+
+bool SimpleGeometryShader::SetSamplerState(int handle, ID3D11SamplerState* samplerState)
+{
+	if (handle < 0)
+		return false;
+
+	deviceContext->GSSetSamplers(handle, 1, &samplerState);
+	return true;
+}
+
 // --------------------------------------------------------
 // Calculates the number of components specified by a parameter description mask
 //
@@ -1664,6 +2006,27 @@ bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState*
 	return true;
 }
 
+// --------------------------------------------------------
+// Sets a shader resource view or sampler by handle
+// --------------------------------------------------------
+bool SimpleComputeShader::SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv)
+{
+	if (handle < 0)
+		return false;
+
+	deviceContext->CSSetShaderResources(handle, 1, &srv);
+	return true;
+}
+
+bool SimpleComputeShader::SetSamplerState(int handle, ID3D11SamplerState* samplerState)
+{
+	if (handle < 0)
+		return false;
+
+	deviceContext->CSSetSamplers(handle, 1, &samplerState);
+	return true;
+}
+
 // --------------------------------------------------------
 // Sets an unordered access view in the Compute shader stage
 //
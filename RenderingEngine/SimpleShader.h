@@ -14,6 +14,7 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include "CommandList.h"
 
 // --------------------------------------------------------
 // Used by simple shaders to store information about
@@ -39,6 +40,8 @@ struct SimpleConstantBuffer
 	ID3D11Buffer* ConstantBuffer;
 	unsigned char* LocalDataBuffer;
 	std::vector<SimpleShaderVariable> Variables;
+	bool Dirty;	// Local data differs from what was last uploaded
+	bool External;	// Owned and filled in by someone else, never uploaded from here
 };
 
 // --------------------------------------------------------
@@ -59,6 +62,10 @@ struct SimpleSampler
 	unsigned int BindIndex; // The register of the Sampler
 };
 
+// Returned for names the shader doesn't have. Setting
+// through it does nothing.
+#define SIMPLE_SHADER_INVALID_HANDLE -1
+
 // --------------------------------------------------------
 // Base abstract class for simplifying shader handling
 // --------------------------------------------------------
@@ -71,16 +78,30 @@ public:
 	// Initialization method (since we can't invoke derived class
 	// overrides in the base class constructor)
 	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadShaderBlob(ID3DBlob* blob);
 
 	// Simple helpers
 	bool IsShaderValid() { return shaderValid; }
 
-	// Activating the shader and copying data
+	// Activating the shader and copying data. Buffers whose
+	// data has not changed since the last copy are skipped.
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
 	void CopyBufferData(std::string bufferName);
 
+	// Binds a buffer filled in elsewhere in place of this shader's own
+	// buffer of that name, so several shaders can share one upload
+	bool SetExternalConstantBuffer(std::string bufferName, ID3D11Buffer* buffer);
+
+	// While a list is set, uploads and binds from the vertex and pixel
+	// shaders are recorded into it instead of going to the context.
+	// The other stages always go straight to the context. Values
+	// set on the shader are shared by every list, so only record
+	// one list at a time per shader, from one thread.
+	void SetCommandList(CommandList* list) { commandList = list; }
+	CommandList* GetCommandList() { return commandList; }
+
 	// Sets arbitrary shader data
 	bool SetData(std::string name, const void* data, unsigned int size);
 
@@ -99,6 +120,25 @@ public:
 	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
 	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
 
+	// Handles are looked up by name once, then used to set data
+	// without hashing or allocating a string on every call
+	int GetVariableHandle(std::string name);
+	int GetShaderResourceViewHandle(std::string name);
+	int GetSamplerHandle(std::string name);
+
+	bool SetData(int handle, const void* data, unsigned int size);
+	bool SetInt(int handle, int data);
+	bool SetFloat(int handle, float data);
+	bool SetFloat3(int handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(int handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(int handle, const DirectX::XMFLOAT4X4& data);
+
+	virtual bool SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv) = 0;
+	virtual bool SetSamplerState(int handle, ID3D11SamplerState* samplerState) = 0;
+
+	// Times setting a variable by name against setting it by handle
+	void BenchmarkHandles(std::string name, int iterations);
+
 	// Getting data about variables and resources
 	const SimpleShaderVariable* GetVariableInfo(std::string name);
 	
@@ -125,6 +165,7 @@ protected:
 	ID3DBlob* shaderBlob;
 	ID3D11Device* device;
 	ID3D11DeviceContext* deviceContext;
+	CommandList* commandList;
 
 	// Resource counts
 	unsigned int constantBufferCount;
@@ -134,7 +175,8 @@ protected:
 	std::vector<SimpleSRV*>		shaderResourceViews;
 	std::vector<SimpleSampler*>	samplerStates;
 	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+	std::vector<SimpleShaderVariable> variables;	// Indexed by handle
+	std::unordered_map<std::string, unsigned int> varTable;
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
@@ -147,6 +189,7 @@ protected:
 	// Helpers for finding data by name
 	SimpleShaderVariable* FindVariable(std::string name, int size);
 	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	void CopyBufferData(SimpleConstantBuffer* cb);
 };
 
 // --------------------------------------------------------
@@ -164,6 +207,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(int handle, ID3D11SamplerState* samplerState);
 
 protected:
 	bool perInstanceCompatible;
@@ -187,6 +232,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(int handle, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11PixelShader* shader;
@@ -207,6 +254,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(int handle, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11DomainShader* shader;
@@ -227,6 +276,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(int handle, ID3D11SamplerState* samplerState);
 
 protected:
 	ID3D11HullShader* shader;
@@ -247,6 +298,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(int handle, ID3D11SamplerState* samplerState);
 
 	bool CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount);
 
@@ -286,6 +339,8 @@ public:
 
 	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
 	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
+	bool SetShaderResourceView(int handle, ID3D11ShaderResourceView* srv);
+	bool SetSamplerState(int handle, ID3D11SamplerState* samplerState);
 	bool SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
 
 	int GetUnorderedAccessViewIndex(std::string name);
@@ -0,0 +1,309 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+using namespace DirectX;
+
+Simulation::Simulation()
+{
+	objects = {};
+	playerPosition = XMFLOAT3(0, 0, 0);
+	projectileHitWater = false;
+	splashCount = 0;
+	accumulator = 0.0f;
+	alpha = 1.0f;
+	elapsed = 0.0f;
+	time = previousTime = 0.0f;
+	translate = previousTranslate = 0.0f;
+}
+
+void Simulation::Initialize(const SimulationObjects& objects)
+{
+	this->objects = objects;
+}
+
+void Simulation::SetPlayerPosition(XMFLOAT3 position)
+{
+	playerPosition = position;
+}
+
+// -----------------------------------------------------
+// Long frames (breakpoints, dragging the window) are
+// clamped so we never spiral trying to catch up
+// -----------------------------------------------------
+int Simulation::Update(float deltaTime)
+{
+	accumulator += (std::min)(deltaTime, MAX_STEPS_PER_FRAME * FIXED_TIMESTEP);
+
+	// A spear in hand follows the camera every frame, so there is
+	// nothing to blend from until it is thrown
+	if (!objects.projectile->HasBeenShot())
+		objects.projectile->SaveState();
+
+	int steps = 0;
+	while (accumulator >= FIXED_TIMESTEP)
+	{
+		Step();
+		accumulator -= FIXED_TIMESTEP;
+		steps++;
+	}
+
+	alpha = accumulator / FIXED_TIMESTEP;
+	Interpolate();
+	return steps;
+}
+
+void Simulation::SaveState()
+{
+	previousTime = time;
+	previousTranslate = translate;
+	objects.fishes->SaveState();
+	objects.boat->SaveState();
+	objects.fish->SaveState();
+	objects.projectile->SaveState();
+}
+
+void Simulation::Interpolate()
+{
+	objects.fishes->Interpolate(alpha);
+	objects.boat->Interpolate(alpha);
+	objects.fish->Interpolate(alpha);
+	objects.projectile->Interpolate(objects.projectile->HasBeenShot() ? alpha : 1.0f);
+}
+
+// -----------------------------------------------------
+// One fixed step of everything that moves on its own.
+// Fish, the spear, splashes and ripples don't touch
+// each other, so they run as separate jobs. The hit
+// test moves fish and starts splashes and ripples,
+// so it waits for all of them.
+// -----------------------------------------------------
+void Simulation::Step()
+{
+	const float dt = FIXED_TIMESTEP;
+	SaveState();
+	elapsed += dt;
+
+	// Water
+	time += 0.05f * dt;
+	translate += 0.01f * dt;
+	if (translate > 1.0f)
+	{
+		translate -= 1.0f;
+	}
+
+	// Boat bobs on the waves
+	objects.boat->SetRotation(cos(elapsed) / 20, 180.f * XM_PI / 180, -sin(elapsed) / 20);
+	objects.boat->Update(dt, elapsed);
+
+	JobSystem* jobs = objects.jobs;
+	Job* fishJob = jobs->CreateJob([this, dt]() { UpdateFish(dt); });
+	Job* projectileJob = jobs->CreateJob([this, dt]() {
+		if (objects.projectile->HasBeenShot())
+			objects.projectile->Update(dt, elapsed);
+	});
+	Job* particleJob = jobs->CreateJob([this, dt]() { objects.particles->Update(dt); });
+	Job* rippleJob = jobs->CreateJob([this, dt]() { UpdateRipples(dt); });
+	Job* hitJob = jobs->CreateJob([this]() { CheckProjectile(); });
+
+	jobs->AddDependency(fishJob, hitJob);
+	jobs->AddDependency(projectileJob, hitJob);
+	jobs->AddDependency(particleJob, hitJob);
+	jobs->AddDependency(rippleJob, hitJob);
+
+	jobs->Run(hitJob);
+	jobs->Run(fishJob);
+	jobs->Run(projectileJob);
+	jobs->Run(particleJob);
+	jobs->Run(rippleJob);
+	jobs->Wait(hitJob);
+}
+
+void Simulation::UpdateFish(float dt)
+{
+	objects.fishes->Update(dt, elapsed);
+	float fishSpeed = 2.f;
+	objects.fish->Move(XMFLOAT3((sin(elapsed * 3) / 600), 0, fishSpeed * dt));
+	if (objects.fish->GetPosition().z >= 30.f)
+	{
+		objects.fish->SetPosition(9.f, -8.5f, -15.f);
+	}
+	objects.fish->Update(dt, elapsed);
+}
+
+//Delete ripples afterward if they are at max duration
+void Simulation::UpdateRipples(float dt)
+{
+	for (auto it = ripples.begin(); it != ripples.end(); ) {
+		(*it).Update(dt);
+		if ((*it).AtMaxDuration()) {
+			it = ripples.erase(it);
+		}
+		else {
+			it++;
+		}
+	}
+}
+
+// -----------------------------------------------------
+// Offset from the spear's center to its tip
+// -----------------------------------------------------
+static XMFLOAT3 GetTipPosition(ProjectileEntity &projectile) {
+	float tipDistance = projectile.GetBoundingBox().Extents.z;
+	XMVECTOR position = XMVectorSet(0, 0, -tipDistance, 0);	// Forward is -Z
+	XMFLOAT4 orientation = projectile.GetBoundingBox().Orientation;
+	XMVECTOR rot = XMLoadFloat4(&orientation);
+	XMVECTOR offset = XMVector3Rotate(position, rot);
+	XMFLOAT3 newOffset;
+	XMStoreFloat3(&newOffset, offset);
+
+	return newOffset;
+}
+
+// -----------------------------------------------------
+// Splash when the spear tip reaches the water, and
+// hand the spear back once it is lost or hits a fish
+// -----------------------------------------------------
+void Simulation::CheckProjectile()
+{
+	ProjectileEntity* projectile = objects.projectile;
+
+	// Spear tip is in the water if it is at most half a unit under the surface
+	XMFLOAT3 tipOffset = GetTipPosition(*projectile);
+	XMFLOAT3 position = projectile->GetPosition();
+	XMFLOAT3 tip;
+	XMStoreFloat3(&tip, XMLoadFloat3(&position) + XMLoadFloat3(&tipOffset));
+	float depth = objects.water->GetHeight(tip.x, tip.z, time) - tip.y;
+	bool hitWater = depth >= 0 && depth <= 0.5f;
+
+	if (hitWater && !projectileHitWater && projectile->HasBeenShot())
+	{
+		projectileHitWater = true;
+		splashCount++;
+		ripples.push_back(Ripple(tip.x, tip.y, tip.z, RIPPLE_DURATION));
+
+		objects.particles->CreateEmitter(
+			50,							// Max particles
+			100,							// Particles per second
+			0.5f,								// Particle lifetime
+			0.7f,							// Start size
+			0.1f,							// End size
+			XMFLOAT4(0.9f, 0.9f, 1.0f, 0.5f),	// Start color
+			XMFLOAT4(1, 1.0f, 1.0f, 0),		// End color
+			XMFLOAT3(0, 7.2f, 0),				// Start velocity
+			XMFLOAT3(0, -50, 0),				// Start acceleration
+			objects.splashTexture,
+			tip
+			);
+
+		if (onSplash)
+			onSplash(tip);
+	}
+
+	auto distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&position) - XMLoadFloat3(&playerPosition)));
+
+	if (fabsf(distance) > 50 || objects.fishes->CheckForCollision(projectile))
+	{
+		projectileHitWater = false;
+		projectile->SetHasBeenShot(false);
+		projectile->SetPosition(XMFLOAT3(playerPosition.x + 0.4f, playerPosition.y, playerPosition.z));
+	}
+}
+
+// -----------------------------------------------------
+// Blend between the last two steps. The translate
+// wraps at 1, so unwrap it before blending.
+// -----------------------------------------------------
+float Simulation::GetWaterTime()
+{
+	return previousTime + (time - previousTime) * alpha;
+}
+
+float Simulation::GetWaterTranslate()
+{
+	float current = translate < previousTranslate ? translate + 1.0f : translate;
+	float blended = previousTranslate + (current - previousTranslate) * alpha;
+	return blended > 1.0f ? blended - 1.0f : blended;
+}
+
+std::vector<Ripple>& Simulation::GetRipples()
+{
+	return ripples;
+}
+
+int Simulation::GetSplashCount()
+{
+	return splashCount;
+}
+
+// -----------------------------------------------------
+// Builds the same scene as the game with no meshes,
+// materials or device, keeps throwing the spear and
+// times the steps. Used for soak testing and profiling.
+// -----------------------------------------------------
+void Simulation::RunHeadless(int steps)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	Water water(50, 50);
+	water.SetPosition(-125, -6, -150);
+	water.CreateWaves();
+
+	FishController fishes(nullptr, nullptr,
+		5,
+		XMFLOAT3(9.f, -8.5f, -20.f),
+		XMFLOAT3(9.f, -8.5f, 35.f),
+		8,
+		XMFLOAT3(0, 90.f * XM_PI / 180, 0),
+		XMFLOAT3(0.03f, 0.03f, 0.03f));
+
+	JobSystem jobs;
+	ParticleSystem particles(nullptr, nullptr, nullptr, 4096, 64);
+	particles.SetJobSystem(&jobs);
+
+	ProjectileEntity projectile(nullptr, nullptr);
+	projectile.SetRotation(180 * XM_PI / 180, 0, 90 * XM_PI / 180);
+	projectile.SetPosition(0.4f, 3.f, -14.9f);
+	projectile.SetScale(1.5f, 1.5f, 1.5f);
+
+	Entity boat(nullptr, nullptr);
+	boat.SetScale(0.6f, 0.6f, 0.6f);
+	boat.SetPosition(0.f, -5.0f, 0.f);
+
+	Entity fish(nullptr, nullptr);
+	fish.SetScale(0.03f, 0.03f, 0.03f);
+	fish.SetPosition(9.f, -8.5f, -15.f);
+	fish.SetRotation(0, 90.f * XM_PI / 180, 0);
+
+	Simulation simulation;
+	simulation.Initialize(SimulationObjects{ &water, &fishes, &particles, &projectile, &boat, &fish, nullptr, &jobs });
+	simulation.SetPlayerPosition(XMFLOAT3(0.f, 3.f, -15.f));
+
+	// Thrown down at the water in front of the boat, like the player would
+	XMFLOAT3 direction;
+	XMStoreFloat3(&direction, XMVector3Normalize(XMVectorSet(0.1f, -0.4f, 1.0f, 0)));
+
+	int maxRipples = 0;
+	int maxEmitters = 0;
+
+	auto start = Clock::now();
+	for (int i = 0; i < steps; i++)
+	{
+		if (!projectile.HasBeenShot())
+			projectile.Shoot(1.f, direction);
+
+		simulation.Step();
+
+		maxRipples = (std::max)(maxRipples, (int)simulation.GetRipples().size());
+		maxEmitters = (std::max)(maxEmitters, particles.GetActiveEmitterCount());
+	}
+	auto end = Clock::now();
+
+	double seconds = std::chrono::duration<double>(end - start).count();
+	printf("\nHeadless simulation: %d steps (%.1f s simulated) in %.3f s on %u threads, %.0f steps per second",
+		steps, steps * FIXED_TIMESTEP, seconds, jobs.GetWorkerCount() + 1, seconds > 0 ? steps / seconds : 0.0);
+	printf("\n%d splashes, at most %d ripples and %d emitters alive",
+		simulation.GetSplashCount(), maxRipples, maxEmitters);
+}
+
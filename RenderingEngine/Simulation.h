@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <DirectXMath.h>
+
+#include "Water.h"
+#include "Ripple.h"
+#include "ProjectileEntity.h"
+#include "FishController.h"
+#include "ParticleSystem.h"
+#include "JobSystem.h"
+
+#define FIXED_TIMESTEP (1.0f / 60.0f)
+#define MAX_STEPS_PER_FRAME 8
+#define RIPPLE_DURATION 10
+
+//------------------------------------------------
+// Everything the simulation moves. It only
+// borrows these, the owner keeps them alive.
+//------------------------------------------------
+struct SimulationObjects
+{
+	Water* water;
+	FishController* fishes;
+	ParticleSystem* particles;
+	ProjectileEntity* projectile;
+	Entity* boat;
+	Entity* fish;
+	ID3D11ShaderResourceView* splashTexture;
+	JobSystem* jobs;
+};
+
+//------------------------------------------------
+// Steps the water, fish, spear, splashes and
+// ripples at a fixed rate, so they play out the
+// same at any frame rate. Rendering draws the
+// entities part way between the last two steps.
+// Needs no device, so it can also run headless.
+//------------------------------------------------
+class Simulation
+{
+public:
+	Simulation();
+
+	void Initialize(const SimulationObjects& objects);
+
+	// Runs as many steps as the frame time covers and sets up
+	// interpolation for drawing. Returns the number of steps run.
+	int Update(float deltaTime);
+	void Step();
+
+	// The spear goes back here once it is lost or hits a fish
+	void SetPlayerPosition(DirectX::XMFLOAT3 position);
+
+	// Interpolated for drawing
+	float GetWaterTime();
+	float GetWaterTranslate();
+
+	std::vector<Ripple>& GetRipples();
+	int GetSplashCount();
+
+	// Called with the spear tip position when the spear hits the water
+	std::function<void(DirectX::XMFLOAT3)> onSplash;
+
+	// Steps a device-less scene as fast as possible and prints the rate
+	static void RunHeadless(int steps);
+private:
+	SimulationObjects objects;
+	DirectX::XMFLOAT3 playerPosition;
+	std::vector<Ripple> ripples;
+	bool projectileHitWater;
+	int splashCount;
+
+	float accumulator;
+	float alpha;
+	float elapsed;
+	float time, previousTime;
+	float translate, previousTranslate;
+
+	void SaveState();
+	void Interpolate();
+	void UpdateFish(float dt);
+	void UpdateRipples(float dt);
+	void CheckProjectile();
+};
+
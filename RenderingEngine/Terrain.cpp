@@ -518,25 +518,39 @@ void Terrain::SetSplatMap(ID3D11ShaderResourceView * splat)
 	splatMap = splat;
 }
 
+void Terrain::ResolveSplatHandles(SimplePixelShader* pixelShader)
+{
+	if (pixelShader == splatShader)
+		return;
+
+	splatShader = pixelShader;
+	redTextureHandle = pixelShader->GetShaderResourceViewHandle("redTexture");
+	blueTextureHandle = pixelShader->GetShaderResourceViewHandle("blueTexture");
+	alphaTextureHandle = pixelShader->GetShaderResourceViewHandle("alphaTexture");
+	splatMapHandle = pixelShader->GetShaderResourceViewHandle("splatMap");
+}
+
 void Terrain::PrepareMaterialWithShadows(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix, XMFLOAT4X4 shadowViewMatrix, XMFLOAT4X4 shadowProjectionMatrix, ID3D11SamplerState * shadowSampler, ID3D11ShaderResourceView * shadowSRV)
 {
 	auto vertexShader = material->GetVertexShader();
 	auto pixelShader = material->GetPixelShader();
-	vertexShader->SetMatrix4x4("world", GetWorldMatrix());
-	vertexShader->SetMatrix4x4("view", viewMatrix);
-	vertexShader->SetMatrix4x4("projection", projectionMatrix);
-	vertexShader->SetMatrix4x4("shadowView", shadowViewMatrix);
-	vertexShader->SetMatrix4x4("shadowProjection", shadowProjectionMatrix);
-	pixelShader->SetSamplerState("basicSampler", material->GetSampler());
-	pixelShader->SetSamplerState("shadowSampler", shadowSampler);
-	pixelShader->SetShaderResourceView("diffuseTexture", greenTexture);
-	pixelShader->SetShaderResourceView("shadowMapTexture", shadowSRV);
-	pixelShader->SetShaderResourceView("redTexture", redTexture);
-	pixelShader->SetShaderResourceView("blueTexture", blueTexture);
-	pixelShader->SetShaderResourceView("alphaTexture", alphaTexture);
-	pixelShader->SetShaderResourceView("splatMap", splatMap);
-	pixelShader->SetShaderResourceView("normalTexture", material->GetNormalSRV());
-	pixelShader->SetShaderResourceView("roughnessTexture", material->GetRoughnessSRV());
+	auto& handles = material->GetHandles();
+	ResolveSplatHandles(pixelShader);
+	vertexShader->SetMatrix4x4(handles.world, GetWorldMatrix());
+	vertexShader->SetMatrix4x4(handles.view, viewMatrix);
+	vertexShader->SetMatrix4x4(handles.projection, projectionMatrix);
+	vertexShader->SetMatrix4x4(handles.shadowView, shadowViewMatrix);
+	vertexShader->SetMatrix4x4(handles.shadowProjection, shadowProjectionMatrix);
+	pixelShader->SetSamplerState(handles.basicSampler, material->GetSampler());
+	pixelShader->SetSamplerState(handles.shadowSampler, shadowSampler);
+	pixelShader->SetShaderResourceView(handles.diffuseTexture, greenTexture);
+	pixelShader->SetShaderResourceView(handles.shadowMapTexture, shadowSRV);
+	pixelShader->SetShaderResourceView(redTextureHandle, redTexture);
+	pixelShader->SetShaderResourceView(blueTextureHandle, blueTexture);
+	pixelShader->SetShaderResourceView(alphaTextureHandle, alphaTexture);
+	pixelShader->SetShaderResourceView(splatMapHandle, splatMap);
+	pixelShader->SetShaderResourceView(handles.normalTexture, material->GetNormalSRV());
+	pixelShader->SetShaderResourceView(handles.roughnessTexture, material->GetRoughnessSRV());
 	vertexShader->CopyAllBufferData();
 	pixelShader->CopyAllBufferData();
 	vertexShader->SetShader();
@@ -547,18 +561,15 @@ void Terrain::PrepareMaterial(XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projectionMatrix
 {
 	auto vertexShader = material->GetVertexShader();
 	auto pixelShader = material->GetPixelShader();
-	vertexShader->SetMatrix4x4("world", GetWorldMatrix());
-	vertexShader->SetMatrix4x4("view", viewMatrix);
-	vertexShader->SetMatrix4x4("projection", projectionMatrix);
-
-	pixelShader->SetSamplerState("basicSampler", material->GetSampler());
-	pixelShader->SetShaderResourceView("diffuseTexture", redTexture);
-	if (material->GetNormalSRV())
-		pixelShader->SetShaderResourceView("normalTexture", material->GetNormalSRV());
-	else
-		pixelShader->SetShaderResourceView("normalTexture", nullptr);
-
-	pixelShader->SetShaderResourceView("roughnessTexture", material->GetRoughnessSRV());
+	auto& handles = material->GetHandles();
+	vertexShader->SetMatrix4x4(handles.world, GetWorldMatrix());
+	vertexShader->SetMatrix4x4(handles.view, viewMatrix);
+	vertexShader->SetMatrix4x4(handles.projection, projectionMatrix);
+
+	pixelShader->SetSamplerState(handles.basicSampler, material->GetSampler());
+	pixelShader->SetShaderResourceView(handles.diffuseTexture, redTexture);
+	pixelShader->SetShaderResourceView(handles.normalTexture, material->GetNormalSRV());
+	pixelShader->SetShaderResourceView(handles.roughnessTexture, material->GetRoughnessSRV());
 	vertexShader->CopyAllBufferData();
 	pixelShader->CopyAllBufferData();
 	vertexShader->SetShader();
@@ -570,6 +581,7 @@ Terrain::Terrain():
 {
 	terrainHeight = terrainWidth = 100;
 	position = XMFLOAT3(0, 0, 0);
+	splatShader = nullptr;
 }
 
 
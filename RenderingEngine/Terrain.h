@@ -25,6 +25,15 @@ class Terrain : public Entity
 	ID3D11ShaderResourceView* blueTexture; //beach
 	ID3D11ShaderResourceView* greenTexture; //grass
 	ID3D11ShaderResourceView* alphaTexture; //sea bed 2
+
+	// The splat textures aren't part of MaterialHandles, so they are
+	// looked up here, again only if the material's pixel shader changes
+	SimplePixelShader* splatShader;
+	int redTextureHandle;
+	int blueTextureHandle;
+	int alphaTextureHandle;
+	int splatMapHandle;
+	void ResolveSplatHandles(SimplePixelShader* pixelShader);
 public:
 	const int GetTerrainHeight();
 	const int GetTerrainWidth();
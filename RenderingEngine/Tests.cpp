@@ -0,0 +1,850 @@
+#include "Tests.h"
+#include <cstdio>
+#include <array>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <cfloat>
+#include <atomic>
+#include "Random.h"
+#include "RenderQueue.h"
+#include "Frustum.h"
+#include "Entity.h"
+#include "Mesh.h"
+#include "ResourceRegistry.h"
+#include "MeshCache.h"
+#include "VertexWeld.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "CommandList.h"
+#include "Resources.h"
+#include "JobSystem.h"
+#include "Water.h"
+#include "TreeManager.h"
+
+using namespace DirectX;
+
+// Checks that failed in the test that is running
+static int failedChecks = 0;
+
+static void Check(bool passed, const char* condition, const char* file, int line)
+{
+	if (passed)
+		return;
+	failedChecks++;
+	printf("\n  %s(%d): CHECK(%s) failed", file, line, condition);
+}
+
+#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+// -----------------------------------------------------
+// A grid of side x side quads with each triangle's
+// vertices written out on their own, the way faces
+// come out of the OBJ readers before welding
+// -----------------------------------------------------
+static void MakeUnweldedGrid(int side, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	auto corner = [side](int x, int z)
+	{
+		Vertex vertex = {};
+		vertex.Position = XMFLOAT3((float)x, 0.1f * (x % 3), (float)z);
+		vertex.Normal = XMFLOAT3(0, 1, 0);
+		vertex.UV = XMFLOAT2((float)x / side, (float)z / side);
+		return vertex;
+	};
+
+	for (int z = 0; z < side; z++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			Vertex quad[6] = { corner(x, z), corner(x, z + 1), corner(x + 1, z), corner(x + 1, z), corner(x, z + 1), corner(x + 1, z + 1) };
+			for (auto& vertex : quad)
+			{
+				indices.push_back((unsigned int)vertices.size());
+				vertices.push_back(vertex);
+			}
+		}
+	}
+}
+
+// -----------------------------------------------------
+// Every triangle as its corners' positions, rotated to
+// start from the smallest so only the winding counts,
+// and sorted so only the set of triangles counts
+// -----------------------------------------------------
+static std::vector<std::array<float, 9>> GetTriangles(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+	std::vector<std::array<float, 9>> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		std::array<float, 9> best;
+		for (int rotation = 0; rotation < 3; rotation++)
+		{
+			std::array<float, 9> triangle;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const XMFLOAT3& position = vertices[indices[i + (corner + rotation) % 3]].Position;
+				triangle[corner * 3 + 0] = position.x;
+				triangle[corner * 3 + 1] = position.y;
+				triangle[corner * 3 + 2] = position.z;
+			}
+			if (rotation == 0 || triangle < best)
+				best = triangle;
+		}
+		triangles.push_back(best);
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static void WriteTextFile(const std::string& path, const std::string& text)
+{
+	std::ofstream file(path, std::ios::binary);
+	file << text;
+}
+
+// -----------------------------------------------------
+// CalculateGerstnerWave from VS_WaterShader.hlsl, line
+// for line, so the test checks the query against what
+// the GPU draws rather than against itself
+// -----------------------------------------------------
+static XMFLOAT3 ShaderGerstnerWave(const Wave* waves, int numWaves, XMFLOAT3 inputVertex, float time)
+{
+	XMFLOAT3 total(0, 0, 0);
+	for (int i = 0; i < numWaves; i++)
+	{
+		Wave wave = waves[i];
+		float wi = 2 * 3.1416f / wave.wavelength;
+		float ai = wave.amplitude;
+		float phi = SPEED * wi;
+		XMFLOAT2 direction;
+		XMStoreFloat2(&direction, XMVector2Normalize(XMLoadFloat2(&wave.direction)));
+		float theta = wi * (inputVertex.x * direction.x + inputVertex.z * direction.y) + phi * time;
+		float qi = STEEPNESS / wi * ai;
+
+		total.x += inputVertex.x + qi * ai * direction.x * cosf(theta);
+		total.y += wave.amplitude * sinf(theta);
+		total.z += inputVertex.z + qi * ai * direction.y * cosf(theta);
+	}
+	return total;
+}
+
+// Heights at the points the vertex shader moves grid vertices to match
+// the height it gives them, one at a time and four at a time. Points off
+// the mesh aren't on the water.
+static void TestWaterHeight()
+{
+	Water water(50, 50);
+	water.CreateWaves();
+	water.SetPosition(-100, 2, -50);
+	water.UpdateTransform();
+
+	std::vector<float> x, z, expected;
+	for (float time : { 0.0f, 1.3f, 17.25f })
+	{
+		x.clear();
+		z.clear();
+		expected.clear();
+		for (int j = 2; j < 48; j += 3)
+		{
+			for (int i = 2; i < 48; i += 5)
+			{
+				XMFLOAT3 moved = ShaderGerstnerWave(water.GetWaves(), water.GetWaveCount(), XMFLOAT3((float)i, 0, (float)j), time);
+				x.push_back(moved.x - 100);
+				z.push_back(moved.z - 50);
+				expected.push_back(moved.y + 2);
+			}
+		}
+
+		// Not a multiple of four, so the last batch is partial
+		x.pop_back();
+		std::vector<float> heights(x.size());
+		water.GetHeights(x.data(), z.data(), heights.data(), (int)x.size(), time);
+
+		float largestError = 0;
+		for (size_t i = 0; i < x.size(); i++)
+		{
+			largestError = std::max(largestError, fabsf(heights[i] - expected[i]));
+			largestError = std::max(largestError, fabsf(water.GetHeight(x[i], z[i], time) - expected[i]));
+		}
+		CHECK(largestError < 1e-3f);
+	}
+
+	CHECK(water.GetHeight(-1000, 0, 0) == -FLT_MAX);
+	CHECK(water.GetHeight(-100 + 5 * 60, -50 + 5 * 25, 0) == -FLT_MAX);
+}
+
+// -----------------------------------------------------
+// Runs the job graph on one job system: chunks of a
+// ParallelFor, children, dependencies (more of them
+// than a job stores) and more jobs than the ring has
+// -----------------------------------------------------
+static void TestJobs(JobSystem& jobs)
+{
+	std::vector<int> visits(10000, 0);
+	jobs.ParallelFor((int)visits.size(), 7, [&visits](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			visits[i]++;
+	});
+	CHECK(std::count(visits.begin(), visits.end(), 1) == (int)visits.size());
+
+	// One child made up front, the rest from inside the parent
+	std::atomic<int> childrenRun(0);
+	Job* parent = nullptr;
+	parent = jobs.CreateJob([&jobs, &parent, &childrenRun]()
+	{
+		for (int i = 0; i < 99; i++)
+			jobs.Run(jobs.CreateChildJob(parent, [&childrenRun]() { childrenRun++; }));
+	});
+	jobs.Run(jobs.CreateChildJob(parent, [&childrenRun]() { childrenRun++; }));
+	jobs.Run(parent);
+	jobs.Wait(parent);
+	CHECK(childrenRun == 100);
+
+	// Every job stamps when it ran, each has to come after its dependencies
+	const int dependentCount = 3 * MAX_JOB_DEPENDENTS;
+	std::atomic<int> clock(0);
+	std::vector<int> ranAt(dependentCount + 3, -1);
+	std::vector<Job*> graph;
+	for (size_t i = 0; i < ranAt.size(); i++)
+		graph.push_back(jobs.CreateJob([&clock, &ranAt, i]() { ranAt[i] = clock++; }));
+	Job* first = graph[0];
+	Job* second = graph[1];
+	Job* last = graph.back();
+	jobs.AddDependency(first, second);
+	for (int i = 0; i < dependentCount; i++)
+	{
+		jobs.AddDependency(second, graph[2 + i]);
+		jobs.AddDependency(graph[2 + i], last);
+	}
+	for (auto it = graph.rbegin(); it != graph.rend(); ++it)
+		jobs.Run(*it);
+	jobs.Wait(last);
+
+	bool ordered = ranAt[0] >= 0 && ranAt[1] > ranAt[0];
+	for (int i = 0; i < dependentCount; i++)
+		ordered = ordered && ranAt[2 + i] > ranAt[1] && ranAt.back() > ranAt[2 + i];
+	CHECK(ordered);
+
+	// Twice round the ring without waiting, nothing may be overwritten
+	std::atomic<int> jobsRun(0);
+	std::vector<Job*> newest;
+	for (int i = 0; i < 2 * MAX_JOBS; i++)
+	{
+		Job* job = jobs.CreateJob([&jobsRun]() { jobsRun++; });
+		jobs.Run(job);
+		if (i >= MAX_JOBS)
+			newest.push_back(job);
+	}
+	for (Job* job : newest)
+		jobs.Wait(job);
+	CHECK(jobsRun == 2 * MAX_JOBS);
+}
+
+// The same graph inline on the calling thread and spread over workers
+static void TestJobSystem()
+{
+	for (int workerCount : { 0, 3 })
+	{
+		JobSystem jobs(workerCount);
+		CHECK(jobs.GetWorkerCount() == (unsigned int)workerCount);
+		TestJobs(jobs);
+	}
+}
+
+// Radix sorted keys against a stable std::sort, down to which item
+// ended up where when keys are equal
+static void TestRadixSort()
+{
+	Random random(1);
+	for (int count : { 0, 1, 2, 255, 4096 })
+	{
+		std::vector<RenderItem> items(count);
+		for (int i = 0; i < count; i++)
+		{
+			uint64_t key = ((uint64_t)random.NextInt(0, 15) << 60) | ((uint64_t)random.NextInt(0, 0xFFFF) << 16) | (uint64_t)random.NextInt(0, 3);
+			items[i] = RenderItem{ key, (Entity*)(uintptr_t)(i + 1) };
+		}
+		std::vector<RenderItem> reference = items;
+		std::stable_sort(reference.begin(), reference.end(), [](const RenderItem& a, const RenderItem& b) { return a.key < b.key; });
+
+		std::vector<RenderItem> scratch(count);
+		RenderQueue::RadixSort(items.data(), scratch.data(), count);
+		bool same = true;
+		for (int i = 0; i < count; i++)
+			same = same && items[i].key == reference[i].key && items[i].entity == reference[i].entity;
+		CHECK(same);
+	}
+
+	// Every digit is the same, so every pass is skipped
+	std::vector<RenderItem> items(100, RenderItem{ 0x1234567812345678ull, nullptr });
+	std::vector<RenderItem> scratch(items.size());
+	for (size_t i = 0; i < items.size(); i++)
+		items[i].entity = (Entity*)(uintptr_t)(i + 1);
+	RenderQueue::RadixSort(items.data(), scratch.data(), (int)items.size());
+	bool unmoved = true;
+	for (size_t i = 0; i < items.size(); i++)
+		unmoved = unmoved && items[i].entity == (Entity*)(uintptr_t)(i + 1);
+	CHECK(unmoved);
+}
+
+// The batched culler keeps exactly the entities the one at a time test
+// does, in the same order. The count is not a multiple of four so the
+// padding gets read.
+static void TestFrustumCuller()
+{
+	Random random(1);
+	std::vector<Entity*> entities;
+	for (int i = 0; i < 1001; i++)
+	{
+		Entity* entity = new Entity(nullptr, nullptr);
+		entity->SetPosition(random.NextFloat(-300, 300), random.NextFloat(-50, 50), random.NextFloat(-300, 300));
+		float size = random.NextFloat(0.5f, 5.0f);
+		entity->SetScale(size, size, size);
+		entity->UpdateTransform();
+		entities.push_back(entity);
+	}
+
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 3, -15, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 0.1f, 300.0f);
+	Frustum frustum(view * projection);
+
+	XMVECTOR planes[6];
+	for (int p = 0; p < 6; p++)
+		planes[p] = XMLoadFloat4(&frustum.planes[p]);
+	std::vector<Entity*> reference;
+	for (Entity* entity : entities)
+	{
+		BoundingSphere bounds = entity->GetDrawBounds();
+		if (bounds.ContainedBy(planes[0], planes[1], planes[2], planes[3], planes[4], planes[5]) != DISJOINT)
+			reference.push_back(entity);
+	}
+
+	FrustumCuller culler;
+	std::vector<Entity*> visible;
+	int visibleCount = culler.Cull(frustum, entities.data(), (int)entities.size(), visible);
+	CHECK(visibleCount == (int)visible.size());
+	CHECK(visible == reference);
+	CHECK(!reference.empty() && reference.size() < entities.size());
+
+	for (Entity* entity : entities)
+		delete entity;
+}
+
+// Handles find what the names do, and stop finding it once it is gone
+static void TestResourceRegistry()
+{
+	int values[64];
+	ResourceRegistry<int> registry;
+	std::vector<ResourceRegistry<int>::Handle> handles;
+	for (int i = 0; i < 64; i++)
+		handles.push_back(registry.Add("resource" + std::to_string(i) + "Normal", &values[i]));
+
+	bool found = true;
+	for (int i = 0; i < 64; i++)
+	{
+		found = found && registry.Get(handles[i]) == &values[i];
+		found = found && registry.Find("resource" + std::to_string(i) + "Normal") == &values[i];
+	}
+	CHECK(found);
+	CHECK(!ResourceRegistry<int>::Handle().IsValid());
+	CHECK(registry.Get(ResourceRegistry<int>::Handle()) == nullptr);
+
+	// The first one added under a name stays
+	int other;
+	CHECK(registry.Add("resource0Normal", &other) == handles[0]);
+	CHECK(registry.Find("resource0Normal") == &values[0]);
+
+	CHECK(registry.Remove(handles[3]) == &values[3]);
+	CHECK(registry.Get(handles[3]) == nullptr);
+	CHECK(registry.Find("resource3Normal") == nullptr);
+
+	// The slot is reused, the old handle still resolves to nothing
+	auto reused = registry.Add("reused", &other);
+	CHECK(reused.index == handles[3].index);
+	CHECK(registry.Get(reused) == &other);
+	CHECK(registry.Get(handles[3]) == nullptr);
+}
+
+static void TestVertexWeld()
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeUnweldedGrid(8, vertices, indices);
+	auto triangles = GetTriangles(vertices, indices);
+
+	unsigned int weldedCount = WeldVertices(vertices, indices);
+	CHECK(weldedCount == 9 * 9);
+	CHECK(vertices.size() == weldedCount);
+	CHECK(GetTriangles(vertices, indices) == triangles);
+
+	// A UV seam keeps both sides
+	std::vector<Vertex> seam(2, vertices[0]);
+	seam[1].UV.x += 1.0f;
+	std::vector<unsigned int> seamIndices = { 0, 1, 0 };
+	CHECK(WeldVertices(seam, seamIndices) == 2);
+}
+
+// Same triangles with the same winding, fewer cache misses, and
+// vertices in the order they are first used
+static void TestMeshOptimization()
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeUnweldedGrid(32, vertices, indices);
+	WeldVertices(vertices, indices);
+
+	// Shuffled, so there is something to fix
+	Random random(1);
+	for (size_t i = indices.size() / 3 - 1; i > 0; i--)
+	{
+		size_t j = (size_t)random.NextInt(0, (int)i);
+		for (int corner = 0; corner < 3; corner++)
+			std::swap(indices[i * 3 + corner], indices[j * 3 + corner]);
+	}
+	auto triangles = GetTriangles(vertices, indices);
+	float acmr = AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)vertices.size()).acmr;
+
+	OptimizeMesh(vertices, indices);
+	CHECK(GetTriangles(vertices, indices) == triangles);
+	CHECK(AnalyzeVertexCache(indices.data(), indices.size(), (unsigned int)vertices.size()).acmr < acmr);
+
+	unsigned int nextNew = 0;
+	bool fetchOrder = true;
+	for (unsigned int index : indices)
+	{
+		if (index == nextNew)
+			nextNew++;
+		else if (index > nextNew)
+			fetchOrder = false;
+	}
+	CHECK(fetchOrder && nextNew == vertices.size());
+}
+
+// What goes into the cache comes back out, until the source changes
+static void TestMeshCache()
+{
+	const std::string sourcePath = "meshCacheTest.obj";
+	const std::string cachePath = MeshCache::GetCachePath(sourcePath);
+	WriteTextFile(sourcePath, "# Stands in for a model\n");
+
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MakeUnweldedGrid(4, vertices, indices);
+	WeldVertices(vertices, indices);
+	MeshCacheEntry written = { "grid", "grid.png", vertices.data(), (uint32_t)vertices.size(), indices.data(), (uint32_t)indices.size() };
+	Mesh::CalculateBounds(vertices.data(), (UINT)vertices.size(), written.minDimensions, written.maxDimensions);
+	CHECK(MeshCache::Write(cachePath, sourcePath, { written }));
+
+	{
+		MeshCache cache;
+		CHECK(cache.Open(cachePath, sourcePath));
+		CHECK(cache.GetEntries().size() == 1);
+		if (cache.GetEntries().size() == 1)
+		{
+			const MeshCacheEntry& read = cache.GetEntries()[0];
+			CHECK(read.name == written.name && read.texture == written.texture);
+			CHECK(read.vertexCount == written.vertexCount && read.indexCount == written.indexCount);
+			CHECK(memcmp(read.vertices, written.vertices, written.vertexCount * sizeof(Vertex)) == 0);
+			CHECK(memcmp(read.indices, written.indices, written.indexCount * sizeof(uint32_t)) == 0);
+			CHECK(memcmp(&read.minDimensions, &written.minDimensions, sizeof(XMFLOAT3)) == 0);
+			CHECK(memcmp(&read.maxDimensions, &written.maxDimensions, sizeof(XMFLOAT3)) == 0);
+		}
+	}
+
+	// A stale cache can be written over while its MeshCache is around
+	WriteTextFile(sourcePath, "# Stands in for a model, edited\n");
+	{
+		MeshCache cache;
+		CHECK(!cache.Open(cachePath, sourcePath));
+		CHECK(MeshCache::Write(cachePath, sourcePath, { written }));
+		CHECK(cache.Open(cachePath, sourcePath));
+	}
+
+	// Written again with the same bytes, whether or not the time moved
+	WriteTextFile(sourcePath, "# Stands in for a model, edited\n");
+	{
+		MeshCache cache;
+		CHECK(cache.Open(cachePath, sourcePath));
+	}
+
+	remove(cachePath.c_str());
+	remove(sourcePath.c_str());
+}
+
+// -----------------------------------------------------
+// blocks copies of every kind of line the models use:
+// objects, groups, materials, positive and negative
+// indices, all four face layouts and a quad. The faces
+// are repeated to make the file big enough to split.
+// Negative indices stay inside their block, so any
+// line can start a chunk.
+// -----------------------------------------------------
+static std::string MakeObjFixture(int blocks, int repeats)
+{
+	std::string text = "# ObjParser test\nmtllib objParserTest.mtl\n";
+	char line[160];
+	for (int i = 0; i < blocks; i++)
+	{
+		int first = i * 4 + 1;
+		float x = (float)i;
+		text.append(line, snprintf(line, sizeof(line), "\no part%d\n", i));
+		text.append(line, snprintf(line, sizeof(line), "v %.6f 0.000000 0.000000\n", x));
+		text.append(line, snprintf(line, sizeof(line), "v %.6f 1.5e-1 0.000000\n", x + 1.0f));
+		text.append(line, snprintf(line, sizeof(line), "v %.6f -0.25 1.000000\n", x + 1.0f));
+		text.append(line, snprintf(line, sizeof(line), "v %.6f 0.5 1\n", x));
+		text += "vt 0.000000 0.000000\nvt 1.000000 0.000000\nvt 1.000000 1.000000\nvt 0.000000 1.000000\n";
+		text += "vn 0.000000 1.000000 0.000000\n";
+		text += i % 2 ? "usemtl blue\n" : "usemtl red\n";
+		for (int r = 0; r < repeats; r++)
+		{
+			text += "f -4/-4/-1 -3/-3/-1 -2/-2/-1\n";
+			text.append(line, snprintf(line, sizeof(line), "f %d %d %d\n", first, first + 2, first + 3));
+		}
+		text += "g detail\n";
+		for (int r = 0; r < repeats; r++)
+			text += "f -4//-1 -2//-1 -1//-1\nf -4/-4 -3/-3 -2/-2 -1/-1\n";
+	}
+	return text;
+}
+
+static std::string ToCRLF(const std::string& text)
+{
+	std::string crlf;
+	for (char c : text)
+	{
+		if (c == '\n')
+			crlf += '\r';
+		crlf += c;
+	}
+	return crlf;
+}
+
+// objl is what the parser replaced, so both have to read the
+// fixture the same, on one thread and split into chunks on the jobs.
+// objl keeps the CR of a CRLF file in names and can't find its
+// materials, so there the parser has to match its own LF result.
+static void TestObjParser()
+{
+	const std::string objPath = "objParserTest.obj";
+	const std::string materialPath = "objParserTest.mtl";
+	const std::string material = "newmtl red\nKd 1 0 0\nmap_Kd red.png\n\nnewmtl blue\nKd 0 0 1\nmap_Kd blue.png\n";
+
+	JobSystem jobs(3);
+	for (int repeats : { 1, 8000 })
+	{
+		const std::string text = MakeObjFixture(3, repeats);
+		WriteTextFile(objPath, text);
+		WriteTextFile(materialPath, material);
+
+		objl::Loader loader;
+		CHECK(loader.LoadFile(objPath));
+		CHECK(loader.LoadedMeshes.size() == 6);
+		CHECK(loader.LoadedMaterials.size() == 2);
+
+		ObjParser parser;
+		CHECK(parser.LoadFile(objPath));
+		CHECK(ObjParser::SameMeshes(loader.LoadedMeshes, parser.LoadedMeshes));
+		CHECK(parser.LoadedMaterials.size() == loader.LoadedMaterials.size());
+
+		CHECK(parser.LoadFile(objPath, &jobs));
+		CHECK(ObjParser::SameMeshes(loader.LoadedMeshes, parser.LoadedMeshes));
+
+		WriteTextFile(objPath, ToCRLF(text));
+		WriteTextFile(materialPath, ToCRLF(material));
+		for (JobSystem* system : { (JobSystem*)nullptr, &jobs })
+		{
+			CHECK(parser.LoadFile(objPath, system));
+			CHECK(ObjParser::SameMeshes(loader.LoadedMeshes, parser.LoadedMeshes));
+			CHECK(parser.LoadedMaterials.size() == 2);
+		}
+	}
+
+	remove(objPath.c_str());
+	remove(materialPath.c_str());
+}
+
+// -----------------------------------------------------
+// Records what Renderer::Submit does for a frame:
+// two shaders, a material switch, meshes shared by
+// several draws and an instanced draw, and checks the
+// null backend sees every command with nothing missing.
+// -----------------------------------------------------
+static void TestCommandList()
+{
+	// Never dereferenced, the list only carries them
+	static int fakeObjects[10];
+	ID3D11InputLayout* layout = (ID3D11InputLayout*)&fakeObjects[0];
+	ID3D11VertexShader* vertexShaders[2] = { (ID3D11VertexShader*)&fakeObjects[1], (ID3D11VertexShader*)&fakeObjects[2] };
+	ID3D11PixelShader* pixelShader = (ID3D11PixelShader*)&fakeObjects[3];
+	ID3D11Buffer* perObject = (ID3D11Buffer*)&fakeObjects[4];
+	ID3D11Buffer* vertexBuffer = (ID3D11Buffer*)&fakeObjects[5];
+	ID3D11Buffer* indexBuffer = (ID3D11Buffer*)&fakeObjects[6];
+	ID3D11Buffer* instanceBuffer = (ID3D11Buffer*)&fakeObjects[7];
+	ID3D11ShaderResourceView* texture = (ID3D11ShaderResourceView*)&fakeObjects[8];
+	ID3D11SamplerState* sampler = (ID3D11SamplerState*)&fakeObjects[9];
+
+	const int drawsPerShader = 5;
+	float world[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	CommandList list;
+	list.SetPrimitiveTopology(4);	// Triangle list
+	for (ID3D11VertexShader* vertexShader : vertexShaders)
+	{
+		list.SetInputLayout(layout);
+		list.SetVertexShader(vertexShader);
+		list.SetConstantBuffer(CommandStage::Vertex, 0, perObject);
+		list.SetPixelShader(pixelShader);
+		list.SetShaderResource(CommandStage::Pixel, 0, texture);
+		list.SetSampler(CommandStage::Pixel, 0, sampler);
+		for (int i = 0; i < drawsPerShader; i++)
+		{
+			world[12] = (float)i;
+			list.UpdateConstants(perObject, world, sizeof(world));
+			if (i % 2 == 0)
+			{
+				list.SetVertexBuffer(0, vertexBuffer, 44);
+				list.SetIndexBuffer(indexBuffer, 42);	// R32_UINT
+			}
+			list.DrawIndexed(36);
+		}
+		for (unsigned int slot = 0; slot < 4; slot++)
+			list.SetShaderResource(CommandStage::Pixel, slot, nullptr);
+	}
+	list.SetVertexBuffer(1, instanceBuffer, 64);
+	list.DrawIndexedInstanced(36, 100);
+
+	NullCommandBackend backend;
+	list.Execute(backend);
+	CHECK(backend.GetErrorCount() == 0);
+	CHECK(backend.GetFirstError().empty());
+	CHECK(backend.GetCommandCount() == list.GetCommandCount());
+	CHECK(backend.GetDrawCount() == 2 * drawsPerShader + 1);
+	CHECK(backend.GetCount(CommandType::DrawIndexed) == 2 * drawsPerShader);
+	CHECK(backend.GetCount(CommandType::DrawIndexedInstanced) == 1);
+	CHECK(backend.GetCount(CommandType::SetVertexShader) == 2);
+	CHECK(backend.GetCount(CommandType::SetShaderResource) == 2 * 5);
+	CHECK(backend.GetCount(CommandType::SetVertexBuffer) == 2 * 3 + 1);
+	CHECK(backend.GetCount(CommandType::UpdateConstants) == 2 * drawsPerShader);
+	CHECK(backend.GetConstantBytes() == 2 * drawsPerShader * sizeof(world));
+
+	// Replaying again adds the same again, a Reset starts over
+	list.Execute(backend);
+	CHECK(backend.GetDrawCount() == 2 * (2 * drawsPerShader + 1));
+	backend.Reset();
+	CHECK(backend.GetCommandCount() == 0);
+	list.Reset();
+	CHECK(list.GetCommandCount() == 0);
+
+	// Each list is missing one thing a draw needs
+	list.DrawIndexed(36);
+	list.Execute(backend);
+	CHECK(backend.GetErrorCount() == 3);
+	CHECK(!backend.GetFirstError().empty());
+
+	backend.Reset();
+	list.Reset();
+	list.SetPrimitiveTopology(4);
+	list.SetVertexShader(vertexShaders[0]);
+	list.SetIndexBuffer(indexBuffer, 42);
+	list.DrawIndexedInstanced(36, 100);
+	list.Execute(backend);
+	CHECK(backend.GetErrorCount() == 1);
+
+	backend.Reset();
+	list.Reset();
+	list.UpdateConstants(perObject, world, 12);
+	list.SetSampler(CommandStage::Pixel, 16, sampler);
+	list.Execute(backend);
+	CHECK(backend.GetErrorCount() == 2);
+	CHECK(backend.GetDrawCount() == 0);
+}
+
+// Keeps the arguments of the last instanced draw
+class DrawCapture : public NullCommandBackend
+{
+public:
+	bool indexed = false;
+	unsigned int count = 0;
+	unsigned int instanceCount = 0;
+	unsigned int startInstance = 0;
+
+	void DrawInstanced(unsigned int vertexCount, unsigned int instances, unsigned int startVertex, unsigned int start) override
+	{
+		NullCommandBackend::DrawInstanced(vertexCount, instances, startVertex, start);
+		indexed = false;
+		count = vertexCount;
+		instanceCount = instances;
+		startInstance = start;
+	}
+
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instances, unsigned int startIndex, int baseVertex, unsigned int start) override
+	{
+		NullCommandBackend::DrawIndexedInstanced(indexCount, instances, startIndex, baseVertex, start);
+		indexed = true;
+		count = indexCount;
+		instanceCount = instances;
+		startInstance = start;
+	}
+};
+
+// -----------------------------------------------------
+// A welded mesh has fewer vertices than indices, so a
+// tree level has to be drawn through its index buffer
+// or the triangles come out scrambled. Needs a device
+// for the mesh's buffers, WARP is fine.
+// -----------------------------------------------------
+static void TestTreeDraw()
+{
+	ID3D11Device* device = nullptr;
+	ID3D11DeviceContext* context = nullptr;
+	CHECK(SUCCEEDED(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, &context)));
+	if (!device)
+		return;
+
+	// The mesh lets go of its buffers before the device goes
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		MakeUnweldedGrid(4, vertices, indices);
+		WeldVertices(vertices, indices);
+		XMFLOAT3 minDimensions, maxDimensions;
+		Mesh::CalculateBounds(vertices.data(), (UINT)vertices.size(), minDimensions, maxDimensions);
+		Mesh mesh;
+		mesh.Initialize((const Vertex*)vertices.data(), (UINT)vertices.size(), (const UINT*)indices.data(), (UINT)indices.size(), minDimensions, maxDimensions, device);
+		CHECK(mesh.GetIndexCount() > mesh.GetVertexCount());
+
+		// Never dereferenced, the list only carries them
+		static int fakeObjects[2];
+		ID3D11VertexShader* vertexShader = (ID3D11VertexShader*)&fakeObjects[0];
+		ID3D11Buffer* instanceBuffer = (ID3D11Buffer*)&fakeObjects[1];
+
+		CommandList list;
+		list.SetVertexShader(vertexShader);
+		TreeManager::RecordDraw(list, &mesh, instanceBuffer, nullptr, 7, 12);
+
+		DrawCapture backend;
+		list.Execute(backend);
+		CHECK(backend.GetErrorCount() == 0);
+		CHECK(backend.GetDrawCount() == 1);
+		CHECK(backend.indexed);
+		CHECK(backend.count == mesh.GetIndexCount());
+		CHECK(backend.instanceCount == 12 && backend.startInstance == 7);
+	}
+
+	context->Release();
+	device->Release();
+}
+
+// -----------------------------------------------------
+// A manifest of assets that aren't there. Every group
+// still has to finish: the one with only a material
+// straight away, the rest once ProcessUploads has had
+// what the workers read. Needs a device, WARP is fine.
+// -----------------------------------------------------
+static void TestResourceLoading()
+{
+	ID3D11Device* device = nullptr;
+	ID3D11DeviceContext* context = nullptr;
+	CHECK(SUCCEEDED(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, &context)));
+	if (!device)
+		return;
+
+	const std::string manifestPath = "resourcesTest.txt";
+	WriteTextFile(manifestPath,
+		"texture  files     missing resourcesTestMissing.png\n"
+		"ps       files     missing resourcesTestMissing.cso\n"
+		"material materials plain   - - -\n");
+
+	// No manifest, nothing loads and there is nothing to wait for
+	{
+		JobSystem jobs(0);
+		Resources resources(device, context, nullptr);
+		CHECK(!resources.LoadResources(&jobs, "resourcesTestMissing.txt"));
+		CHECK(Resources::IsLoaded(resources.GetGroup("files")));
+		CHECK(resources.materials.GetCount() == 0);
+	}
+
+	// Without workers everything is read inside LoadResources and
+	// waits for ProcessUploads
+	{
+		JobSystem jobs(0);
+		Resources resources(device, context, nullptr);
+		CHECK(resources.LoadResources(&jobs, manifestPath));
+		auto files = resources.GetGroup("files");
+		CHECK(Resources::IsLoaded(resources.GetGroup("materials")));
+		CHECK(resources.materials.Find("plain") != nullptr);
+		CHECK(!Resources::IsLoaded(files));
+		resources.ProcessUploads();
+		CHECK(Resources::IsLoaded(files));
+		CHECK(resources.pixelShaders.Find("missing") != nullptr);
+	}
+
+	// On workers, waiting for a group, for one that can never
+	// finish, and closing while reads are still going
+	{
+		JobSystem jobs(3);
+		Resources resources(device, context, nullptr);
+		CHECK(resources.LoadResources(&jobs, manifestPath));
+		resources.Wait(resources.GetGroup("files"));
+		CHECK(Resources::IsLoaded(resources.GetGroup("files")));
+
+		std::promise<void> never;
+		auto unfinished = never.get_future().share();
+		resources.Wait(unfinished);
+		CHECK(!Resources::IsLoaded(unfinished));
+
+		Resources closed(device, context, nullptr);
+		CHECK(closed.LoadResources(&jobs, manifestPath));
+	}
+
+	remove(manifestPath.c_str());
+	context->Release();
+	device->Release();
+}
+
+struct Test
+{
+	const char* name;
+	void(*run)();
+};
+
+static const Test tests[] =
+{
+	{ "Water height", TestWaterHeight },
+	{ "Job system", TestJobSystem },
+	{ "Radix sort", TestRadixSort },
+	{ "Frustum culler", TestFrustumCuller },
+	{ "Resource registry", TestResourceRegistry },
+	{ "Vertex weld", TestVertexWeld },
+	{ "Mesh optimization", TestMeshOptimization },
+	{ "Mesh cache", TestMeshCache },
+	{ "OBJ parser", TestObjParser },
+	{ "Command list", TestCommandList },
+	{ "Tree draw", TestTreeDraw },
+	{ "Resource loading", TestResourceLoading },
+};
+
+int RunTests()
+{
+	int testCount = (int)(sizeof(tests) / sizeof(tests[0]));
+	int failedTests = 0;
+	for (auto& test : tests)
+	{
+		failedChecks = 0;
+		printf("\n%s", test.name);
+		test.run();
+		if (failedChecks > 0)
+			failedTests++;
+	}
+
+	if (failedTests == 0)
+		printf("\nAll %d tests passed", testCount);
+	else
+		printf("\n%d of %d tests failed", failedTests, testCount);
+	return failedTests;
+}
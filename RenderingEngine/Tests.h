@@ -0,0 +1,10 @@
+#pragma once
+
+// -----------------------------------------------------
+// Checks the fast paths give the same results as the
+// code they replaced. Needs no window, and no GPU
+// either: the tests that need a device use WARP.
+// Prints every check that fails and returns how many
+// tests failed.
+// -----------------------------------------------------
+int RunTests();
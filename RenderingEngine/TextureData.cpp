@@ -0,0 +1,146 @@
+#include "TextureData.h"
+#include "DDSTextureLoader.h"
+#include <wincodec.h>
+#include <fstream>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+// The file's own colour space flag, read the way DirectXTK's WIC
+// loader reads it so textures come out in the same format
+static bool IsSRGB(IWICBitmapFrameDecode* frame)
+{
+	IWICMetadataQueryReader* metadata = nullptr;
+	if (FAILED(frame->GetMetadataQueryReader(&metadata)))
+		return false;
+
+	bool sRGB = false;
+	GUID container;
+	if (SUCCEEDED(metadata->GetContainerFormat(&container)))
+	{
+		PROPVARIANT value;
+		PropVariantInit(&value);
+		if (container == GUID_ContainerFormatPng)
+			sRGB = SUCCEEDED(metadata->GetMetadataByName(L"/sRGB/RenderingIntent", &value)) && value.vt == VT_UI1;
+		else
+			sRGB = SUCCEEDED(metadata->GetMetadataByName(L"System.Image.ColorSpace", &value)) && value.vt == VT_UI2 && value.uiVal == 1;
+		PropVariantClear(&value);
+	}
+	metadata->Release();
+	return sRGB;
+}
+
+// -----------------------------------------------------
+// Greyscale stays one channel, as DirectXTK keeps it.
+// Everything else becomes 8 bit RGBA.
+// -----------------------------------------------------
+static bool DecodeImage(IWICImagingFactory* factory, const std::wstring& path, TextureData& texture)
+{
+	IWICBitmapDecoder* decoder = nullptr;
+	IWICBitmapFrameDecode* frame = nullptr;
+	IWICFormatConverter* converter = nullptr;
+	bool decoded = false;
+
+	if (SUCCEEDED(factory->CreateDecoderFromFilename(path.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)) &&
+		SUCCEEDED(decoder->GetFrame(0, &frame)) &&
+		SUCCEEDED(frame->GetSize(&texture.width, &texture.height)))
+	{
+		WICPixelFormatGUID source;
+		frame->GetPixelFormat(&source);
+
+		WICPixelFormatGUID target = GUID_WICPixelFormat32bppRGBA;
+		UINT bytesPerPixel = 4;
+		texture.format = IsSRGB(frame) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		if (source == GUID_WICPixelFormat8bppGray)
+		{
+			target = source;
+			bytesPerPixel = 1;
+			texture.format = DXGI_FORMAT_R8_UNORM;
+		}
+
+		texture.rowPitch = texture.width * bytesPerPixel;
+		texture.bytes.resize((size_t)texture.rowPitch * texture.height);
+		if (source == target)
+			decoded = SUCCEEDED(frame->CopyPixels(nullptr, texture.rowPitch, (UINT)texture.bytes.size(), texture.bytes.data()));
+		else if (SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+			SUCCEEDED(converter->Initialize(frame, target, WICBitmapDitherTypeErrorDiffusion, nullptr, 0, WICBitmapPaletteTypeMedianCut)))
+			decoded = SUCCEEDED(converter->CopyPixels(nullptr, texture.rowPitch, (UINT)texture.bytes.size(), texture.bytes.data()));
+	}
+
+	if (converter) converter->Release();
+	if (frame) frame->Release();
+	if (decoder) decoder->Release();
+	return decoded;
+}
+
+bool ReadTextureData(const std::wstring& path, TextureData& texture)
+{
+	texture.dds = path.find(L".dds") != std::wstring::npos;
+	if (texture.dds)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file)
+			return false;
+		texture.bytes.resize((size_t)file.tellg());
+		file.seekg(0);
+		return (bool)file.read((char*)texture.bytes.data(), texture.bytes.size());
+	}
+
+	// Worker threads start without COM. A thread that already has it,
+	// like the main thread helping out while it waits, keeps its own.
+	HRESULT com = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+	IWICImagingFactory* factory = nullptr;
+	bool decoded = SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))) &&
+		DecodeImage(factory, path, texture);
+	if (factory)
+		factory->Release();
+	if (SUCCEEDED(com))
+		CoUninitialize();
+	return decoded;
+}
+
+ID3D11ShaderResourceView* CreateTexture(ID3D11Device* device, ID3D11DeviceContext* context, const TextureData& texture)
+{
+	ID3D11ShaderResourceView* srv = nullptr;
+	if (texture.bytes.empty())
+		return nullptr;
+	if (texture.dds)
+	{
+		CreateDDSTextureFromMemory(device, texture.bytes.data(), texture.bytes.size(), nullptr, &srv);
+		return srv;
+	}
+
+	UINT support = 0;
+	device->CheckFormatSupport(texture.format, &support);
+	bool generateMips = (support & D3D11_FORMAT_SUPPORT_MIP_AUTOGEN) != 0;
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = texture.width;
+	desc.Height = texture.height;
+	desc.MipLevels = generateMips ? 0 : 1;	// 0 is the whole chain
+	desc.ArraySize = 1;
+	desc.Format = texture.format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = generateMips ? D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET : D3D11_BIND_SHADER_RESOURCE;
+	desc.MiscFlags = generateMips ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0;
+
+	// Without mips to make the pixels can go in with the texture
+	D3D11_SUBRESOURCE_DATA initialData = {};
+	initialData.pSysMem = texture.bytes.data();
+	initialData.SysMemPitch = texture.rowPitch;
+	ID3D11Texture2D* resource = nullptr;
+	if (FAILED(device->CreateTexture2D(&desc, generateMips ? nullptr : &initialData, &resource)))
+		return nullptr;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = texture.format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = (UINT)-1;
+	if (SUCCEEDED(device->CreateShaderResourceView(resource, &srvDesc, &srv)) && generateMips)
+	{
+		context->UpdateSubresource(resource, 0, nullptr, texture.bytes.data(), texture.rowPitch, (UINT)texture.bytes.size());
+		context->GenerateMips(srv);
+	}
+	resource->Release();
+	return srv;
+}
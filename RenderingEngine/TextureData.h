@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <d3d11.h>
+
+//------------------------------------------------
+// A texture read off disk and ready to go to the
+// GPU. Images WIC can decode come out as pixels,
+// DDS files stay as they are and are parsed when
+// the texture is made.
+//------------------------------------------------
+struct TextureData
+{
+	bool dds;
+	std::vector<uint8_t> bytes;	// Pixels, or the whole DDS file
+	UINT width;
+	UINT height;
+	UINT rowPitch;
+	DXGI_FORMAT format;
+};
+
+// -----------------------------------------------------
+// Reads and decodes a texture, touching neither the
+// device nor the context, so any thread can do it.
+// False if the file is missing or can't be decoded.
+// -----------------------------------------------------
+bool ReadTextureData(const std::wstring& path, TextureData& texture);
+
+// -----------------------------------------------------
+// Makes the texture and its view. Decoded images get a
+// full mip chain made on the GPU the way
+// CreateWICTextureFromFile does it, so the context is
+// used and this belongs on the thread that owns it.
+// -----------------------------------------------------
+ID3D11ShaderResourceView* CreateTexture(ID3D11Device* device, ID3D11DeviceContext* context, const TextureData& texture);
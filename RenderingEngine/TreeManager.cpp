@@ -1,136 +1,384 @@
 #include "TreeManager.h"
 #include "Resources.h"
+#include "Random.h"
+#include <cfloat>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
 
+InstanceSelector::InstanceSelector()
+{
+	instanceCount = 0;
+	memset(firsts, 0, sizeof(firsts));
+	memset(counts, 0, sizeof(counts));
+}
+
+void InstanceSelector::SetInstances(const std::vector<XMFLOAT3>& centers, float instanceRadius)
+{
+	instanceCount = (int)centers.size();
+	int paddedCount = (instanceCount + 3) & ~3;
+	x.assign(paddedCount, 0.0f);
+	y.assign(paddedCount, 0.0f);
+	z.assign(paddedCount, 0.0f);
+	radius.assign(paddedCount, 0.0f);
+	visibleIndices.assign(paddedCount, 0);
+	visibleBuckets.assign(paddedCount, 0);
+	selected.assign(paddedCount, 0);
+	for (int i = 0; i < instanceCount; ++i)
+	{
+		x[i] = centers[i].x;
+		y[i] = centers[i].y;
+		z[i] = centers[i].z;
+		radius[i] = instanceRadius;
+	}
+}
+
+// -----------------------------------------------------
+// Cull, then a counting sort on the bucket so each
+// level's instances end up next to each other
+// -----------------------------------------------------
+int InstanceSelector::Select(const Frustum& frustum, XMFLOAT3 viewPosition, const float* maxDistances, int bucketCount)
+{
+	bucketCount = (std::min)(bucketCount, MAX_TREE_LODS);
+	memset(counts, 0, sizeof(counts));
+	memset(firsts, 0, sizeof(firsts));
+	if (instanceCount == 0 || bucketCount == 0)
+		return 0;
+
+	float maxDistancesSquared[MAX_TREE_LODS];
+	for (int b = 0; b < bucketCount; ++b)
+		maxDistancesSquared[b] = maxDistances[b] * maxDistances[b];
+
+	int visibleCount = FrustumCuller::CullSpheres(frustum, x.data(), y.data(), z.data(), radius.data(), instanceCount, visibleIndices.data());
+	for (int i = 0; i < visibleCount; ++i)
+	{
+		int index = visibleIndices[i];
+		float dx = x[index] - viewPosition.x;
+		float dy = y[index] - viewPosition.y;
+		float dz = z[index] - viewPosition.z;
+		float distanceSquared = dx * dx + dy * dy + dz * dz;
+
+		int bucket = 0;
+		while (bucket < bucketCount && distanceSquared > maxDistancesSquared[bucket])
+			bucket++;
+		visibleBuckets[i] = (unsigned char)bucket;
+		if (bucket < bucketCount)
+			counts[bucket]++;
+	}
+
+	int offsets[MAX_TREE_LODS];
+	int total = 0;
+	for (int b = 0; b < bucketCount; ++b)
+	{
+		firsts[b] = offsets[b] = total;
+		total += counts[b];
+	}
+
+	for (int i = 0; i < visibleCount; ++i)
+	{
+		int bucket = visibleBuckets[i];
+		if (bucket < bucketCount)
+			selected[offsets[bucket]++] = visibleIndices[i];
+	}
+	return total;
+}
+
+const int* InstanceSelector::GetSelected() const
+{
+	return selected.data();
+}
+
+int InstanceSelector::GetFirst(int bucket) const
+{
+	return firsts[bucket];
+}
+
+int InstanceSelector::GetCount(int bucket) const
+{
+	return counts[bucket];
+}
 
-void TreeManager::Render(int index, Camera * camera)
+// -----------------------------------------------------
+// Vegetation scattered around a camera near the
+// origin, three levels and a draw distance
+// -----------------------------------------------------
+void InstanceSelector::Benchmark(int instanceCount, int iterations)
 {
-	unsigned int strides[2];
-	unsigned int offsets[2];
-	ID3D11Buffer* bufferPointers[2];
+	typedef std::chrono::high_resolution_clock Clock;
+
+	Random random(1);
+	std::vector<XMFLOAT3> centers(instanceCount);
+	for (int i = 0; i < instanceCount; ++i)
+		centers[i] = XMFLOAT3(random.NextFloat(-1000, 1000), random.NextFloat(-10, 10), random.NextFloat(-1000, 1000));
+
+	InstanceSelector selector;
+	selector.SetInstances(centers, 5.0f);
 
-	strides[0] = sizeof(Vertex);
-	strides[1] = sizeof(XMFLOAT4X4);
-	offsets[0] = 0;
-	offsets[1] = 0;
-	bufferPointers[0] = meshes[index]->GetVertexBuffer();
-	bufferPointers[1] = instanceBuffer;
-	context->IASetVertexBuffers(0, 2, bufferPointers, strides, offsets);
-	context->IASetIndexBuffer(meshes[index]->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	XMMATRIX view = XMMatrixLookToLH(XMVectorSet(0, 3, -15, 0), XMVectorSet(0, 0, 1, 0), XMVectorSet(0, 1, 0, 0));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 0.1f, 1000.0f);
+	Frustum frustum(view * projection);
+	float maxDistances[3] = { 100.0f, 300.0f, 600.0f };
 
-	auto mat = materials[index];
+	int selectedCount = 0;
+	auto start = Clock::now();
+	for (int n = 0; n < iterations; ++n)
+		selectedCount = selector.Select(frustum, XMFLOAT3(0, 3, -15), maxDistances, 3);
+	auto end = Clock::now();
+
+	printf("\nTree instance selection (%d instances): %.3f ms, %d drawn (%d / %d / %d by level)",
+		instanceCount, std::chrono::duration<double, std::milli>(end - start).count() / iterations,
+		selectedCount, selector.GetCount(0), selector.GetCount(1), selector.GetCount(2));
+}
+
+void TreeManager::RecordDraw(CommandList& list, Mesh* mesh, ID3D11Buffer* instances, ID3D11RasterizerState* rasterizer, int firstInstance, int instanceCount)
+{
+	list.SetVertexBuffer(0, mesh->GetVertexBuffer(), sizeof(Vertex));
+	list.SetVertexBuffer(1, instances, sizeof(XMFLOAT4X4));
+	list.SetIndexBuffer(mesh->GetIndexBuffer(), DXGI_FORMAT_R32_UINT);
+	list.SetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	list.SetRasterizerState(rasterizer);
+	list.DrawIndexedInstanced(mesh->GetIndexCount(), instanceCount, 0, 0, firstInstance);
+	list.SetRasterizerState(nullptr);
+}
+
+void TreeManager::Render(int lod, int index, Camera * camera)
+{
+	auto mat = lods[lod].materials[index];
 	auto ps = mat->GetPixelShader();
 	auto vs = mat->GetVertexShader();
-	auto sampler = mat->GetSampler();
+	vs->SetCommandList(&commandList);
+	ps->SetCommandList(&commandList);
+
+	auto& handles = mat->GetHandles();
 
 	XMFLOAT4X4 world;
 	XMStoreFloat4x4(&world, XMMatrixTranspose(XMMatrixIdentity()));
 
-	vs->SetMatrix4x4("world", world);
-	vs->SetMatrix4x4("view", camera->GetViewMatrix());
-	vs->SetMatrix4x4("projection", camera->GetProjectionMatrix());;
+	vs->SetMatrix4x4(handles.world, world);
+	vs->SetMatrix4x4(handles.view, camera->GetViewMatrix());
+	vs->SetMatrix4x4(handles.projection, camera->GetProjectionMatrix());
 
-	ps->SetSamplerState("basicSampler", mat->GetSampler());
-	ps->SetShaderResourceView("diffuseTexture", mat->GetSRV());
-	ps->SetShaderResourceView("normalTexture", mat->GetNormalSRV());
-	ps->SetShaderResourceView("roughnessTexture", mat->GetRoughnessSRV());
+	ps->SetSamplerState(handles.basicSampler, mat->GetSampler());
+	ps->SetShaderResourceView(handles.diffuseTexture, mat->GetSRV());
+	ps->SetShaderResourceView(handles.normalTexture, mat->GetNormalSRV());
+	ps->SetShaderResourceView(handles.roughnessTexture, mat->GetRoughnessSRV());
 
 	vs->CopyAllBufferData();
 	ps->CopyAllBufferData();
 
 	vs->SetShader();
 	ps->SetShader();
-	context->RSSetState(rasterizer);
-	context->DrawInstanced(meshes[index]->GetVertexCount(), instanceCount, 0, 0);
-	context->RSSetState(nullptr);
+	vs->SetCommandList(nullptr);
+	ps->SetCommandList(nullptr);
+
+	RecordDraw(commandList, lods[lod].meshes[index], instanceBuffer, rasterizer, selector.GetFirst(lod), selector.GetCount(lod));
 }
 
-void TreeManager::RenderShadowBuffer(int index, SimpleVertexShader * shadowVS)
+void TreeManager::RenderShadowBuffer(int lod, int index, SimpleVertexShader * shadowVS)
 {
-	unsigned int strides[2];
-	unsigned int offsets[2];
-	ID3D11Buffer* bufferPointers[2];
-
-	strides[0] = sizeof(Vertex);
-	strides[1] = sizeof(XMFLOAT4X4);
-	offsets[0] = 0;
-	offsets[1] = 0;
-	bufferPointers[0] = meshes[index]->GetVertexBuffer();
-	bufferPointers[1] = instanceBuffer;
-	context->IASetVertexBuffers(0, 2, bufferPointers, strides, offsets);
-	context->IASetIndexBuffer(meshes[index]->GetIndexBuffer(), DXGI_FORMAT_R32_UINT, 0);
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
 	XMFLOAT4X4 world;
 	XMStoreFloat4x4(&world, XMMatrixTranspose(XMMatrixIdentity()));
-	shadowVS->SetMatrix4x4("world", world);
+	shadowVS->SetCommandList(&commandList);
+	shadowVS->SetMatrix4x4(shadowWorldHandle, world);
 	shadowVS->CopyAllBufferData();
+	shadowVS->SetCommandList(nullptr);
 
 	// Finally do the actual drawing
-	context->RSSetState(rasterizer);
-	context->DrawInstanced(meshes[index]->GetVertexCount(), instanceCount, 0, 0);
-	context->RSSetState(nullptr);
+	RecordDraw(commandList, lods[lod].meshes[index], instanceBuffer, rasterizer, selector.GetFirst(lod), selector.GetCount(lod));
 }
 
-void TreeManager::InitializeTrees(std::vector<std::string> meshNames, std::vector<std::string> materialNames, std::vector<XMFLOAT3> positionsVector)
+// -----------------------------------------------------
+// Pack the selected instances' matrices into the
+// instance buffer, one level after another
+// -----------------------------------------------------
+int TreeManager::CompactVisibleInstances(const Frustum& frustum, XMFLOAT3 viewPosition)
 {
-	auto rm = Resources::GetInstance();
-	for (auto mName : meshNames)
+	float maxDistances[MAX_TREE_LODS];
+	for (int i = 0; i < (int)lods.size(); ++i)
+		maxDistances[i] = lods[i].maxDistance;
+
+	int count = selector.Select(frustum, viewPosition, maxDistances, (int)lods.size());
+	if (count == 0)
+		return 0;
+
+	ReserveInstances(count);
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (!instanceBuffer || FAILED(context->Map(instanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return 0;
+
+	XMFLOAT4X4* instances = (XMFLOAT4X4*)mapped.pData;
+	const int* selected = selector.GetSelected();
+	for (int i = 0; i < count; ++i)
 	{
-		meshes.push_back(rm->meshes[mName]);
+		instances[i] = treeInstances[selected[i]];
 	}
+	context->Unmap(instanceBuffer, 0);
+	return count;
+}
 
-	for (auto mName : materialNames)
+// -----------------------------------------------------
+// Grow the instance buffer by doubling, it only ever
+// holds what survived culling
+// -----------------------------------------------------
+void TreeManager::ReserveInstances(int count)
+{
+	if (count <= instanceCapacity)
+		return;
+
+	int capacity = (std::max)(instanceCapacity, MAX_INSTANCE);
+	while (capacity < count)
+		capacity *= 2;
+
+	if (instanceBuffer)
+		instanceBuffer->Release();
+	instanceBuffer = nullptr;
+	instanceCapacity = 0;
+
+	D3D11_BUFFER_DESC instanceBufferDesc;
+	instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	instanceBufferDesc.ByteWidth = sizeof(XMFLOAT4X4) * capacity;
+	instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	instanceBufferDesc.MiscFlags = 0;
+	instanceBufferDesc.StructureByteStride = 0;
+	if (SUCCEEDED(device->CreateBuffer(&instanceBufferDesc, nullptr, &instanceBuffer)))
+		instanceCapacity = capacity;
+}
+
+// -----------------------------------------------------
+// One sphere around the meshes of every level covers
+// a tree. Instances are only translated.
+// -----------------------------------------------------
+void TreeManager::UpdateBounds()
+{
+	XMVECTOR minV = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxV = XMVectorReplicate(-FLT_MAX);
+	for (auto& lod : lods)
 	{
-		materials.push_back(rm->materials[mName]);
+		for (auto mesh : lod.meshes)
+		{
+			XMFLOAT3 meshMin = mesh->GetMinDimensions();
+			XMFLOAT3 meshMax = mesh->GetMaxDimensions();
+			minV = XMVectorMin(minV, XMLoadFloat3(&meshMin));
+			maxV = XMVectorMax(maxV, XMLoadFloat3(&meshMax));
+		}
 	}
+	XMFLOAT3 localCenter;
+	XMStoreFloat3(&localCenter, XMVectorScale(XMVectorAdd(minV, maxV), 0.5f));
+	float radius = XMVectorGetX(XMVector3Length(XMVectorScale(XMVectorSubtract(maxV, minV), 0.5f)));
+
+	std::vector<XMFLOAT3> centers(instanceCount);
+	for (int i = 0; i < instanceCount; ++i)
+	{
+		centers[i] = XMFLOAT3(positions[i].x + localCenter.x, positions[i].y + localCenter.y, positions[i].z + localCenter.z);
+	}
+	selector.SetInstances(centers, radius);
+}
+
+void TreeManager::InitializeTrees(std::vector<std::string> meshNames, std::vector<std::string> materialNames, std::vector<XMFLOAT3> positionsVector)
+{
+	lods.clear();
+	AddLod(meshNames, materialNames, 0.0f);
 
 	auto identityMat = XMMatrixIdentity();
 	positions = positionsVector;
 	instanceCount = (int)positions.size();
-	treeInstances = new XMFLOAT4X4[instanceCount];
+	treeInstances.resize(instanceCount);
 	for (int i = 0; i < instanceCount; ++i)
 	{
 		auto instaMat = identityMat * XMMatrixScaling(1, 1, 1) * XMMatrixRotationZ(0)* XMMatrixTranslationFromVector(XMLoadFloat3(&positions[i]));
 		XMStoreFloat4x4(&treeInstances[i], XMMatrixTranspose(instaMat));
-		//XMStoreFloat4x4(&worldInstances[i], XMMatrixTranspose(instaMat));
-		//treeInstances[i].world = positions[i];
 	}
 
-	D3D11_BUFFER_DESC instanceBufferDesc;
-	D3D11_SUBRESOURCE_DATA instanceData;
-	instanceBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	instanceBufferDesc.ByteWidth = sizeof(XMFLOAT4X4) * instanceCount;
-	instanceBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	instanceBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	instanceBufferDesc.MiscFlags = 0;
-	instanceBufferDesc.StructureByteStride = 0;
+	ReserveInstances(MAX_INSTANCE);
+	UpdateBounds();
+}
+
+void TreeManager::AddLod(std::vector<std::string> meshNames, std::vector<std::string> materialNames, float startDistance)
+{
+	if (lods.size() == MAX_TREE_LODS)
+		return;
+
+	auto rm = Resources::GetInstance();
+	TreeLod lod;
+	for (auto mName : meshNames)
+	{
+		lod.meshes.push_back(rm->meshes.Find(mName));
+	}
+
+	for (auto mName : materialNames)
+	{
+		lod.materials.push_back(rm->materials.Find(mName));
+	}
+
+	// The new level takes over where the last one ends and runs out
+	// to wherever the last one did
+	lod.maxDistance = FLT_MAX;
+	if (!lods.empty())
+	{
+		lod.maxDistance = lods.back().maxDistance;
+		lods.back().maxDistance = startDistance;
+	}
+	lods.push_back(lod);
 
-	instanceData.pSysMem = (void*)treeInstances;
-	instanceData.SysMemPitch = 0;
-	instanceData.SysMemSlicePitch = 0;
+	if (instanceCount > 0)
+		UpdateBounds();
+}
 
-	device->CreateBuffer(&instanceBufferDesc, &instanceData, &instanceBuffer);
+void TreeManager::SetDrawDistance(float distance)
+{
+	if (!lods.empty())
+		lods.back().maxDistance = distance;
 }
 
 void TreeManager::Render(Camera* camera)
 {
-	for (int i = 0; i < meshes.size(); ++i)
-		Render(i, camera);
+	if (CompactVisibleInstances(camera->GetFrustum(), camera->GetPosition()) == 0)
+		return;
+
+	commandList.Reset();
+	for (int lod = 0; lod < (int)lods.size(); ++lod)
+	{
+		if (selector.GetCount(lod) == 0)
+			continue;
+		for (int i = 0; i < (int)lods[lod].meshes.size(); ++i)
+			Render(lod, i, camera);
+	}
+	commandList.Execute(commandBackend);
 }
 
-void TreeManager::RenderShadow(SimpleVertexShader * shadowVS)
+void TreeManager::RenderShadow(SimpleVertexShader * shadowVS, const Frustum& lightFrustum, XMFLOAT3 viewPosition)
 {
-	for (int i = 0; i < meshes.size(); ++i)
-		RenderShadowBuffer(i, shadowVS);
+	if (CompactVisibleInstances(lightFrustum, viewPosition) == 0)
+		return;
+
+	if (shadowVS != shadowShader)
+	{
+		shadowShader = shadowVS;
+		shadowWorldHandle = shadowVS->GetVariableHandle("world");
+	}
+
+	commandList.Reset();
+	for (int lod = 0; lod < (int)lods.size(); ++lod)
+	{
+		if (selector.GetCount(lod) == 0)
+			continue;
+		for (int i = 0; i < (int)lods[lod].meshes.size(); ++i)
+			RenderShadowBuffer(lod, i, shadowVS);
+	}
+	commandList.Execute(commandBackend);
 }
 
-TreeManager::TreeManager(ID3D11Device* device, ID3D11DeviceContext* context)
+TreeManager::TreeManager(ID3D11Device* device, ID3D11DeviceContext* context) :
+	commandBackend(context)
 {
 	this->device = device;
 	this->context = context;
 	instanceBuffer = nullptr;
-	treeInstances = nullptr;
+	instanceCapacity = 0;
+	instanceCount = 0;
+	shadowShader = nullptr;
+	shadowWorldHandle = SIMPLE_SHADER_INVALID_HANDLE;
 	D3D11_RASTERIZER_DESC  rasDesc = {};
 	rasDesc.FillMode = D3D11_FILL_SOLID;
 	rasDesc.CullMode = D3D11_CULL_NONE;
@@ -141,6 +389,5 @@ TreeManager::TreeManager(ID3D11Device* device, ID3D11DeviceContext* context)
 TreeManager::~TreeManager()
 {
 	if (instanceBuffer)instanceBuffer->Release();
-	if (treeInstances)delete[] treeInstances;
 	if (rasterizer)rasterizer->Release();
 }
@@ -5,9 +5,16 @@
 #include "Mesh.h"
 #include "Material.h"
 #include "Camera.h"
+#include "Frustum.h"
+#include "D3D11CommandBackend.h"
 
+// The instance buffer starts out this big and doubles whenever more
+// instances survive culling than fit
 #define MAX_INSTANCE 64
 
+// Distance buckets an instance can be sorted into
+#define MAX_TREE_LODS 4
+
 using namespace DirectX;
 
 struct TreeInstanceType
@@ -15,23 +22,104 @@ struct TreeInstanceType
 	XMFLOAT4X4 world;
 };
 
-class TreeManager
+//------------------------------------------------
+// Meshes drawn for every instance within a range
+// of distances from the camera
+//------------------------------------------------
+struct TreeLod
 {
 	std::vector<Mesh*> meshes;
 	std::vector<Material*> materials;
+	float maxDistance;
+};
+
+//------------------------------------------------
+// Picks the instances that touch a frustum and
+// groups them by distance bucket, nearest bucket
+// first. Needs no device.
+//------------------------------------------------
+class InstanceSelector
+{
+public:
+	InstanceSelector();
+
+	// Every instance gets the same radius around its center
+	void SetInstances(const std::vector<XMFLOAT3>& centers, float instanceRadius);
+
+	// maxDistances are ascending, one per bucket. Instances past the
+	// last one are dropped. Returns how many were selected.
+	int Select(const Frustum& frustum, XMFLOAT3 viewPosition, const float* maxDistances, int bucketCount);
+
+	// Instance indices grouped by bucket
+	const int* GetSelected() const;
+	int GetFirst(int bucket) const;
+	int GetCount(int bucket) const;
+
+	// Times Select on scattered instances
+	static void Benchmark(int instanceCount, int iterations);
+private:
+	int instanceCount;
+
+	// One array per component, padded to a multiple of 4 for the culler
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> radius;
+	std::vector<int> visibleIndices;
+	std::vector<unsigned char> visibleBuckets;
+	std::vector<int> selected;
+	int firsts[MAX_TREE_LODS];
+	int counts[MAX_TREE_LODS];
+};
+
+class TreeManager
+{
+	std::vector<TreeLod> lods;
 	std::vector<XMFLOAT3> positions;
-	XMFLOAT4X4* treeInstances;
+	std::vector<XMFLOAT4X4> treeInstances;
 	int instanceCount;
+
+	// This frame's instances, packed and grouped by level
 	ID3D11Buffer* instanceBuffer;
+	int instanceCapacity;
+	InstanceSelector selector;
+
 	ID3D11Device* device;
 	ID3D11DeviceContext* context;
 	ID3D11RasterizerState* rasterizer;
-	void Render(int index, Camera* camera);
-	void RenderShadowBuffer(int index, SimpleVertexShader* shadowVS);
+
+	// Each level's draws are recorded here and replayed together
+	CommandList commandList;
+	D3D11CommandBackend commandBackend;
+
+	// Looked up again only if RenderShadow gets a different shader
+	SimpleVertexShader* shadowShader;
+	int shadowWorldHandle;
+	void Render(int lod, int index, Camera* camera);
+	void RenderShadowBuffer(int lod, int index, SimpleVertexShader* shadowVS);
+	int CompactVisibleInstances(const Frustum& frustum, XMFLOAT3 viewPosition);
+	void ReserveInstances(int count);
+	void UpdateBounds();
 public:
 	void InitializeTrees(std::vector<std::string> meshNames, std::vector<std::string> materialNames, std::vector<XMFLOAT3> positionVector);
+
+	// Instances at least startDistance from the camera switch to these
+	// meshes. Levels are added nearest first.
+	void AddLod(std::vector<std::string> meshNames, std::vector<std::string> materialNames, float startDistance);
+
+	// Instances further away than this are not drawn at all
+	void SetDrawDistance(float distance);
+
+	// Only draws the instances inside the camera's frustum
 	void Render(Camera* camera);
-	void RenderShadow(SimpleVertexShader* shadowVS);
+
+	// Only draws the instances that touch the light's volume. Levels
+	// still go by the distance from viewPosition so the shadows match.
+	void RenderShadow(SimpleVertexShader* shadowVS, const Frustum& lightFrustum, XMFLOAT3 viewPosition);
+
+	// Binds a mesh with its instances and records the draw of a range
+	// of them. Meshes are welded, so this is indexed. Needs no device.
+	static void RecordDraw(CommandList& list, Mesh* mesh, ID3D11Buffer* instances, ID3D11RasterizerState* rasterizer, int firstInstance, int instanceCount);
 	TreeManager(ID3D11Device* device, ID3D11DeviceContext* context);
 	~TreeManager();
 };
@@ -1,13 +1,19 @@
 
-cbuffer externalData : register(b0)
+// Split by how often they change, so a buffer is only
+// uploaded again when something in it did
+cbuffer perFrame : register(b0)
 {
-	matrix world;
 	matrix view;
 	matrix projection;
 	matrix shadowView;
 	matrix shadowProjection;
 };
 
+cbuffer perObject : register(b1)
+{
+	matrix world;
+};
+
 
 struct VertexShaderInput
 {
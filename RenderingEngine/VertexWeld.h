@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "Vertex.h"
+
+#define VERTEX_WELD_UNASSIGNED 0xFFFFFFFF
+
+// -----------------------------------------------------
+// What makes two vertices the same, before tangents
+// are calculated. Floats are compared bit for bit.
+// -----------------------------------------------------
+struct VertexWeldKey
+{
+	uint32_t words[20];
+	int count;
+
+	template<typename T>
+	void Add(const T& value)
+	{
+		memcpy(words + count, &value, sizeof(T));
+		count += sizeof(T) / sizeof(uint32_t);
+	}
+
+	bool operator==(const VertexWeldKey& other) const
+	{
+		return count == other.count && memcmp(words, other.words, count * sizeof(uint32_t)) == 0;
+	}
+
+	uint32_t Hash() const
+	{
+		uint32_t hash = 2166136261u;
+		for (int i = 0; i < count; i++)
+			hash = (hash ^ words[i]) * 16777619u;
+		return hash ^ (hash >> 15);
+	}
+};
+
+inline VertexWeldKey GetWeldKey(const Vertex& vertex)
+{
+	VertexWeldKey key = {};
+	key.Add(vertex.Position);
+	key.Add(vertex.Normal);
+	key.Add(vertex.UV);
+	return key;
+}
+
+inline VertexWeldKey GetWeldKey(const VertexTerrain& vertex)
+{
+	VertexWeldKey key = {};
+	key.Add(vertex.Position);
+	key.Add(vertex.Normal);
+	key.Add(vertex.UV);
+	key.Add(vertex.BlendUV);
+	return key;
+}
+
+// Skinned vertices only share when their bones do too
+inline VertexWeldKey GetWeldKey(const VertexAnimated& vertex)
+{
+	VertexWeldKey key = {};
+	key.Add(vertex.Position);
+	key.Add(vertex.Normal);
+	key.Add(vertex.UV);
+	key.Add(vertex.Boneids);
+	key.Add(vertex.Weights);
+	return key;
+}
+
+// -----------------------------------------------------
+// Merges vertices with the same position, normal and
+// UV (see GetWeldKey) and points the indices at the
+// merged set, in the order the indices first use
+// them. Unused vertices are dropped. Returns how many
+// vertices are left.
+// -----------------------------------------------------
+template<typename T>
+unsigned int WeldVertices(std::vector<T>& vertices, std::vector<unsigned int>& indices)
+{
+	// Open addressing, at most half full, slots hold welded indices
+	size_t capacity = 16;
+	while (capacity < vertices.size() * 2)
+		capacity *= 2;
+	std::vector<unsigned int> slots(capacity, VERTEX_WELD_UNASSIGNED);
+	std::vector<unsigned int> remap(vertices.size(), VERTEX_WELD_UNASSIGNED);
+	std::vector<VertexWeldKey> keys;
+	std::vector<T> welded;
+	welded.reserve(vertices.size());
+
+	for (auto& index : indices)
+	{
+		unsigned int& target = remap[index];
+		if (target == VERTEX_WELD_UNASSIGNED)
+		{
+			VertexWeldKey key = GetWeldKey(vertices[index]);
+			size_t slot = key.Hash() & (capacity - 1);
+			while (slots[slot] != VERTEX_WELD_UNASSIGNED && !(keys[slots[slot]] == key))
+				slot = (slot + 1) & (capacity - 1);
+
+			if (slots[slot] == VERTEX_WELD_UNASSIGNED)
+			{
+				slots[slot] = (unsigned int)welded.size();
+				keys.push_back(key);
+				welded.push_back(vertices[index]);
+			}
+			target = slots[slot];
+		}
+		index = target;
+	}
+
+	vertices.swap(welded);
+	return (unsigned int)vertices.size();
+}
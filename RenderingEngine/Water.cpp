@@ -1,4 +1,6 @@
 #include "Water.h"
+#include <cfloat>
+#include <cstring>
 using namespace DirectX;
 
 // -----------------------------------------------------
@@ -8,6 +10,7 @@ Water::Water(int _length,int _breadth) : Entity(nullptr,nullptr)
 {
 	XMStoreFloat4x4(&reflectionmatrix, XMMatrixTranspose(XMMatrixIdentity()));
 	reflectionBuffer = 0;
+	waveCount = 0;
 	length = _length;
 	breadth = _breadth;
 	vertices = new Vertex[length * breadth];
@@ -20,8 +23,8 @@ Water::Water(int _length,int _breadth) : Entity(nullptr,nullptr)
 Water::~Water()
 {
 	delete mesh;
-	delete indices;
-	delete vertices;
+	delete[] indices;
+	delete[] vertices;
 }
 
 //--------------------------------------------------------
@@ -176,6 +179,7 @@ void Water::CreateWaves()
 	waves[2] = Wave{ XMFLOAT2(0,1),0.6f,20 };
 	waves[3] = Wave{ XMFLOAT2(1,1),0.1f,3 };
 	waves[4] = Wave{ XMFLOAT2(1,0),0.2f,6 };
+	waveCount = 5;
 }
 
 // -----------------------------------------------------
@@ -184,4 +188,122 @@ void Water::CreateWaves()
 Wave* Water::GetWaves()
 {
 	return waves;
-}
\ No newline at end of file
+}
+
+// -----------------------------------------------------
+// Return the number of waves in use
+// -----------------------------------------------------
+int Water::GetWaveCount() const
+{
+	return waveCount;
+}
+
+// -----------------------------------------------------
+// Hoist everything that does not depend on the vertex
+// -----------------------------------------------------
+void BuildWaveConstants(const Wave *waves, int numWaves, float time, WaveConstants *constants)
+{
+	for (int i = 0; i < numWaves; i++)
+	{
+		XMVECTOR direction = XMVector2Normalize(XMLoadFloat2(&waves[i].direction));
+
+		float wi = 2 * 3.1416f / waves[i].wavelength;
+		float ai = waves[i].amplitude;
+		float qi = STEEPNESS / wi * ai;
+
+		constants[i].directionX = XMVectorGetX(direction);
+		constants[i].directionZ = XMVectorGetY(direction);
+		constants[i].frequency = wi;
+		constants[i].phase = SPEED * wi * time;
+		constants[i].amplitude = ai;
+		constants[i].crest = qi * ai;
+	}
+}
+
+// -----------------------------------------------------
+// Surface height at a world space XZ
+// -----------------------------------------------------
+float Water::GetHeight(float x, float z, float time)
+{
+	float height;
+	GetHeights(&x, &z, &height, 1, time);
+	return height;
+}
+
+// -----------------------------------------------------
+// Surface height at count world space XZ points.
+// The vertex shader moves a grid point p to
+//   x' = numWaves * p.x + sum(qi * ai * dx * cos(theta(p)))
+// (same for z), with y' = sum(ai * sin(theta(p))). To find
+// the height at a given x', z' we solve for p with
+//   p.x = (x' - sum(qi * ai * dx * cos(theta(p)))) / numWaves
+// which converges quickly as the cosine term is a small
+// fraction of numWaves. Four points are solved at a time.
+// -----------------------------------------------------
+void Water::GetHeights(const float *x, const float *z, float *heights, int count, float time)
+{
+	WaveConstants constants[NUM_OF_WAVES];
+	BuildWaveConstants(waves, waveCount, time, constants);
+
+	XMVECTOR inverseWaveCount = XMVectorReplicate(waveCount > 0 ? 1.0f / waveCount : 0.0f);
+	XMVECTOR offsetX = XMVectorReplicate(position.x);
+	XMVECTOR offsetY = XMVectorReplicate(position.y);
+	XMVECTOR offsetZ = XMVectorReplicate(position.z);
+	// Grid extents, with a little slack for points right on the edge
+	XMVECTOR centerX = XMVectorReplicate((length - 1) * 0.5f);
+	XMVECTOR centerZ = XMVectorReplicate((breadth - 1) * 0.5f);
+	XMVECTOR extentX = XMVectorAdd(centerX, XMVectorReplicate(0.01f));
+	XMVECTOR extentZ = XMVectorAdd(centerZ, XMVectorReplicate(0.01f));
+	XMVECTOR offSurface = XMVectorReplicate(-FLT_MAX);
+
+	for (int i = 0; i < count; i += 4)
+	{
+		int remaining = count - i < 4 ? count - i : 4;
+		XMFLOAT4 queryX(0, 0, 0, 0), queryZ(0, 0, 0, 0);
+		memcpy(&queryX, x + i, sizeof(float) * remaining);
+		memcpy(&queryZ, z + i, sizeof(float) * remaining);
+
+		XMVECTOR targetX = XMVectorSubtract(XMLoadFloat4(&queryX), offsetX);
+		XMVECTOR targetZ = XMVectorSubtract(XMLoadFloat4(&queryZ), offsetZ);
+		XMVECTOR gridX = XMVectorMultiply(targetX, inverseWaveCount);
+		XMVECTOR gridZ = XMVectorMultiply(targetZ, inverseWaveCount);
+		XMVECTOR totalY = XMVectorZero();
+
+		for (int iteration = 0; iteration <= WATER_QUERY_ITERATIONS; iteration++)
+		{
+			XMVECTOR shiftX = XMVectorZero();
+			XMVECTOR shiftZ = XMVectorZero();
+			totalY = XMVectorZero();
+
+			for (int w = 0; w < waveCount; w++)
+			{
+				const WaveConstants& wave = constants[w];
+				XMVECTOR dot = XMVectorMultiplyAdd(gridX, XMVectorReplicate(wave.directionX), XMVectorMultiply(gridZ, XMVectorReplicate(wave.directionZ)));
+				XMVECTOR theta = XMVectorMultiplyAdd(dot, XMVectorReplicate(wave.frequency), XMVectorReplicate(wave.phase));
+
+				XMVECTOR sinTheta, cosTheta;
+				XMVectorSinCos(&sinTheta, &cosTheta, theta);
+
+				shiftX = XMVectorMultiplyAdd(cosTheta, XMVectorReplicate(wave.crest * wave.directionX), shiftX);
+				shiftZ = XMVectorMultiplyAdd(cosTheta, XMVectorReplicate(wave.crest * wave.directionZ), shiftZ);
+				totalY = XMVectorMultiplyAdd(sinTheta, XMVectorReplicate(wave.amplitude), totalY);
+			}
+
+			// The last pass only needs the height at the converged point
+			if (iteration == WATER_QUERY_ITERATIONS)
+				break;
+
+			gridX = XMVectorMultiply(XMVectorSubtract(targetX, shiftX), inverseWaveCount);
+			gridZ = XMVectorMultiply(XMVectorSubtract(targetZ, shiftZ), inverseWaveCount);
+		}
+
+		// Anything whose grid point falls outside the mesh is not on the water
+		XMVECTOR inside = XMVectorAndInt(
+			XMVectorInBounds(XMVectorSubtract(gridX, centerX), extentX),
+			XMVectorInBounds(XMVectorSubtract(gridZ, centerZ), extentZ));
+
+		XMFLOAT4 result;
+		XMStoreFloat4(&result, XMVectorSelect(offSurface, XMVectorAdd(totalY, offsetY), inside));
+		memcpy(heights + i, &result, sizeof(float) * remaining);
+	}
+}
@@ -9,6 +9,13 @@
 
 #define	NUM_OF_WAVES 10
 
+// Must match the statics in VS_WaterShader.hlsl
+const float STEEPNESS = 0.9f;
+const float SPEED = 20;
+
+// Fixed-point steps used to undo the horizontal displacement
+const int WATER_QUERY_ITERATIONS = 4;
+
 //------------------------------------------------
 // Properties of a single wave
 // TODO: Try and add steepness and speed
@@ -20,6 +27,22 @@ struct Wave
 	float wavelength;
 };
 
+//------------------------------------------------
+// Terms of the Gerstner equation that only depend
+// on the wave, computed once per wave per update
+//------------------------------------------------
+struct WaveConstants
+{
+	float directionX;	// normalized direction
+	float directionZ;
+	float frequency;	// wi = 2 * pi / wavelength
+	float phase;		// phi * time
+	float amplitude;	// ai
+	float crest;		// qi * ai
+};
+
+void BuildWaveConstants(const Wave *waves, int numWaves, float time, WaveConstants *constants);
+
 class Water : public Entity
 {
 private:
@@ -30,6 +53,7 @@ private:
 	UINT * indices;
 	Vertex * vertices;
 	Wave waves[NUM_OF_WAVES];
+	int waveCount;
 	
 	void GenerateWaterMesh();
 	void CalculateUVCoordinates();
@@ -40,11 +64,16 @@ public:
 	void Init(Material* mat, ID3D11Device * device);
 	void CreateWaves();
 
+	// Surface queries, in world space. Points off the water return -FLT_MAX.
+	float GetHeight(float x, float z, float time);
+	void GetHeights(const float *x, const float *z, float *heights, int count, float time);
+
 	// Getters
 	UINT*	GetIndices() const;
 	Vertex* GetVertices() const;
 	UINT	GetVertexCount() const;
 	UINT	GetIndexCount() const;
 	Wave*	GetWaves() ;
+	int		GetWaveCount() const;
 };
 